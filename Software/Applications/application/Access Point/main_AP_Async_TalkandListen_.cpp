@@ -75,7 +75,8 @@ Solution overview:
 #define CTRL_MSG_SZ (2+6*NUM_MOTORS)	//each motor is supplied 3 16 bit words that control the amplitude, freq, and phase of actuation. Send the lowest byte of each word first.
 
 #define SPIN_ABOUT_A_QUARTER_SECOND   NWK_DELAY(250)
-#define JAM_TIME_INTERVAL 2		//the number of seconds between time "Jam" transmissions
+#define JAM_FAST_INTERVAL 0.5	//seconds between time "Jam" transmissions while any ED is still converging
+#define JAM_SLOW_INTERVAL 5		//seconds between time "Jam" transmissions once every ED reports a locked clock
 
 /**********************************
  * user fn declarations
@@ -84,7 +85,7 @@ Solution overview:
 static uint8_t sCB(linkID_t);
 
 // received message handler
-static void proc_RXRF_Msg(linkID_t, uint8_t *, uint8_t);
+static void proc_RXRF_Msg(linkID_t, const uint8_t *, uint8_t);
 void ParseRXCmd(int numchars);
 /*********************************/
 
@@ -100,12 +101,17 @@ static uint8_t  sNumCurrentPeers = 0;
 extern Circ_UART_Buf UART_RX_BUFFER;
 extern Circ_UART_Buf UART_TX_BUFFER;
 
-float time = 0.0;
-float next_time_Jam = time+JAM_TIME_INTERVAL;
+volatile uint32_t ticks = 0;	//timer periods since boot. Sent in the time msgs and the coarse part of the radio timestamps
+uint32_t next_tick_Jam = (uint32_t)(JAM_FAST_INTERVAL/Timestep);
+uint8_t sPeerLocked[NUM_CONNECTIONS] = {0};	//last lock state reported by each peer in its sync statistics
 
-unsigned char TX_Time_msg[6];	//the time message
+unsigned char TX_Time_msg[TIME_MSG_LEN];	//the time message
+unsigned char TimeMsgSeq = 0;	//sequence number of the next time message
+unsigned char BootNonce = 0;	//random and never 0, sent in every time message so EDs can tell this AP rebooted
+uint32_t TimeMsgTxStamp = 0;	//when the previous time message finished transmitting
 unsigned char TX_msg[MAX_APP_PAYLOAD];	//reserve space for the message that will be sent via radio
 unsigned char TX_msg_Len = 0;
+uint8_t TxNextPeer = 0;	//first peer TX_msg hasn't been queued for yet
 
 /* work loop semaphores */
 static volatile uint8_t RXPeerFrameSem = 0;
@@ -113,6 +119,13 @@ static volatile uint8_t TxPeerFrameSem = 0;
 static volatile uint8_t TxTimeFrameSem = 0;
 static volatile uint8_t sJoinSem = 0;
 
+/* timer ISR send gate. Held by the main loop across a time msg send and the read of its
+ * transmit stamp so no queued peer frame can go out in between and overwrite the stamp.
+ * Busy while the ISR is sending, so a timer period that ends meanwhile only counts the tick
+ */
+static volatile uint8_t sTxServiceHeld = 0;
+static volatile uint8_t sTxServiceBusy = 0;
+
 //define this device's unique address
 addr_t lAddr = THIS_DEVICE_ADDRESS;
 
@@ -140,8 +153,43 @@ void InitTimer(void)
 #pragma vector=TIMERA0_VECTOR
 __interrupt void TIMERA0_ISR(void)
 {
-	time+=Timestep;
+	ticks++;
 
+	//send the peer msgs queued by the main loop. Interrupts go back on first so the UART and radio keep being serviced while they go out
+	if (!sTxServiceHeld && !sTxServiceBusy && SMPL_TxPending())
+	{
+		sTxServiceBusy = 1;
+		BSP_ENABLE_INTERRUPTS();
+		SMPL_TxService();
+		BSP_DISABLE_INTERRUPTS();
+		sTxServiceBusy = 0;
+
+		//a BSP_TimerWait() in the main loop may have timed out while interrupts were on
+		BSP_TIMER_WAKE_ON_EXIT();
+	}
+}
+/*********************************/
+
+/**********************************
+ * MRFI_TimestampCapture
+ * Called by the radio driver on the end-of-frame edge. Returns the time in timer counts,
+ * including a period rollover whose ISR is still pending
+**********************************/
+uint32_t MRFI_TimestampCapture(void)
+{
+	bspIState_t intState;
+	uint32_t t;
+	unsigned int counts;
+
+	BSP_ENTER_CRITICAL_SECTION(intState);
+	counts = TA0R;
+	t = ticks;
+	if ((TA0CCTL0 & CCIFG) && (counts < (PWMPeriod/2)))
+	{
+		t++;
+	}
+	BSP_EXIT_CRITICAL_SECTION(intState);
+	return t*PWMPeriod + counts;
 }
 /*********************************/
 
@@ -160,6 +208,12 @@ void main (void)
 
 	SMPL_Init(sCB);	//init the radio and register callback handler. ENABLES GIE AT END
 
+	//new every boot. EDs that see it change drop their link and join again
+	while (!BootNonce)
+	{
+		BootNonce = MRFI_RandomByte();
+	}
+
 	/* green and red LEDs on solid to indicate waiting for a Join. */
 	if (!BSP_LED2_IS_ON())
 	{
@@ -185,67 +239,99 @@ void main (void)
 				}
 				/* Implement fail-to-link policy here. otherwise, listen again. */
 			}
+			sPeerLocked[sNumCurrentPeers] = 0;	//new peer needs rapid time msgs to converge
 			sNumCurrentPeers++;
 			BSP_ENTER_CRITICAL_SECTION(intState);
 			sJoinSem--;
+			next_tick_Jam = ticks;	//and it should get the first one right away
 			BSP_EXIT_CRITICAL_SECTION(intState);
 		}
 
 		//is it time to send a time msg? Send same msg to all peers via broadcast
-		if (time>next_time_Jam)
+		BSP_ENTER_CRITICAL_SECTION(intState);
+		uint32_t now = ticks;	//32 bit read isn't atomic
+		BSP_EXIT_CRITICAL_SECTION(intState);
+		if ((int32_t)(now - next_tick_Jam) >= 0)
 		{
 			TX_Time_msg[0]=0xFE;
 			TX_Time_msg[1]=0xFF;
-			unsigned char* ind=(unsigned char*)&time;
+			unsigned char* ind=(unsigned char*)&now;
 			TX_Time_msg[2]=*(ind+0);	//dereference the pointer and use some pointer addressing to make this work
 			TX_Time_msg[3]=*(ind+1);	//dereference the pointer and use some pointer addressing to make this work
 			TX_Time_msg[4]=*(ind+2);	//dereference the pointer and use some pointer addressing to make this work
 			TX_Time_msg[5]=*(ind+3);	//dereference the pointer and use some pointer addressing to make this work
-			SMPL_Send(SMPL_LINKID_USER_UUD, TX_Time_msg, 6);
-			next_time_Jam=time+JAM_TIME_INTERVAL;	//update the next time we need to send a time Jam
+			TX_Time_msg[6]=TimeMsgSeq;
+			TX_Time_msg[7]=BootNonce;
+			ind=(unsigned char*)&TimeMsgTxStamp;	//EDs pair this with their own receive stamp of the previous time msg
+			TX_Time_msg[8]=*(ind+0);
+			TX_Time_msg[9]=*(ind+1);
+			TX_Time_msg[10]=*(ind+2);
+			TX_Time_msg[11]=*(ind+3);
+			//the timer ISR isn't sending (it can't be, we're running) and mustn't start until the stamp is read
+			sTxServiceHeld = 1;
+			if (SMPL_SUCCESS == SMPL_Send(SMPL_LINKID_USER_UUD, TX_Time_msg, TIME_MSG_LEN))
+			{
+				//only a msg that actually went out gets a sequence number and a transmit stamp
+				SMPL_Ioctl(IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_TX_TIMESTAMP, &TimeMsgTxStamp);
+				TimeMsgSeq++;
+			}
+			sTxServiceHeld = 0;
+			//beacon rapidly until every peer's clock has converged, then back off to save airtime and ED receive energy
+			uint8_t i, allLocked = (sNumCurrentPeers > 0);
+			for (i=0; i<sNumCurrentPeers; ++i)
+			{
+				allLocked &= sPeerLocked[i];
+			}
+			next_tick_Jam = now + (uint32_t)((allLocked ? JAM_SLOW_INTERVAL : JAM_FAST_INTERVAL)/Timestep);	//update the next time we need to send a time Jam
 		}
 
-		//is it time to send a msg? Send same msg to all peers
+		//is it time to send a msg? Send same msg to all peers. The msgs are only queued here and go out from the timer ISR.
+		//If the Tx queue is full the remaining peers are queued on a later pass, once the ISR has sent some
 		if (TxPeerFrameSem)
 		{
-			uint8_t	i;
-			for (i=0; i<sNumCurrentPeers; ++i)
+			uint8_t	handle;
+			while (TxNextPeer < sNumCurrentPeers)
 			{
-				if (SMPL_SUCCESS == SMPL_Send(sLID[i], TX_msg, TX_msg_Len))
+				if (SMPL_NOMEM == SMPL_SendAsync(sLID[TxNextPeer], TX_msg, TX_msg_Len, 0, &handle))
 				{
-//					BSP_ENTER_CRITICAL_SECTION(intState);
-//					TxPeerFrameSem--;
-//					BSP_EXIT_CRITICAL_SECTION(intState);
+					break;
 				}
+				TxNextPeer++;	//queued, or the link is bad and retrying won't help
+			}
+			if (TxNextPeer >= sNumCurrentPeers)
+			{
+				TxNextPeer = 0;
+				BSP_ENTER_CRITICAL_SECTION(intState);
+				TxPeerFrameSem--;
+				BSP_EXIT_CRITICAL_SECTION(intState);
+				TX_msg_Len = 0;	//clear the message length once every peer has it queued
 			}
-			BSP_ENTER_CRITICAL_SECTION(intState);
-			TxPeerFrameSem--;
-			BSP_EXIT_CRITICAL_SECTION(intState);
-			TX_msg_Len = 0;	//clear the message length after an assumed TX event
 		}
 
 		// Have we received a frame on one of the ED connections?
 		if (RXPeerFrameSem)
 		{
-			uint8_t     msg[MAX_APP_PAYLOAD], len, i;
+			rxFrameView_t view;	//points into the radio frame queue so the payload isn't copied onto the stack
+			linkID_t      lid;
 
-			/* process frames from all possible peers */
-			for (i=0; i<sNumCurrentPeers; ++i)
+			/* process frames from all peers, oldest first */
+			while (SMPL_SUCCESS == SMPL_ReceiveAnyView(&lid, &view))
 			{
-				if (SMPL_SUCCESS == SMPL_Receive(sLID[i], msg, &len))
-				{
-					proc_RXRF_Msg(sLID[i], msg, len);
+				proc_RXRF_Msg(lid, view.msg, view.len);
+				SMPL_ReleaseView(&view);
 
-					BSP_ENTER_CRITICAL_SECTION(intState);
+				BSP_ENTER_CRITICAL_SECTION(intState);
+				if (RXPeerFrameSem)
+				{
 					RXPeerFrameSem--;
-					BSP_EXIT_CRITICAL_SECTION(intState);
 				}
+				BSP_EXIT_CRITICAL_SECTION(intState);
 			}
 		}
 
-		//is enough new data available to do something with?
+		//is enough new data available to do something with? The next command waits in the UART buffer until TX_msg has been queued for every peer
 		int numcharsavail = UART_RX_BUFFER.DataAvail();
-		if(numcharsavail >= CTRL_MSG_SZ)
+		if(numcharsavail >= CTRL_MSG_SZ && !TxPeerFrameSem)
 		{
 			ParseRXCmd(CTRL_MSG_SZ);	//if we have enough bytes in the buffer parse it...
 	 	 	UART_RX_BUFFER.FlushNChars(CTRL_MSG_SZ);	//...and now flush the buffer of the data we just did something with
@@ -285,8 +371,21 @@ static uint8_t sCB(linkID_t lid)
 	return 0;
 }
 
-static void proc_RXRF_Msg(linkID_t lid, uint8_t *msg, uint8_t len)
+static void proc_RXRF_Msg(linkID_t lid, const uint8_t *msg, uint8_t len)
 {
+	//keep track of which peers have a converged clock so the time msg rate can adapt
+	if (len == SYNC_MSG_LEN && msg[0] == (SYNC_MSG & 0xFF) && msg[1] == (SYNC_MSG >> 8))
+	{
+		uint8_t i;
+		for (i=0; i<sNumCurrentPeers; ++i)
+		{
+			if (sLID[i] == lid)
+			{
+				sPeerLocked[i] = msg[3];
+			}
+		}
+	}
+
 	/* do something useful */
 	if (len)
 	{
@@ -41,9 +41,11 @@
 #include "bsp_leds.h"
 #include "bsp_buttons.h"
 #include "nwk.h"
+#include "nwk_ping.h"
 
 //user includes
 #include "math.h"
+#include <string.h>
 
 /* work loop semaphores */
 static volatile uint8_t TxPeerFrameSem;
@@ -51,6 +53,9 @@ static volatile uint8_t RxPeerFrameSem;
 static volatile uint8_t RxBroadcastSem;
 
 static void linkTo(void);
+static uint8_t reacquire(void);
+static uint8_t ResumeLink(void);
+static void SaveLink(void);
 
 void toggleLED(uint8_t);
 
@@ -60,6 +65,10 @@ static uint8_t sCB(linkID_t);
 /* received message handler */
 static void processMessage(linkID_t, uint8_t *, uint8_t);
 
+/* time messages are handled in the radio Rx ISR */
+static uint8_t sTimeHook(linkID_t, const uint8_t *, uint8_t, uint32_t);
+static void processTimeMsg(const uint8_t *, uint32_t);
+
 static	linkID_t sLinkID1 = 0;
 
 //define this device's unique address
@@ -70,24 +79,107 @@ addr_t lAddr = THIS_DEVICE_ADDRESS;
 #define SPIN_ABOUT_A_QUARTER_SECOND   NWK_DELAY(250)
 #define CHANGE_DEFAULT_ROM_DEVICE_ADDRESS
 
+#ifndef SLEW_PERIODS
+#define SLEW_PERIODS 10               // number of timer periods over which a new command is blended in
+#endif
+#define TWO_PI 6.2831853f
+
+// link watchdog. Time msgs arrive at least every 5s once the swarm has converged
+#define LINK_TIMEOUT_TICKS    ((uint16_t)(12/Timestep))   // no time or motor msg for this long: link considered lost
+#define FAILSAFE_SLEW_PERIODS ((int)(1/Timestep))         // ramp the actuators to rest over this many periods
+#define REACQUIRE_TRIES       6                           // join or link attempts per reacquire() call
+#define REACQUIRE_WAIT_MS     125                         // wait after the first failed attempt, doubled after each
+#define REACQUIRE_WAIT_MAX_MS 2000                        // longest wait between attempts
+
+// clock servo tuning. Errors are in timer counts (1us), corrections in 1/256 counts per timer period
+#define SYNC_STEP_TICKS     2         // errors larger than this many periods are stepped instead of slewed
+#define SYNC_KP_DIV         2         // fraction of the phase error removed before the next beacon
+#define SYNC_KI_DIV         8         // fraction of the residual rate error folded into the drift estimate
+#define SYNC_MAX_ADJ_Q8     ((int32_t)(PWMPeriod/16)*256)   // never stretch or shrink a period by more than 1/16
+#define SYNC_LOCK_COUNTS    200       // |error| below which a beacon counts toward lock
+#define SYNC_LOCK_BEACONS   8         // consecutive in-lock beacons before the drift estimate is trusted
+#define DRIFT_SAVE_DELTA_Q8 64        // rewrite the stored drift only when it moved by more than this (~12ppm)
+#define DRIFT_FLASH_KEY     0x0A      // marks info flash as holding a valid drift estimate
+#define LINK_FLASH_KEY      0x0B      // marks info flash as holding a saved network context
+#define LINK_FLASH_IMAGE_OS 6         // key, link ID, version, checksum and 2 length bytes precede the image
+#define SYNC_STAT_BEACONS   50        // send sync statistics to the AP after this many beacons
+
+#ifndef MRFI_TIMESTAMP
+#error "The clock servo pairs radio timestamps; define MRFI_TIMESTAMP in smpl_nwk_config.dat"
+#endif
+
 /**********************************
  * user global variables
 **********************************/
 float amplitude = 0.0;
 float frequency = 0.0;
 float phase = 0.0;
-float synced_time = 0.0;           // calibrated clock, synced with AP in every time message
-float time_since_msg = 0.0;        // uncalibrated ED clock, reset with every message and used to determine number of cycles since last message
-float time_since_connect = -1.0;   // first recorded time from AP after connection is established
-float time_of_last_msg = 0.0;      // recorded time from AP of last message
-int period = PWMPeriod;            // variable to store and update period of TA0 (i.e. value of TA0CCR0)
+uint32_t sync_ticks = 0;           // disciplined clock: timer periods elapsed, kept in step with the AP's tick count
+uint32_t last_beacon_tick = 0;     // sync_ticks when the previous time message was applied
+uint8_t synced = 0;                // set once the first time message has been applied
+int32_t drift_q8 = 0;              // integral term: crystal drift correction in 1/256 counts per period
+int32_t slew_q8 = 0;               // proportional term: phase correction spread over the next beacon interval
+int32_t adj_frac = 0;              // fraction of a count carried from period to period
+int32_t sync_err = 0;              // last measured clock error in timer counts, positive when the ED lags the AP
+uint16_t sync_err_peak = 0;        // largest |sync_err| since the last statistics report
+uint16_t sync_beacons = 0;         // time messages applied since the last statistics report
+uint8_t sync_steps = 0;            // number of times the clock had to be stepped
+uint8_t lock_count = 0;            // consecutive beacons with |sync_err| < SYNC_LOCK_COUNTS
+uint8_t drift_save_pending = 0;    // main loop should write drift_q8 to info flash
+uint8_t beacon_seq = 0;            // sequence number of the last time message
+uint32_t beacon_rx_stamp = 0;      // disciplined time at the end of the last time message, captured by the radio ISR
+uint8_t beacon_stamp_ok = 0;       // beacon_rx_stamp is valid and can be paired with the AP's transmit stamp
+#pragma DATA_SECTION (DriftFlash, ".infoD")	//info flash segment D holds the drift estimate across resets
+uint8_t DriftFlash[6];
+#pragma DATA_SECTION (LinkFlash, ".infoC")	//info flash segment C holds the network context so a reset can skip the join and link
+uint8_t LinkFlash[64];
+#pragma DATA_ALIGN (SyncMSG, sizeof(int));
+uint8_t     SyncMSG[SYNC_MSG_LEN];
 int ctr_pulse_width = 1500;
 int rad_pulse_width = 500;
-float start_time = 0.0;
+float wave_phase = 0.0;            // accumulated phase of the sinusoid, advanced every timer period and wrapped at 2*pi
+float amp_step = 0.0;              // per-period increments used to slew toward the last commanded values
+float freq_step = 0.0;
+float phase_step = 0.0;
+int slew_count = 0;                // timer periods left in the current slew
+unsigned int last_cmd[3] = {0, 0, 0}; // raw amplitude, frequency and phase of the last MOT_MSG, used to skip repeats
+uint16_t link_idle_ticks = 0;      // timer periods since the last time or motor msg
+uint8_t recovering = 0;            // link was lost and no motor msg has arrived since
+uint8_t ap_restarted = 0;          // AP boot nonce changed: it rebooted and our link is gone
+uint8_t ap_nonce = 0;              // boot nonce from the AP's time msgs, 0 until the first one
+uint8_t link_lost = 0;             // watchdog expired: main loop should look for the AP again
+uint16_t recovery_ticks = 0;       // timer periods from losing the link until commands resumed, last recovery
 #pragma DATA_ALIGN (RadioMSG, sizeof(int));	//align to int boundary so I can do nice pointer casts to get the data that I want
 uint8_t     RadioMSG[MAX_APP_PAYLOAD];
 /*********************************/
 
+/**********************************
+ * SlewTo
+ * Start slewing amplitude, frequency and phase toward the given raw (x500) values over
+ * the given number of timer periods. Call with interrupts disabled
+**********************************/
+static void SlewTo(unsigned int amp, unsigned int freq, unsigned int ph, int periods)
+{
+	float ampF = ((float)amp)/500;	//convert to float and rescale since we prescaled to send as an int
+	float freqF = ((float)freq)/500;
+	float phF = ((float)ph)/500;
+
+	last_cmd[0] = amp;
+	last_cmd[1] = freq;
+	last_cmd[2] = ph;
+	if (amplitude <= 0 && slew_count == 0)
+	{
+		// waveform is idle: start every ED from the same phase and only ramp the amplitude up
+		wave_phase = 0.0;
+		frequency = freqF;
+		phase = phF;
+	}
+	amp_step = (ampF - amplitude) / periods;
+	freq_step = (freqF - frequency) / periods;
+	phase_step = (phF - phase) / periods;
+	slew_count = periods;
+}
+
 /**********************************
  * InitTimer
  * Setup Timer_A to output the PWM signal that we care about and to also keep our timebase for the
@@ -109,36 +201,167 @@ void InitTimer(void)
 #pragma vector=TIMERA0_VECTOR
 __interrupt void TIMERA0_ISR(void)
 {
-    synced_time += Timestep;
-    if(time_since_connect >= 0.0) {
-        time_since_msg += Timestep;
-        TA0CCR0 = period;
-    }
-    else {
-        TA0CCR0 = PWMPeriod;
+    int32_t whole;
+
+    // advance the disciplined clock and apply the servo correction, dithering the fractional part
+    sync_ticks++;
+    adj_frac += drift_q8 + slew_q8;
+    whole = adj_frac / 256;
+    adj_frac -= whole * 256;
+    TA0CCR0 = PWMPeriod - (int)whole;
+
+    // link watchdog: bring the actuators to rest if the AP has gone quiet
+    if (synced && link_idle_ticks < 0xFFFF) {
+        if (++link_idle_ticks == LINK_TIMEOUT_TICKS) {
+            SlewTo(0, last_cmd[1], last_cmd[2], FAILSAFE_SLEW_PERIODS);
+            link_lost = 1;
+            if (!recovering) {
+                recovering = 1;
+                recovery_ticks = 0;
+            }
+        }
     }
+    if (recovering && recovery_ticks < 0xFFFF) recovery_ticks++;
+
     // Set new pulse width parameters based on new pulse period
     ctr_pulse_width = 1500 * TA0CCR0 / PWMPeriod;
     rad_pulse_width =  500 * TA0CCR0 / PWMPeriod;
 
+    // walk the waveform parameters toward the last command, landing exactly on it in the final period
+    if (slew_count > 0) {
+        amplitude += amp_step;
+        frequency += freq_step;
+        phase += phase_step;
+        if (--slew_count == 0) {
+            amplitude = ((float)last_cmd[0])/500;
+            frequency = ((float)last_cmd[1])/500;
+            phase = ((float)last_cmd[2])/500;
+        }
+    }
+
+    // advance the phase continuously so that parameter updates never restart the sinusoid.
+    // frequency is at most 65535/500 rad/s, so one period never advances more than 2*pi
+    wave_phase += frequency * Timestep;
+    if (wave_phase >= TWO_PI) wave_phase -= TWO_PI;
+
     //turn on PWM generation if we're asking for a signal (i.e. positive amplitude)
     if (amplitude > 0) TA0CCR1 = (TA0CCR0 - ctr_pulse_width)
-            + (int)(rad_pulse_width*amplitude*sinf(frequency*(synced_time-start_time)+phase));
+            + (int)(rad_pulse_width*amplitude*sinf(wave_phase+phase));
     else TA0CCR1=0;
 }
 /*********************************/
 
+/**********************************
+ * SampleClock
+ * Read the disciplined clock as whole periods plus timer counts into the current period,
+ * accounting for a rollover whose ISR is still pending. Call with interrupts disabled
+**********************************/
+static uint32_t SampleClock(unsigned int *counts)
+{
+	uint32_t ticks;
+
+	*counts = TA0R;
+	ticks = sync_ticks;
+	if ((TA0CCTL0 & CCIFG) && (*counts < (PWMPeriod/2)))
+	{
+		ticks++;
+	}
+	return ticks;
+}
+
+/**********************************
+ * MRFI_TimestampCapture
+ * Called by the radio driver on the end-of-frame edge. Returns the disciplined clock in timer counts
+**********************************/
+uint32_t MRFI_TimestampCapture(void)
+{
+	bspIState_t intState;
+	uint32_t ticks;
+	unsigned int counts;
+
+	BSP_ENTER_CRITICAL_SECTION(intState);
+	ticks = SampleClock(&counts);
+	BSP_EXIT_CRITICAL_SECTION(intState);
+	return ticks * PWMPeriod + counts;
+}
+
+/**********************************
+ * LoadDrift
+ * Recall the crystal drift estimate saved by a previous run so the servo starts out converged
+**********************************/
+static void LoadDrift(void)
+{
+	if (DriftFlash[0] == DRIFT_FLASH_KEY)
+	{
+		drift_q8 = *(int32_t*)(DriftFlash+2);
+	}
+}
+
+/**********************************
+ * SaveDrift
+ * Write the drift estimate to info flash. Only called once the clock is locked and the estimate
+ * has moved, since erasing the segment stalls the CPU and flash endurance is limited
+**********************************/
+static void SaveDrift(void)
+{
+	bspIState_t intState;
+	int32_t drift;
+	uint8_t *src = (uint8_t *)&drift;
+	uint8_t i;
+
+	BSP_ENTER_CRITICAL_SECTION(intState);
+	drift = drift_q8;
+	FCTL2 = FWKEY+FSSEL_1+FN4+FN1+FN0;	// MCLK/20 = 400kHz flash timing generator
+	FCTL3 = FWKEY;                  // Clear Lock bit
+	FCTL1 = FWKEY+ERASE;            // Set Erase bit
+	DriftFlash[0] = 0;              // Dummy write to erase Flash seg
+	FCTL1 = FWKEY+WRT;              // Set WRT bit for write operation
+	DriftFlash[0] = DRIFT_FLASH_KEY;
+	for (i=0; i<sizeof(drift); i++)
+	{
+		DriftFlash[2+i] = src[i];
+	}
+	FCTL1 = FWKEY;                  // Clear WRT bit
+	FCTL3 = FWKEY+LOCK;             // Set LOCK bit
+	BSP_EXIT_CRITICAL_SECTION(intState);
+}
+
+/**********************************
+ * BuildSyncMsg
+ * Pack the sync error statistics for the AP: flag, device address, lock state, last error (counts),
+ * peak |error| since the last report, drift (ppm), beacon count and the duration of the last link
+ * recovery in timer periods. Resets the per-report stats
+**********************************/
+static void BuildSyncMsg(void)
+{
+	bspIState_t intState;
+
+	BSP_ENTER_CRITICAL_SECTION(intState);
+	*(unsigned int*)(SyncMSG+0) = SYNC_MSG;
+	SyncMSG[2] = lAddr.addr[0];
+	SyncMSG[3] = (lock_count >= SYNC_LOCK_BEACONS);
+	*(int32_t*)(SyncMSG+4) = sync_err;
+	*(uint16_t*)(SyncMSG+8) = sync_err_peak;
+	*(int16_t*)(SyncMSG+10) = (int16_t)((drift_q8 * 3906) / PWMPeriod);	// 1e6/256 ~= 3906
+	*(uint16_t*)(SyncMSG+12) = sync_beacons;
+	*(uint16_t*)(SyncMSG+14) = recovery_ticks;
+	sync_err_peak = 0;
+	sync_beacons = 0;
+	BSP_EXIT_CRITICAL_SECTION(intState);
+}
+
 
 void main (void)
 {
 	uint8_t    done = 0;
+	uint8_t    resumed;
 	bspIState_t intState;
-	unsigned char test_msg[9];
 
 	RxBroadcastSem=0;
 	RxPeerFrameSem=0;
 
 	BSP_Init();	//init the board
+	LoadDrift();	//start from the last known crystal drift
 	InitTimer();	//setup the PWM generating timer
 
 	//set the device address from the one declared in the *_config_XX.dat file. Must be done before call to SMPL_Init()
@@ -149,14 +372,18 @@ void main (void)
 	}
 #endif
 
-	//init radio, register callback and try to join. Enables GIE at end
-	while (SMPL_SUCCESS != SMPL_Init(sCB))
+	//pick up the link saved by the last run if the AP still answers, otherwise join. Enables GIE at end
+	resumed = ResumeLink();
+	while (!resumed && SMPL_SUCCESS != SMPL_Init(sCB))
 	{
 		toggleLED(1);	//toggle LEDs during Join attempt
 		toggleLED(2);
 		SPIN_ABOUT_A_SECOND;
 	}
 
+	//take time messages straight from the radio ISR
+	SMPL_SetRxFastPath(SMPL_LINKID_USER_UUD, sTimeHook);
+
 	/* LEDs on solid to indicate successful join. */
 	if (!BSP_LED2_IS_ON())
 	{
@@ -167,8 +394,17 @@ void main (void)
 		toggleLED(1);
 	}
 
-	/* Unconditional link to AP which is listening due to successful join. */
-	linkTo();
+	/* Link to AP which is listening due to successful join. */
+	if (resumed)
+	{
+		toggleLED(1);	//LEDs off, as after a link
+		toggleLED(2);
+	}
+	else
+	{
+		linkTo();
+		SaveLink();
+	}
 
 	while (1)
 	{
@@ -190,11 +426,11 @@ void main (void)
 		//is it time to send a msg?
 		if (TxPeerFrameSem)
 		{
-			/* Set TID and designate which LED to toggle */
+			BuildSyncMsg();
 			done = 0;
 			while (!done)
 			{
-				if (SMPL_SUCCESS == SMPL_Send(sLinkID1, test_msg, sizeof(test_msg)))
+				if (SMPL_SUCCESS == SMPL_Send(sLinkID1, SyncMSG, sizeof(SyncMSG)))
 				{
 					//Just break out since there will be no ack.
 					BSP_ENTER_CRITICAL_SECTION(intState);
@@ -206,6 +442,20 @@ void main (void)
 			}
 		}
 
+		//AP went quiet or rebooted: look for it again. Returns after a bounded number of tries so
+		//the loop keeps running; it's called again on the next pass until the AP is back
+		if (ap_restarted || link_lost)
+		{
+			reacquire();
+		}
+
+		//persist a freshly converged drift estimate
+		if (drift_save_pending)
+		{
+			drift_save_pending = 0;
+			SaveDrift();
+		}
+
 		// Have we received a msg?
 		if (RxPeerFrameSem)
 		{
@@ -250,6 +500,163 @@ static void linkTo()
 
 }
 
+/**********************************
+ * reacquire
+ * Get back under AP control after the link watchdog expired or the AP rebooted. A silent AP, a
+ * fade or a channel change leaves the AP's end of the link in place, so the link the stack still
+ * holds is pinged first, with no join. If that fails, or the AP rebooted and forgot us, the join
+ * and link exchanges are repeated; the stack is already up so there's no radio re-init. Each is
+ * tried at most REACQUIRE_TRIES times with a doubling wait. Returns 1 once the AP is back, 0 if the caller should try again later
+**********************************/
+static uint8_t reacquire(void)
+{
+	connInfo_t *pCInfo;
+	bspIState_t intState;
+	uint16_t wait = REACQUIRE_WAIT_MS;
+	uint8_t tries;
+
+	if (ap_restarted || SMPL_SUCCESS != nwk_ping(sLinkID1))
+	{
+		//the AP no longer knows this connection; free it so the link below can reuse the slot
+		pCInfo = nwk_getConnInfo(sLinkID1);
+		if (pCInfo)
+		{
+			nwk_freeConnection(pCInfo);
+		}
+		sLinkID1 = 0;
+
+		for (tries = 0; SMPL_SUCCESS != SMPL_Init(sCB); wait = (wait < REACQUIRE_WAIT_MAX_MS/2) ? 2*wait : REACQUIRE_WAIT_MAX_MS)
+		{
+			toggleLED(1);
+			if (++tries == REACQUIRE_TRIES)
+			{
+				return 0;
+			}
+			NWK_DELAY(wait);
+		}
+		for (tries = 0; SMPL_SUCCESS != SMPL_Link(&sLinkID1); wait = (wait < REACQUIRE_WAIT_MAX_MS/2) ? 2*wait : REACQUIRE_WAIT_MAX_MS)
+		{
+			toggleLED(2);
+			if (++tries == REACQUIRE_TRIES)
+			{
+				return 0;
+			}
+			NWK_DELAY(wait);
+		}
+		SMPL_Ioctl( IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_RXON, 0);
+		SaveLink();
+	}
+
+	if (BSP_LED1_IS_ON())
+	{
+		toggleLED(1);
+	}
+	if (BSP_LED2_IS_ON())
+	{
+		toggleLED(2);
+	}
+
+	//make sure the time hook is in place; setting it again just replaces it
+	SMPL_SetRxFastPath(SMPL_LINKID_USER_UUD, sTimeHook);
+
+	//restart the watchdog so it fires again if the AP stays quiet
+	BSP_ENTER_CRITICAL_SECTION(intState);
+	ap_restarted = 0;
+	link_lost = 0;
+	link_idle_ticks = 0;
+	BSP_EXIT_CRITICAL_SECTION(intState);
+	return 1;
+}
+
+/**********************************
+ * LinkSum
+ * Checksum over the saved network context
+**********************************/
+static uint8_t LinkSum(const uint8_t *p, uint16_t len)
+{
+	uint8_t sum = 0;
+
+	while (len--)
+	{
+		sum += *p++;
+	}
+	return sum;
+}
+
+/**********************************
+ * ResumeLink
+ * Bring the stack up from the network context saved by SaveLink instead of joining and linking.
+ * The NWK rejects an image from a different structure version or size and pings the AP once to
+ * make sure it's still there. Returns 0 if nothing usable was saved or the AP didn't answer, in
+ * which case the normal join and link follow. Boot only: SMPL_Resume refuses a running stack
+**********************************/
+static uint8_t ResumeLink(void)
+{
+	ioctlNVObj_t nv;
+	uint8_t *image = LinkFlash + LINK_FLASH_IMAGE_OS;
+
+	if (LinkFlash[0] != LINK_FLASH_KEY)
+	{
+		return 0;
+	}
+	nv.objVersion = LinkFlash[2];
+	nv.objLen = LinkFlash[4] | (LinkFlash[5] << 8);
+	nv.objPtr = &image;
+	if (nv.objLen > sizeof(LinkFlash) - LINK_FLASH_IMAGE_OS || LinkFlash[3] != LinkSum(image, nv.objLen))
+	{
+		return 0;
+	}
+	if (SMPL_SUCCESS != SMPL_Resume(sCB, &nv, LinkFlash[1]))
+	{
+		return 0;
+	}
+	sLinkID1 = LinkFlash[1];
+
+	//same radio state linkTo leaves behind
+	SMPL_Ioctl( IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_RXON, 0);
+	return 1;
+}
+
+/**********************************
+ * SaveLink
+ * Write the network context (connection table, tokens, channel and AP address) to info flash
+ * after a join and link. The key byte goes in last so a reset part way through leaves the
+ * segment invalid rather than half written
+**********************************/
+static void SaveLink(void)
+{
+	ioctlNVObj_t nv;
+	uint8_t *image;
+	bspIState_t intState;
+	uint16_t i;
+
+	nv.objPtr = &image;
+	if (SMPL_SUCCESS != SMPL_Ioctl(IOCTL_OBJ_NVOBJ, IOCTL_ACT_GET, &nv) || nv.objLen > sizeof(LinkFlash) - LINK_FLASH_IMAGE_OS)
+	{
+		return;	// doesn't fit the segment: resets will join as before
+	}
+
+	BSP_ENTER_CRITICAL_SECTION(intState);
+	FCTL2 = FWKEY+FSSEL_1+FN4+FN1+FN0;	// MCLK/20 = 400kHz flash timing generator
+	FCTL3 = FWKEY;                  // Clear Lock bit
+	FCTL1 = FWKEY+ERASE;            // Set Erase bit
+	LinkFlash[0] = 0;               // Dummy write to erase Flash seg
+	FCTL1 = FWKEY+WRT;              // Set WRT bit for write operation
+	LinkFlash[1] = sLinkID1;
+	LinkFlash[2] = nv.objVersion;
+	LinkFlash[3] = LinkSum(image, nv.objLen);
+	LinkFlash[4] = nv.objLen & 0xFF;
+	LinkFlash[5] = nv.objLen >> 8;
+	for (i=0; i<nv.objLen; i++)
+	{
+		LinkFlash[LINK_FLASH_IMAGE_OS+i] = image[i];
+	}
+	LinkFlash[0] = LINK_FLASH_KEY;
+	FCTL1 = FWKEY;                  // Clear WRT bit
+	FCTL3 = FWKEY+LOCK;             // Set LOCK bit
+	BSP_EXIT_CRITICAL_SECTION(intState);
+}
+
 
 void toggleLED(uint8_t which)
 {
@@ -282,6 +689,150 @@ static uint8_t sCB(linkID_t lid)
 	return 1;
 }
 
+/***********************************************************
+ * processTimeMsg
+ * Apply a time message to the disciplined clock. Runs in the radio
+ * Rx ISR (see sTimeHook) so the clock is sampled right after the
+ * beacon arrives rather than whenever the main loop gets to it.
+ * rx_stamp is when the beacon finished arriving
+***********************************************************/
+static void processTimeMsg(const uint8_t *msg, uint32_t rx_stamp)
+{
+	bspIState_t intState;
+	uint32_t ap_ticks = *(uint32_t*)(msg+2);	// AP time in timer periods
+	uint8_t seq = msg[6];
+	uint8_t nonce = msg[7];	// picked at random by the AP at boot, never 0
+	uint32_t prev_tx_stamp = *(uint32_t*)(msg+8);	// when the AP finished sending the previous beacon
+	uint32_t now_ticks;
+	unsigned int now_counts;
+	int32_t diff, adj;
+	uint16_t n, abs_err;
+
+	BSP_ENTER_CRITICAL_SECTION(intState);	//protect from possible interrupts until we've written all values that might be used by the ISR
+
+	now_ticks = SampleClock(&now_counts);
+	diff = (int32_t)(ap_ticks - now_ticks);
+	n = (uint16_t)(now_ticks - last_beacon_tick);
+	last_beacon_tick = now_ticks;
+	if (n == 0)
+	{
+		n = 1;
+	}
+
+	link_idle_ticks = 0;
+	link_lost = 0;	// the AP is talking again; no need to look for it
+	// A late beacon can make the AP's clock look behind ours, so only a new boot nonce means the AP
+	// restarted and forgot our link. A nonce of 0 is an AP that doesn't send one
+	if (!ap_nonce)
+	{
+		ap_nonce = nonce;
+	}
+	else if (nonce && nonce != ap_nonce)
+	{
+		ap_nonce = nonce;
+		ap_restarted = 1;
+		SlewTo(0, last_cmd[1], last_cmd[2], FAILSAFE_SLEW_PERIODS);
+		if (!recovering)
+		{
+			recovering = 1;
+			recovery_ticks = 0;
+		}
+	}
+
+	if (!synced || diff > SYNC_STEP_TICKS || diff < -SYNC_STEP_TICKS)
+	{
+		// too far off to slew (or first beacon): step the tick count and let the servo take the remainder
+		sync_ticks += diff;
+		last_beacon_tick += diff;
+		rx_stamp += diff * PWMPeriod;	// keep this beacon's stamp in the new timebase
+		slew_q8 = 0;
+		if (lock_count >= SYNC_LOCK_BEACONS)
+		{
+			TxPeerFrameSem = 1;	// lost lock: ask the AP for rapid time msgs again
+		}
+		lock_count = 0;
+		sync_steps++;
+		synced = 1;
+	}
+	else if (beacon_stamp_ok && seq == (uint8_t)(beacon_seq + 1))
+	{
+		// both ends stamped the same end-of-frame edge of the previous beacon, so the difference
+		// is the clock error free of CCA backoff, queueing and main loop latency
+		sync_err = (int32_t)(prev_tx_stamp - beacon_rx_stamp);
+
+		// PI servo: the integral term learns the crystal drift, the proportional term slews out the phase error
+		drift_q8 += (sync_err * 256 / SYNC_KI_DIV) / n;
+		if (drift_q8 > SYNC_MAX_ADJ_Q8) drift_q8 = SYNC_MAX_ADJ_Q8;
+		else if (drift_q8 < -SYNC_MAX_ADJ_Q8) drift_q8 = -SYNC_MAX_ADJ_Q8;
+		adj = (sync_err * 256 / SYNC_KP_DIV) / n;
+		if (adj > SYNC_MAX_ADJ_Q8 - drift_q8) adj = SYNC_MAX_ADJ_Q8 - drift_q8;
+		else if (adj < -SYNC_MAX_ADJ_Q8 - drift_q8) adj = -SYNC_MAX_ADJ_Q8 - drift_q8;
+		slew_q8 = adj;
+
+		abs_err = (uint16_t)((sync_err < 0) ? -sync_err : sync_err);
+		if (abs_err > sync_err_peak) sync_err_peak = abs_err;
+		if (abs_err < SYNC_LOCK_COUNTS)
+		{
+			if (lock_count < 255) lock_count++;
+			if (lock_count == SYNC_LOCK_BEACONS)	// just locked; store the estimate if it has moved
+			{
+				TxPeerFrameSem = 1;	// and tell the AP so it can slow the time msgs down
+				diff = drift_q8 - *(int32_t*)(DriftFlash+2);
+				if ((DriftFlash[0] != DRIFT_FLASH_KEY) || diff > DRIFT_SAVE_DELTA_Q8 || diff < -DRIFT_SAVE_DELTA_Q8)
+				{
+					drift_save_pending = 1;
+				}
+			}
+		}
+		else
+		{
+			if (lock_count >= SYNC_LOCK_BEACONS)
+			{
+				TxPeerFrameSem = 1;	// lost lock: ask the AP for rapid time msgs again
+			}
+			lock_count = 0;
+		}
+	}
+
+	// remember this beacon so the AP's transmit stamp in the next one can be paired with it
+	beacon_seq = seq;
+	beacon_rx_stamp = rx_stamp;
+	beacon_stamp_ok = 1;
+
+	if (++sync_beacons >= SYNC_STAT_BEACONS && !TxPeerFrameSem)
+	{
+		TxPeerFrameSem++;	//report sync statistics to the AP
+	}
+
+	BSP_EXIT_CRITICAL_SECTION(intState);
+
+	return;
+}
+
+/***********************************************************
+ * sTimeHook
+ * Rx fast path for the broadcast link: time messages are taken
+ * straight from the radio ISR, everything else is queued for
+ * the main loop as usual
+***********************************************************/
+static uint8_t sTimeHook(linkID_t lid, const uint8_t *msg, uint8_t len, uint32_t stamp)
+{
+	uint16_t aligned[(TIME_MSG_LEN+1)/2];	//the payload isn't word aligned in the frame buffer
+
+	if (len != TIME_MSG_LEN)
+	{
+		return 0;
+	}
+	memcpy(aligned, msg, TIME_MSG_LEN);
+	if (aligned[0] != TIME_MSG)
+	{
+		return 0;
+	}
+	processTimeMsg((const uint8_t *)aligned, stamp);
+
+	return 1;
+}
+
 /***********************************************************
  * processMessage
  * Receive an aligned and formatted data message and decode it
@@ -290,46 +841,32 @@ static uint8_t sCB(linkID_t lid)
 ***********************************************************/
 static void processMessage(linkID_t lid, uint8_t *msg, uint8_t len)
 {
-	int tempAmp, tempFreq, tempPhase;
-	float tempAmpF, tempFreqF, tempPhaseF;
+	unsigned int tempAmp, tempFreq, tempPhase;
 	bspIState_t intState;
 	unsigned int flag=0;
 	//parse the received message and set the PWM numbers accordingly
 	flag=*(unsigned int*)(msg+0);
-	//be sure the initial message alignment is what we expect, that it matches an expected message type, and it's only 6 bytes
-	if ((flag == TIME_MSG) && (lid == SMPL_LINKID_USER_UUD) && len == 6)
-	{
-		BSP_ENTER_CRITICAL_SECTION(intState);	//protect from possible interrupts until we've written all values that might be used by the ISR
-
-        synced_time = *(float*)(msg+2); // jam the time parameter that we just received from the radio
-        if(time_since_connect < 0) {    // initialize everything if first time receiving time message
-            time_since_connect = time_of_last_msg = synced_time;
-            time_since_msg = 0.0;
-        }
-        else {
-            period = (int)((time_since_msg) / (synced_time - time_of_last_msg) * TA0CCR0);
-            time_of_last_msg = synced_time; // resync these values
-            time_since_msg = 0.0;
-        }
-
-		BSP_EXIT_CRITICAL_SECTION(intState);
-	}
-	else if (flag == MOT_MSG)
+	//be sure the initial message alignment is what we expect, that it matches an expected message type, and it's the right length
+	if (flag == MOT_MSG)
 	{
 		int offset=6*(lAddr.addr[0]-1)+2;	//use this as an index into the received byte array. the 6 corresponds to 6 bytes of data per motor and the 2 accounts for the 2 bytes of flag data
 		tempAmp=*(unsigned int*)(msg+offset);
-		tempAmpF=((float)tempAmp)/500;	//convert to float and rescale since we prescaled to send as an int
 		tempFreq=*(unsigned int*)(msg+offset+2);
-		tempFreqF=((float)tempFreq)/500;
 		tempPhase=*(unsigned int*)(msg+offset+4);
-		tempPhaseF=((float)tempPhase)/500;
 
-		// Copy to the system-level values and reset the time
 		BSP_ENTER_CRITICAL_SECTION(intState);    // protect from possible interrupts until we've written all values that might be used by the ISR
-		amplitude = tempAmpF;
-		frequency = tempFreqF;
-		phase = tempPhaseF;
-		start_time = synced_time;                // update the time at which we start the sinusoid so we have unambiguous phase
+		link_idle_ticks = 0;
+		if (recovering)
+		{
+			recovering = 0;
+			TxPeerFrameSem = 1;	// report how long we were out of control
+		}
+		// the host streams the same command repeatedly; nothing to do if it hasn't changed
+		if (tempAmp != last_cmd[0] || tempFreq != last_cmd[1] || tempPhase != last_cmd[2])
+		{
+			// Hand the new targets to the ISR, which slews toward them without restarting the sinusoid
+			SlewTo(tempAmp, tempFreq, tempPhase, SLEW_PERIODS);
+		}
 		BSP_EXIT_CRITICAL_SECTION(intState);
 	}
 
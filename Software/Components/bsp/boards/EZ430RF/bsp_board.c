@@ -43,6 +43,7 @@
  * ------------------------------------------------------------------------------------------------
  */
 #include "bsp.h"
+#include "bsp_macros.h"
 #include "bsp_config.h"
 
 /* ------------------------------------------------------------------------------------------------
@@ -54,15 +55,25 @@
  *                                            Defines
  * ------------------------------------------------------------------------------------------------
  */
-#define BSP_TIMER_CLK_MHZ   (BSP_CONFIG_CLOCK_MHZ_SELECT)
+/* longest single wait on the one-shot timer: half the count range */
+#define BSP_TIMER_MAX_TICKS   0x7FFF
+
+/* ------------------------------------------------------------------------------------------------
+ *                                            Local Prototypes
+ * ------------------------------------------------------------------------------------------------
+ */
+static void BSP_TimerProgram(void);
+static void BSP_TimerWake(void);
 
 /* ------------------------------------------------------------------------------------------------
  *                                            Local Variables
  * ------------------------------------------------------------------------------------------------
  */
-#if defined(SW_TIMER)
-static uint8_t sIterationsPerUsec = 0;
-#endif
+/* armed timeouts, soonest first. TBCCR0 holds the expiry of the first. */
+static bspTimer_t * volatile spTimerList = 0;
+
+/* number of BSP_TimerWait() calls sleeping until a timeout */
+volatile uint8_t bspTimerSleepers = 0;
 
 /**************************************************************************************************
  * @fn          BSP_EARLY_INIT
@@ -104,77 +115,254 @@ void BSP_InitBoard(void)
   DCOCTL  = BSP_CONFIG_MSP430_DCOCTL;
   BCSCTL1 = BSP_CONFIG_MSP430_BCSCTL1;
 
-  /* Configure TimerA for use by the delay function */
+  /* TimerB free runs from SMCLK/8 for the delay function and the one-shot
+   * timer. TimerA is left to the application.
+   */
+  TBCTL = TBSSEL_2 | ID_3 | MC_2 | TBCLR;
+}
 
-  /* Reset the timer */
-  TACTL |= TACLR; /* Set the TACLR */
+/**************************************************************************************************
+ * @fn          BSP_Delay
+ *
+ * @brief       Sleep for the requested amount of time. Counts the free running TimerB so
+ *              it needs no calibration, is safe to call from any context and is not
+ *              stretched by interrupts that come in during the wait. Rounded up to the next
+ *              timer tick.
+ *
+ * @param       # of microseconds to sleep.
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+void BSP_Delay(uint16_t usec)
+{
+  uint32_t ticks = ((uint32_t)usec * BSP_TIMER_TICKS_PER_MS + 999) / 1000;
+  uint16_t last  = TBR;
+  uint16_t now;
 
-  /* Clear all settings */
-  TACTL = 0x0;
+  while (ticks)
+  {
+    now    = TBR;
+    ticks -= ((uint16_t)(now - last) < ticks) ? (uint16_t)(now - last) : ticks;
+    last   = now;
+  }
+}
 
-  /* Select the clk source to be - SMCLK (Sub-Main CLK)*/
-  TACTL |= TASSEL_2;
+/**************************************************************************************************
+ * @fn          BSP_TimerNow
+ *
+ * @brief       Read the one-shot timer's free running count.
+ *
+ * @param       none
+ *
+ * @return      count, BSP_TIMER_TICKS_PER_MS per millisecond
+ **************************************************************************************************
+ */
+uint16_t BSP_TimerNow(void)
+{
+  return TBR;
+}
+
+/**************************************************************************************************
+ * @fn          BSP_TimerArm
+ *
+ * @brief       Call a function from the timer ISR when the free running count reaches a
+ *              value. Replaces any earlier request on the same timer. The expiry must be
+ *              less than half the count range away. Any number of timers may be armed.
+ *
+ * @param       pT   - timer. must stay put until it expires or is disarmed.
+ *              when - count at which to expire
+ *              pF   - function to call
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+void BSP_TimerArm(bspTimer_t *pT, uint16_t when, void (*pF)(void))
+{
+  bspTimer_t * volatile *pp;
+  bspIState_t s;
 
-#if defined(SW_TIMER)
-#define MHZ_CLOCKS_PER_USEC      BSP_CLOCK_MHZ
-#define MHZ_CLOCKS_PER_ITERATION 10
+  BSP_ENTER_CRITICAL_SECTION(s);
 
-  sIterationsPerUsec = (uint8_t)(((MHZ_CLOCKS_PER_USEC)/(MHZ_CLOCKS_PER_ITERATION))+.5);
+  BSP_TimerDisarm(pT);
 
-  if (!sIterationsPerUsec)
-  {
-    sIterationsPerUsec = 1;
-  }
-#endif   /* SW_TIMER */
+  pT->when = when;
+  pT->pF   = pF;
+
+  /* after any timer expiring at the same count */
+  for (pp = &spTimerList; *pp && ((int16_t)((*pp)->when - when) <= 0); pp = &(*pp)->next) ;
+  pT->next = *pp;
+  *pp      = pT;
+
+  BSP_TimerProgram();
+
+  BSP_EXIT_CRITICAL_SECTION(s);
 }
 
 /**************************************************************************************************
- * @fn          BSP_Delay
+ * @fn          BSP_TimerDisarm
  *
- * @brief       Sleep for the requested amount of time.
+ * @brief       Cancel a timer. No harm is done if it isn't armed.
  *
- * @param       # of microseconds to sleep.
+ * @param       pT - timer
  *
  * @return      none
  **************************************************************************************************
  */
-void BSP_Delay(uint16_t usec)
-#if !defined(SW_TIMER)
+void BSP_TimerDisarm(bspTimer_t *pT)
 {
+  bspTimer_t * volatile *pp;
+  bspIState_t s;
 
-  TAR = 0; /* initial count */
-  TACCR0 = BSP_TIMER_CLK_MHZ*usec; /* compare count. (delay in ticks) */
+  BSP_ENTER_CRITICAL_SECTION(s);
 
-  /* Start the timer in UP mode */
-  TACTL |= MC_1;
+  for (pp = &spTimerList; *pp; pp = &(*pp)->next)
+  {
+    if (*pp == pT)
+    {
+      *pp = pT->next;
+      BSP_TimerProgram();
+      break;
+    }
+  }
 
-  /* Loop till compare interrupt flag is set */
-  while(!(TACCTL0 & CCIFG));
+  BSP_EXIT_CRITICAL_SECTION(s);
+}
 
-  /* Stop the timer */
-  TACTL &= ~(MC_1);
+/**************************************************************************************************
+ * @fn          BSP_TimerWait
+ *
+ * @brief       Wait for a number of timer ticks. With interrupts enabled the CPU sleeps in
+ *              LPM0 until a timeout expires, so interrupts are serviced during the wait
+ *              without stretching it. With interrupts off the count is polled instead.
+ *              A wait inside an ISR that interrupted another sleeping wait also polls: the
+ *              wakeup for its timeout would clear the sleep bits of the ISR, not of the
+ *              interrupted wait, and the interrupted wait would then miss its own. For
+ *              the same reason an ISR that enables interrupts must use
+ *              BSP_TIMER_WAKE_ON_EXIT() so a sleeping wait it interrupted looks again.
+ *
+ * @param       ticks - ticks to wait, BSP_TIMER_TICKS_PER_MS per millisecond
+ *              pStop - wait ends early when this becomes non-zero. An ISR that sets it must
+ *                      use BSP_TIMER_WAKE_ON_EXIT(). may be NULL.
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+void BSP_TimerWait(uint32_t ticks, volatile uint8_t *pStop)
+{
+  bspTimer_t t;
+  bspTimer_t *p;
+  uint16_t   chunk;
+  uint16_t   start;
 
-  /* Clear the interrupt flag */
-   TACCTL0 &= ~CCIFG;
+  while (ticks && !(pStop && *pStop))
+  {
+    chunk  = (ticks > BSP_TIMER_MAX_TICKS) ? BSP_TIMER_MAX_TICKS : (uint16_t)ticks;
+    ticks -= chunk;
+    start  = TBR;
+
+    if (!BSP_INTERRUPTS_ARE_ENABLED() || bspTimerSleepers)
+    {
+      while (((uint16_t)(TBR - start) < chunk) && !(pStop && *pStop)) ;
+      continue;
+    }
+
+    BSP_TimerArm(&t, start + chunk, BSP_TimerWake);
+    bspTimerSleepers++;
+
+    for (;;)
+    {
+      /* check and sleep with interrupts off so a wakeup in between isn't lost.
+       * entering LPM0 enables them again.
+       */
+      BSP_DISABLE_INTERRUPTS();
+      for (p = spTimerList; p && (p != &t); p = p->next) ;
+      if (!p || (pStop && *pStop))
+      {
+        BSP_ENABLE_INTERRUPTS();
+        break;
+      }
+      __bis_SR_register(LPM0_bits | GIE);
+    }
+
+    bspTimerSleepers--;
+    BSP_TimerDisarm(&t);
+  }
 }
 
+/**************************************************************************************************
+ * @fn          BSP_TimerProgram
+ *
+ * @brief       Set the compare channel for the first timer in the list. Interrupts must be
+ *              off.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void BSP_TimerProgram(void)
+{
+  if (!spTimerList)
+  {
+    TBCCTL0 = 0;
+    return;
+  }
+
+  TBCCR0  = spTimerList->when;
+  TBCCTL0 = CCIE;
 
-#else  /* !SW_TIMER */
+  /* don't lose an expiry that is already due */
+  if ((int16_t)(TBR - spTimerList->when) >= 0)
+  {
+    TBCCTL0 |= CCIFG;
+  }
+}
 
+/**************************************************************************************************
+ * @fn          BSP_TimerWake
+ *
+ * @brief       BSP_TimerWait() timeout. The ISR wakes the CPU on exit.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void BSP_TimerWake(void)
+{
+}
 
+/**************************************************************************************************
+ * @fn          BSP_TimerIsr
+ *
+ * @brief       The first timer in the list expired. Run every timer that is due. Each is
+ *              taken off the list before its function is called so the function may arm it
+ *              again.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+BSP_ISR_FUNCTION( BSP_TimerIsr, TIMERB0_VECTOR )
 {
-  /* Declared 'volatile' in case User optimizes for speed. This will
-   * prevent the optimizer from eliminating the loop completely. But
-   * it also generates more code...
-   */
-  volatile uint16_t repeatCount = sIterationsPerUsec*usec;
+  bspTimer_t *pT;
+
+  while ((pT = spTimerList) && ((int16_t)(TBR - pT->when) >= 0))
+  {
+    spTimerList = pT->next;
+    if (pT->pF)
+    {
+      pT->pF();
+    }
+  }
 
-  while (repeatCount--) ;
+  BSP_TimerProgram();
 
-  return;
+  BSP_TIMER_WAKE_ON_EXIT();
 }
 
-#endif  /* !SW_TIMER */
 /**************************************************************************************************
 */
 
@@ -74,6 +74,34 @@
 void BSP_InitBoard(void);
 void BSP_Delay(uint16_t usec);
 
+
+/* ------------------------------------------------------------------------------------------------
+ *                                       One-shot Timer
+ * ------------------------------------------------------------------------------------------------
+ */
+#define BSP_TIMER_TICKS_PER_MS    ((uint16_t)(BSP_CONFIG_CLOCK_MHZ * 1000 / 8))
+
+/* A pending timeout. Owned by the caller and linked into a list sorted by
+ * expiry while armed. One TimerB compare channel serves the whole list.
+ */
+typedef struct bspTimer_s
+{
+  struct bspTimer_s *next;
+  uint16_t           when;
+  void             (*pF)(void);
+} bspTimer_t;
+
+uint16_t BSP_TimerNow(void);
+void     BSP_TimerArm(bspTimer_t *, uint16_t, void (*)(void));
+void     BSP_TimerDisarm(bspTimer_t *);
+void     BSP_TimerWait(uint32_t, volatile uint8_t *);
+
+/* ISRs that can end a BSP_TimerWait() early, and ISRs that enable interrupts
+ * (a timeout may expire while they run), must wake the CPU on exit.
+ */
+extern volatile uint8_t bspTimerSleepers;
+#define BSP_TIMER_WAKE_ON_EXIT()  st( if (bspTimerSleepers) { __bic_SR_register_on_exit(LPM0_bits); } )
+
 /* ************************************************************************************************
  *                                   Compile Time Integrity Checks
  * ************************************************************************************************
@@ -67,6 +67,9 @@ BSP_ISR_FUNCTION( BSP_GpioPort1Isr, PORT2_VECTOR )
    *  include the following function call.
    */
   MRFI_GpioIsr();
+
+  /* the radio may have ended a wait in BSP_TimerWait() */
+  BSP_TIMER_WAKE_ON_EXIT();
 }
 
 
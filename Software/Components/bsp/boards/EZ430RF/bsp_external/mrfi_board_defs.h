@@ -127,6 +127,14 @@
 #define MRFI_SPI_READ_BYTE()                  UCB0RXBUF
 #define MRFI_SPI_WAIT_DONE()                  while(!(IFG2 & UCB0RXIFG));
 
+/* SPI byte done interrupt, for the queued transfers (MRFI_SPI_ASYNC). USCI B0
+ * shares the vector with the UART on USCI A0 so that ISR must call mrfiSpiIsr()
+ * when the interrupt is enabled and the flag is set.
+ */
+#define MRFI_SPI_INT_VECTOR                   USCIAB0RX_VECTOR
+#define MRFI_SPI_ENABLE_RX_INT()              st( IE2 |=  UCB0RXIE; )
+#define MRFI_SPI_DISABLE_RX_INT()             st( IE2 &= ~UCB0RXIE; )
+
 /* SPI critical section macros */
 typedef bspIState_t mrfiSpiIState_t;
 #define MRFI_SPI_ENTER_CRITICAL_SECTION(x)    BSP_ENTER_CRITICAL_SECTION(x)
@@ -140,7 +148,11 @@ typedef bspIState_t mrfiSpiIState_t;
  *    Data Order      :  MSB transmitted first
  *    Clock Polarity  :  low when idle
  *    Clock Phase     :  sample leading edge
+ *
+ *  Burst access is limited to 6.5 MHz. Use the fastest SMCLK divide that
+ *  stays within it.
  */
+#define MRFI_SPI_CLK_DIV                  ((uint8_t)((BSP_CONFIG_CLOCK_MHZ + 6.49) / 6.5))
 
 /* initialization macro */
 #define MRFI_SPI_INIT() \
@@ -148,7 +160,7 @@ st ( \
   UCB0CTL1 = UCSWRST;                           \
   UCB0CTL1 = UCSWRST | UCSSEL1;                 \
   UCB0CTL0 = UCCKPH | UCMSB | UCMST | UCSYNC;   \
-  UCB0BR0  = 2;                                 \
+  UCB0BR0  = MRFI_SPI_CLK_DIV;                  \
   UCB0BR1  = 0;                                 \
   MRFI_SPI_CONFIG_PORT();                       \
   UCB0CTL1 &= ~UCSWRST;                         \
@@ -82,6 +82,10 @@
 #error "ERROR: Radio family is not defined."
 #endif
 
+#if (defined MRFI_TIMESTAMP) && !(defined MRFI_RADIO_FAMILY1)
+#error "ERROR: Frame timestamps are only supported by radio family 1."
+#endif
+
 
 /**************************************************************************************************
  */
@@ -139,10 +139,17 @@
  *                                          Typdefs
  * ------------------------------------------------------------------------------------------------
  */
+/* The frame buffer is last so code using MRFI can hand out buffers cut short
+ * for frames that are known to be small. Nothing past the frame length is read
+ * or written.
+ */
 typedef struct
 {
-  uint8_t frame[MRFI_MAX_FRAME_SIZE];
   uint8_t rxMetrics[MRFI_RX_METRICS_SIZE];
+#ifdef MRFI_TIMESTAMP
+  uint32_t timestamp;   /* MRFI_TimestampCapture() at the end-of-frame SYNC edge */
+#endif
+  uint8_t frame[MRFI_MAX_FRAME_SIZE];
 } mrfiPacket_t;
 
 
@@ -152,7 +159,25 @@ typedef struct
  */
 void    MRFI_Init(void);
 uint8_t MRFI_Transmit(mrfiPacket_t *, uint8_t);
+#ifdef MRFI_RADIO_FAMILY1
+#ifdef MRFI_TX_ASYNC
+/* The transmit can also run from radio and timer interrupts. The packet must
+ * stay put until the completion function is called from interrupt context.
+ */
+uint8_t MRFI_TransmitAsync(mrfiPacket_t *, uint8_t, void (*)(uint8_t));
+#endif
+uint8_t MRFI_TxBusy(void);
+/* The receive ISR reads the radio FIFO straight into a buffer reserved by the
+ * code using MRFI. No copy of the packet is kept in MRFI.
+ */
+#define MRFI_RX_IN_PLACE
+mrfiPacket_t *MRFI_RxBufferISR(uint8_t); /* populated by code using MRFI */
+#else
+#ifdef MRFI_TX_ASYNC
+#error ERROR: MRFI_TX_ASYNC is only supported on family1 radios
+#endif
 void    MRFI_Receive(mrfiPacket_t *);
+#endif
 void    MRFI_RxCompleteISR(void); /* populated by code using MRFI */
 uint8_t MRFI_GetRadioState(void);
 void    MRFI_RxOn(void);
@@ -167,8 +192,13 @@ void    MRFI_WakeUp(void);
 uint8_t MRFI_RandomByte(void);
 void    MRFI_DelayMs(uint16_t);
 void    MRFI_ReplyDelay(void);
+uint16_t MRFI_ReplyDelayMs(void);
 void    MRFI_PostKillSem(void);
 void    MRFI_SetRFPwr(uint8_t);
+#ifdef MRFI_TIMESTAMP
+uint32_t MRFI_TimestampCapture(void); /* populated by code using MRFI. called from ISR context */
+uint32_t MRFI_TxTimestamp(void);
+#endif
 
 /* ------------------------------------------------------------------------------------------------
  *                                       Global Constants
@@ -106,6 +106,8 @@
 #define MRFI_GDO_CCA            9
 #define MRFI_GDO_PA_PD          27  /* low when transmit is active, low during sleep */
 #define MRFI_GDO_LNA_PD         28  /* low when receive is active, low during sleep */
+#define MRFI_GDO_RX_FIFO_THR    0   /* high while the Rx FIFO is at or above the threshold */
+#define MRFI_GDO_TX_FIFO_THR    2   /* high while the Tx FIFO is at or above the threshold */
 
 /* ---------- Radio Abstraction ---------- */
 #if (defined MRFI_CC1100)
@@ -134,6 +136,23 @@
 /* GDO0 output pin configuration */
 #define MRFI_SETTING_IOCFG0     MRFI_GDO_SYNC
 
+#ifdef MRFI_STREAM_FIFO
+/* GDO2 output pin configuration. Used to drain the Rx FIFO while a frame
+ * longer than the FIFO is still arriving and to refill the Tx FIFO while one
+ * goes out.
+ */
+#define MRFI_SETTING_IOCFG2     MRFI_GDO_RX_FIFO_THR
+
+/* With FIFO_THR = 7 GDO2 rises when the Rx FIFO holds 32 bytes. In Tx it
+ * drops when the Tx FIFO holds fewer than 33, leaving room for 32.
+ */
+#define MRFI_FIFO_SIZE          64
+#define MRFI_FIFO_THR_BYTES     32
+
+/* RXBYTES fields */
+#define MRFI_RXBYTES_OVERFLOW   0x80
+#endif
+
 /* Main Radio Control State Machine control configuration:
  * Auto Calibrate - when going from IDLE to RX/TX
  * PO_TIMEOUT is extracted from SmartRF setting.
@@ -161,35 +180,27 @@
 /* FIFO threshold - this register has fields that need to be configured for the CC1101 */
 #define MRFI_SETTING_FIFOTHR    (0x07 | (SMARTRF_SETTING_FIFOTHR & (BV(4)|BV(5)|BV(6))))
 
-/* Max time we can be in a critical section within the delay function.
- * This could be fine-tuned by observing the overhead is calling the bsp delay
- * function. The overhead should be very small compared to this value.
- * Note that the max value for this must be less than 19 usec with the
- * default CLKCON.TICKSPD and CLKCON.CLOCKSPD settings and external 26 MHz
- * crystal as a clock source (which we use).
- *
- * Be careful of direct calls to Mrfi_DelayUsec().
- */
-#define MRFI_MAX_DELAY_US 16 /* usec */
-
 #define MRFI_PKTSTATUS_CCA BV(4)
 #define MRFI_PKTSTATUS_CS  BV(6)
 
-  /* The SW timer is calibrated by adjusting the call to the microsecond delay
-   * routine. This allows maximum calibration control with repects to the longer
-   * times requested by applicationsd and decouples internal from external calls
-   * to the microsecond routine which can be calibrated independently.
-   */
-#if defined(SW_TIMER)
-#define APP_USEC_VALUE    496
-#else
-#define APP_USEC_VALUE    1000
-#endif
+/* MRFI_TransmitAsync() states. MRFI_Transmit() holds the radio in the
+ * SYNC state so neither can start while the other runs.
+ */
+#define MRFI_TX_STATE_IDLE      0
+#define MRFI_TX_STATE_SYNC      1   /* MRFI_Transmit() is running */
+#define MRFI_TX_STATE_LOAD      2   /* queued write of the Tx FIFO is running */
+#define MRFI_TX_STATE_RSSI      3   /* Rx on for CCA, waiting for RSSI to be valid */
+#define MRFI_TX_STATE_CCA       4   /* STX sent, waiting to see if CCA passed */
+#define MRFI_TX_STATE_BACKOFF   5   /* CCA failed, random backoff before the retry */
+#define MRFI_TX_STATE_ON_AIR    6   /* transmitting, waiting for the end of the frame */
 
 /* ------------------------------------------------------------------------------------------------
  *                                           Macros
  * ------------------------------------------------------------------------------------------------
  */
+/* microseconds to one-shot timer ticks, rounded up */
+#define MRFI_USECS_TO_TICKS(us)   (((uint32_t)(us) * BSP_TIMER_TICKS_PER_MS + 999) / 1000)
+
 #define MRFI_SYNC_PIN_IS_HIGH()                     MRFI_GDO0_PIN_IS_HIGH()
 #define MRFI_ENABLE_SYNC_PIN_INT()                  MRFI_ENABLE_GDO0_INT()
 #define MRFI_DISABLE_SYNC_PIN_INT()                 MRFI_DISABLE_GDO0_INT()
@@ -202,10 +213,23 @@
 #define MRFI_CLEAR_PAPD_PIN_INT_FLAG()              MRFI_CLEAR_SYNC_PIN_INT_FLAG()
 #define MRFI_PAPD_INT_FLAG_IS_SET()                 MRFI_SYNC_PIN_INT_FLAG_IS_SET()
 #define MRFI_CONFIG_PAPD_FALLING_EDGE_INT()         MRFI_CONFIG_SYNC_PIN_FALLING_EDGE_INT()
+#define MRFI_CONFIG_PAPD_RISING_EDGE_INT()          MRFI_CONFIG_GDO0_RISING_EDGE_INT()
 
 #define MRFI_CONFIG_GDO0_AS_PAPD_SIGNAL()           mrfiSpiWriteReg(IOCFG0, MRFI_GDO_PA_PD)
 #define MRFI_CONFIG_GDO0_AS_SYNC_SIGNAL()           mrfiSpiWriteReg(IOCFG0, MRFI_GDO_SYNC)
 
+#define MRFI_FIFO_PIN_IS_HIGH()                     MRFI_GDO2_PIN_IS_HIGH()
+#define MRFI_ENABLE_FIFO_PIN_INT()                  MRFI_ENABLE_GDO2_INT()
+#define MRFI_DISABLE_FIFO_PIN_INT()                 MRFI_DISABLE_GDO2_INT()
+#define MRFI_FIFO_PIN_INT_IS_ENABLED()              MRFI_GDO2_INT_IS_ENABLED()
+#define MRFI_CLEAR_FIFO_PIN_INT_FLAG()              MRFI_CLEAR_GDO2_INT_FLAG()
+#define MRFI_FIFO_PIN_INT_FLAG_IS_SET()             MRFI_GDO2_INT_FLAG_IS_SET()
+#define MRFI_CONFIG_FIFO_PIN_RISING_EDGE_INT()      MRFI_CONFIG_GDO2_RISING_EDGE_INT()
+#define MRFI_CONFIG_FIFO_PIN_FALLING_EDGE_INT()     MRFI_CONFIG_GDO2_FALLING_EDGE_INT()
+
+#define MRFI_CONFIG_GDO2_AS_RX_FIFO_SIGNAL()        mrfiSpiWriteReg(IOCFG2, MRFI_GDO_RX_FIFO_THR)
+#define MRFI_CONFIG_GDO2_AS_TX_FIFO_SIGNAL()        mrfiSpiWriteReg(IOCFG2, MRFI_GDO_TX_FIFO_THR)
+
 
 /* There is no bit in h/w to tell if RSSI in the register is valid or not.
  * The hardware needs to be in RX state for a certain amount of time before
@@ -246,11 +270,14 @@ static const uint8_t mrfiRadioCfg[][2] =
 {
   /* internal radio configuration */
   {  IOCFG0,    MRFI_SETTING_IOCFG0       },
+#ifdef MRFI_STREAM_FIFO
+  {  IOCFG2,    MRFI_SETTING_IOCFG2       },
+#endif
   {  MCSM1,     MRFI_SETTING_MCSM1        }, /* CCA mode, RX_OFF_MODE and TX_OFF_MODE */
   {  MCSM0,     MRFI_SETTING_MCSM0        }, /* AUTO_CAL and XOSC state in sleep */
   {  PKTLEN,    MRFI_SETTING_PKTLEN       },
   {  PKTCTRL0,  MRFI_SETTING_PKTCTRL0     },
-#ifdef MRFI_CC1101
+#if (defined MRFI_CC1101) || (defined MRFI_STREAM_FIFO)
   {  FIFOTHR,   MRFI_SETTING_FIFOTHR      },
 #endif
 
@@ -289,11 +316,27 @@ static const uint8_t mrfiRadioCfg[][2] =
  */
 void MRFI_GpioIsr(void); /* this called from mrfi_board.c */
 static void Mrfi_SyncPinRxIsr(void);
+static uint8_t Mrfi_RxBytes(void);
+static void Mrfi_RxFlush(void);
+#ifdef MRFI_STREAM_FIFO
+static void Mrfi_FifoPinRxIsr(void);
+static void Mrfi_TxFifoRefill(uint8_t * pData, uint8_t len);
+#endif
+#ifdef MRFI_TX_ASYNC
+#ifdef MRFI_STREAM_FIFO
+static void Mrfi_TxFifoPinIsr(void);
+#endif
+static void Mrfi_TxLoaded(void);
+static void Mrfi_TxCcaStart(void);
+static void Mrfi_TxOnAir(void);
+static void Mrfi_TxTimerArm(uint32_t usec);
+static void Mrfi_TxTimerIsr(void);
+static void Mrfi_TxFinish(uint8_t result);
+#endif
 static void Mrfi_RxModeOn(void);
 static void Mrfi_RandomBackoffDelay(void);
 static void Mrfi_RxModeOff(void);
 static void Mrfi_DelayUsec(uint16_t howLong);
-static void Mrfi_DelayUsecSem(uint16_t howLong);
 static int8_t Mrfi_CalculateRssi(uint8_t rawValue);
 
 /* ------------------------------------------------------------------------------------------------
@@ -301,7 +344,6 @@ static int8_t Mrfi_CalculateRssi(uint8_t rawValue);
  * ------------------------------------------------------------------------------------------------
  */
 static uint8_t mrfiRadioState  = MRFI_RADIO_STATE_UNKNOWN;
-static mrfiPacket_t mrfiIncomingPacket;
 static uint8_t mrfiRndSeed = 0;
 
 /* reply delay support */
@@ -310,6 +352,35 @@ static volatile uint8_t  sReplyDelayContext = 0;
 static          uint16_t sReplyDelayScalar = 0;
 static          uint16_t sBackoffHelper = 0;
 
+#ifdef MRFI_TIMESTAMP
+/* time the last transmitted frame left the radio */
+static uint32_t mrfiTxTimestamp = 0;
+#endif
+
+#ifdef MRFI_STREAM_FIFO
+/* frame being read from the Rx FIFO while it arrives and the number of bytes
+ * of its body read so far. NULL between frames.
+ */
+static mrfiPacket_t *mrfiRxStreamPkt = NULL;
+static uint8_t       mrfiRxStreamGot = 0;
+#endif
+
+/* transmit state. an asynchronous transmit keeps the packet and completion
+ * function until it is done.
+ */
+static volatile uint8_t mrfiTxState = MRFI_TX_STATE_IDLE;
+#ifdef MRFI_TX_ASYNC
+static mrfiPacket_t    *mrfiTxPkt;
+static void           (*mrfiTxDone)(uint8_t);
+static uint8_t          mrfiTxType;
+static uint8_t          mrfiTxRetries;
+static int16_t          mrfiTxRssiWait;   /* usecs left of the RSSI valid wait */
+static bspTimer_t       mrfiTxTimer;      /* paces the transmit states */
+#ifdef MRFI_STREAM_FIFO
+static uint8_t          mrfiTxSent;       /* frame bytes written to the Tx FIFO */
+#endif
+#endif
+
 /**************************************************************************************************
  * @fn          MRFI_Init
  *
@@ -327,10 +398,11 @@ void MRFI_Init(void)
    *   -----------------
    */
 
-  memset(&mrfiIncomingPacket, 0x0, sizeof(mrfiIncomingPacket));
-
   /* initialize GPIO pins */
   MRFI_CONFIG_GDO0_PIN_AS_INPUT();
+#ifdef MRFI_STREAM_FIFO
+  MRFI_CONFIG_GDO2_PIN_AS_INPUT();
+#endif
 
   /* initialize SPI */
   mrfiSpiInit();
@@ -488,10 +560,6 @@ void MRFI_Init(void)
     sBackoffHelper = MRFI_BACKOFF_PERIOD_USECS + (sReplyDelayScalar>>5)*1000;
   }
 
-  /* Clean out buffer to protect against spurious frames */
-  memset(mrfiIncomingPacket.frame, 0x00, sizeof(mrfiIncomingPacket.frame));
-  memset(mrfiIncomingPacket.rxMetrics, 0x00, sizeof(mrfiIncomingPacket.rxMetrics));
-
   /* ------------------------------------------------------------------
    *    Configure interrupts
    *   ----------------------
@@ -509,6 +577,15 @@ void MRFI_Init(void)
   MRFI_CONFIG_SYNC_PIN_FALLING_EDGE_INT();
   MRFI_CLEAR_SYNC_PIN_INT_FLAG();
 
+#ifdef MRFI_STREAM_FIFO
+  /*
+   *  Configure the FIFO threshold interrupt. GDO2 goes high when the
+   *  receive FIFO fills to the threshold while a frame is arriving.
+   */
+  MRFI_CONFIG_FIFO_PIN_RISING_EDGE_INT();
+  MRFI_CLEAR_FIFO_PIN_INT_FLAG();
+#endif
+
   /* enable global interrupts */
   BSP_ENABLE_INTERRUPTS();
 }
@@ -528,13 +605,35 @@ void MRFI_Init(void)
  */
 uint8_t MRFI_Transmit(mrfiPacket_t * pPacket, uint8_t txType)
 {
+  bspIState_t s;
   uint8_t ccaRetries;
   uint8_t txBufLen;
+  uint8_t txFirst;
   uint8_t returnValue = MRFI_TX_RESULT_SUCCESS;
 
   /* radio must be awake to transmit */
   MRFI_ASSERT( mrfiRadioState != MRFI_RADIO_STATE_OFF );
 
+  /* An asynchronous transmit has the radio until it is done. Wait for it if
+   * its interrupts can run. Otherwise report a failed transmit.
+   */
+  for (;;)
+  {
+    BSP_ENTER_CRITICAL_SECTION(s);
+    if (mrfiTxState == MRFI_TX_STATE_IDLE)
+    {
+      mrfiTxState = MRFI_TX_STATE_SYNC;
+      BSP_EXIT_CRITICAL_SECTION(s);
+      break;
+    }
+    BSP_EXIT_CRITICAL_SECTION(s);
+
+    if (!BSP_INTERRUPTS_ARE_ENABLED())
+    {
+      return( MRFI_TX_RESULT_FAILED );
+    }
+  }
+
   /* Turn off reciever. We can ignore/drop incoming packets during transmit. */
   Mrfi_RxModeOff();
 
@@ -545,7 +644,16 @@ uint8_t MRFI_Transmit(mrfiPacket_t * pPacket, uint8_t txType)
    *    Write packet to transmit FIFO
    *   --------------------------------
    */
-  mrfiSpiWriteTxFifo(&(pPacket->frame[0]), txBufLen);
+#ifdef MRFI_STREAM_FIFO
+  /* A frame longer than the FIFO is written as far as it fits. The rest
+   * goes in while the frame is being sent.
+   */
+  txFirst = (txBufLen > MRFI_FIFO_SIZE) ? MRFI_FIFO_SIZE : txBufLen;
+  MRFI_CONFIG_GDO2_AS_TX_FIFO_SIGNAL();
+#else
+  txFirst = txBufLen;
+#endif
+  mrfiSpiWriteTxFifo(&(pPacket->frame[0]), txFirst);
 
 
   /* ------------------------------------------------------------------
@@ -557,9 +665,18 @@ uint8_t MRFI_Transmit(mrfiPacket_t * pPacket, uint8_t txType)
     /* Issue the TX strobe. */
     mrfiSpiCmdStrobe( STX );
 
+#ifdef MRFI_STREAM_FIFO
+    Mrfi_TxFifoRefill(&(pPacket->frame[txFirst]), txBufLen - txFirst);
+#endif
+
     /* Wait for transmit to complete */
     while(!MRFI_SYNC_PIN_INT_FLAG_IS_SET());
 
+#ifdef MRFI_TIMESTAMP
+    /* Same end-of-frame SYNC edge that the receiver timestamps */
+    mrfiTxTimestamp = MRFI_TimestampCapture();
+#endif
+
     /* Clear the interrupt flag */
     MRFI_CLEAR_SYNC_PIN_INT_FLAG();
   }
@@ -637,12 +754,21 @@ uint8_t MRFI_Transmit(mrfiPacket_t * pPacket, uint8_t txType)
         /* Clear the PA_PD int flag */
         MRFI_CLEAR_PAPD_PIN_INT_FLAG();
 
+#ifdef MRFI_STREAM_FIFO
+        Mrfi_TxFifoRefill(&(pPacket->frame[txFirst]), txBufLen - txFirst);
+#endif
+
         /* PA_PD signal stays LOW while in TX state and goes back to HIGH when
          * the radio transitions to RX state.
          */
         /* wait for transmit to complete */
         while (!MRFI_PAPD_PIN_IS_HIGH());
 
+#ifdef MRFI_TIMESTAMP
+        /* PA_PD rises with the end-of-frame SYNC edge that the receiver timestamps */
+        mrfiTxTimestamp = MRFI_TimestampCapture();
+#endif
+
         /* transmit done, break */
         break;
       }
@@ -695,6 +821,11 @@ uint8_t MRFI_Transmit(mrfiPacket_t * pPacket, uint8_t txType)
   /* Restore GDO_0 to be SYNC signal */
   MRFI_CONFIG_GDO0_AS_SYNC_SIGNAL();
 
+#ifdef MRFI_STREAM_FIFO
+  /* and GDO_2 to follow the receive FIFO */
+  MRFI_CONFIG_GDO2_AS_RX_FIFO_SIGNAL();
+#endif
+
   /* If the radio was in RX state when transmit was attempted,
    * put it back to Rx On state.
    */
@@ -703,326 +834,922 @@ uint8_t MRFI_Transmit(mrfiPacket_t * pPacket, uint8_t txType)
     Mrfi_RxModeOn();
   }
 
-  return( returnValue );
-}
-
+  mrfiTxState = MRFI_TX_STATE_IDLE;
 
-/**************************************************************************************************
- * @fn          MRFI_Receive
- *
- * @brief       Copies last packet received to the location specified.
- *              This function is meant to be called after the ISR informs
- *              higher level code that there is a newly received packet.
- *
- * @param       pPacket - pointer to location of where to copy received packet
- *
- * @return      none
- **************************************************************************************************
- */
-void MRFI_Receive(mrfiPacket_t * pPacket)
-{
-  *pPacket = mrfiIncomingPacket;
+  return( returnValue );
 }
 
 
+#ifdef MRFI_TX_ASYNC
 /**************************************************************************************************
- * @fn          Mrfi_SyncPinRxIsr
- *
- * @brief       This interrupt is called when the SYNC signal transition from high to low.
- *              The sync signal is routed to the sync pin which is a GPIO pin.  This high-to-low
- *              transition signifies a receive has completed.  The SYNC signal also goes from
- *              high to low when a transmit completes.   This is protected against within the
- *              transmit function by disabling sync pin interrupts until transmit completes.
- *
- * @param       none
- *
- * @return      none
+ * @fn          MRFI_TransmitAsync
+ *
+ * @brief       Start a transmit and return without waiting for it. The RSSI valid wait,
+ *              the CCA check, the backoffs and the end of the frame are handled by the GDO0
+ *              and one-shot timer interrupts, so the CPU is free while the radio works.
+ *              Otherwise the same as MRFI_Transmit(). The receiver is off until the
+ *              transmit is done.
+ *
+ * @param       pPacket - packet to transmit. must not change until done is called.
+ *              txType  - MRFI_TX_TYPE_FORCED or MRFI_TX_TYPE_CCA
+ *              done    - called from interrupt context with the result of the transmit,
+ *                        MRFI_TX_RESULT_SUCCESS or MRFI_TX_RESULT_FAILED. may be NULL.
+ *                        It may start the next transmit.
+ *
+ * @return      MRFI_TX_RESULT_SUCCESS - transmit started
+ *              MRFI_TX_RESULT_FAILED  - another transmit is running. done won't be called.
  **************************************************************************************************
  */
-static void Mrfi_SyncPinRxIsr(void)
+uint8_t MRFI_TransmitAsync(mrfiPacket_t * pPacket, uint8_t txType, void (*done)(uint8_t))
 {
-  uint8_t frameLen;
-  uint8_t rxBytes;
+  bspIState_t s;
+  uint8_t txBufLen;
+  uint8_t txFirst;
 
-  /* We should receive this interrupt only in RX state
-   * Should never receive it if RX was turned On only for
-   * some internal mrfi processing like - during CCA.
-   * Otherwise something is terribly wrong.
-   */
-  MRFI_ASSERT( mrfiRadioState == MRFI_RADIO_STATE_RX );
+  /* radio must be awake to transmit */
+  MRFI_ASSERT( mrfiRadioState != MRFI_RADIO_STATE_OFF );
 
-  /* ------------------------------------------------------------------
-   *    Get RXBYTES
-   *   -------------
+  /* Only the first steps are done here. Keep the interrupts that do the
+   * rest out until they are set up.
    */
+  BSP_ENTER_CRITICAL_SECTION(s);
 
-  /*
-   *  Read the RXBYTES register from the radio.
-   *  Bit description of RXBYTES register:
-   *    bit 7     - RXFIFO_OVERFLOW, set if receive overflow occurred
-   *    bits 6:0  - NUM_BYTES, number of bytes in receive FIFO
-   *
-   *  Due a chip bug, the RXBYTES register must read the same value twice
-   *  in a row to guarantee an accurate value.
-   */
+  if (mrfiTxState != MRFI_TX_STATE_IDLE)
   {
-    uint8_t rxBytesVerify;
-
-    rxBytesVerify = mrfiSpiReadReg( RXBYTES );
-
-    do
-    {
-      rxBytes = rxBytesVerify;
-      rxBytesVerify = mrfiSpiReadReg( RXBYTES );
-    }
-    while (rxBytes != rxBytesVerify);
+    BSP_EXIT_CRITICAL_SECTION(s);
+    return( MRFI_TX_RESULT_FAILED );
   }
 
+  Mrfi_RxModeOff();
 
-  /* ------------------------------------------------------------------
-   *    FIFO empty?
-   *   -------------
-   */
+  mrfiTxPkt   = pPacket;
+  mrfiTxType  = txType;
+  mrfiTxDone  = done;
+  mrfiTxState = MRFI_TX_STATE_LOAD;
 
-  /*
-   *  See if the receive FIFIO is empty before attempting to read from it.
-   *  It is possible nothing the FIFO is empty even though the interrupt fired.
-   *  This can happen if address check is enabled and a non-matching packet is
-   *  received.  In that case, the radio automatically removes the packet from
-   *  the FIFO.
-   */
-  if (rxBytes == 0)
+  /* Write packet to transmit FIFO. Same as MRFI_Transmit(). */
+  txBufLen = pPacket->frame[MRFI_LENGTH_FIELD_OFS] + MRFI_LENGTH_FIELD_SIZE;
+#ifdef MRFI_STREAM_FIFO
+  txFirst = (txBufLen > MRFI_FIFO_SIZE) ? MRFI_FIFO_SIZE : txBufLen;
+  MRFI_CONFIG_GDO2_AS_TX_FIFO_SIGNAL();
+  mrfiTxSent = txFirst;
+#else
+  txFirst = txBufLen;
+#endif
+
+#ifdef MRFI_SPI_ASYNC
+  /* the FIFO fills from the SPI interrupt. if the SPI queue is full do it here. */
+  if (mrfiSpiWriteTxFifoAsync(&(pPacket->frame[0]), txFirst, Mrfi_TxLoaded) == MRFI_SPI_QUEUED)
   {
-    /* receive FIFO is empty - do nothing, skip to end */
+    BSP_EXIT_CRITICAL_SECTION(s);
+    return( MRFI_TX_RESULT_SUCCESS );
   }
-  else
-  {
-    /* receive FIFO is not empty, continue processing */
-
-    /* ------------------------------------------------------------------
-     *    Process frame length
-     *   ----------------------
-     */
-
-    /* read the first byte from FIFO - the packet length */
-    mrfiSpiReadRxFifo(&frameLen, MRFI_LENGTH_FIELD_SIZE);
-
-    /*
-     *  Make sure that the frame length just read corresponds to number of bytes in the buffer.
-     *  If these do not match up something is wrong.
-     *
-     *  This can happen for several reasons:
-     *   1) Incoming packet has an incorrect format or is corrupted.
-     *   2) The receive FIFO overflowed.  Overflow is indicated by the high
-     *      bit of rxBytes.  This guarantees the value of rxBytes value will not
-     *      match the number of bytes in the FIFO for overflow condition.
-     *   3) Interrupts were blocked for an abnormally long time which
-     *      allowed a following packet to at least start filling the
-     *      receive FIFO.  In this case, all received and partially received
-     *      packets will be lost - the packet in the FIFO and the packet coming in.
-     *      This is the price the user pays if they implement a giant
-     *      critical section.
-     *   4) A failed transmit forced radio to IDLE state to flush the transmit FIFO.
-     *      This could cause an active receive to be cut short.
-     *
-     *  Also check the sanity of the length to guard against rogue frames.
-     */
-    if ((rxBytes != (frameLen + MRFI_LENGTH_FIELD_SIZE + MRFI_RX_METRICS_SIZE))           ||
-        ((frameLen + MRFI_LENGTH_FIELD_SIZE) > MRFI_MAX_FRAME_SIZE) ||
-        (frameLen < MRFI_MIN_SMPL_FRAME_SIZE)
-       )
-    {
-      bspIState_t s;
-
-      /* mismatch between bytes-in-FIFO and frame length */
-
-      /*
-       *  Flush receive FIFO to reset receive.  Must go to IDLE state to do this.
-       *  The critical section guarantees a transmit does not occur while cleaning up.
-       */
-      BSP_ENTER_CRITICAL_SECTION(s);
-      MRFI_STROBE_IDLE_AND_WAIT();
-      mrfiSpiCmdStrobe( SFRX );
-      mrfiSpiCmdStrobe( SRX );
-      BSP_EXIT_CRITICAL_SECTION(s);
-
-      /* flush complete, skip to end */
-    }
-    else
-    {
-      /* bytes-in-FIFO and frame length match up - continue processing */
-
-      /* ------------------------------------------------------------------
-       *    Get packet
-       *   ------------
-       */
-
-      /* clean out buffer to help protect against spurious frames */
-      memset(mrfiIncomingPacket.frame, 0x00, sizeof(mrfiIncomingPacket.frame));
-
-      /* set length field */
-      mrfiIncomingPacket.frame[MRFI_LENGTH_FIELD_OFS] = frameLen;
-
-      /* get packet from FIFO */
-      mrfiSpiReadRxFifo(&(mrfiIncomingPacket.frame[MRFI_FRAME_BODY_OFS]), frameLen);
-
-      /* get receive metrics from FIFO */
-      mrfiSpiReadRxFifo(&(mrfiIncomingPacket.rxMetrics[0]), MRFI_RX_METRICS_SIZE);
-
-
-      /* ------------------------------------------------------------------
-       *    CRC check
-       *   ------------
-       */
-
-      /*
-       *  Note!  Automatic CRC check is not, and must not, be enabled.  This feature
-       *  flushes the *entire* receive FIFO when CRC fails.  If this feature is
-       *  enabled it is possible to be reading from the FIFO and have a second
-       *  receive occur that fails CRC and automatically flushes the receive FIFO.
-       *  This could cause reads from an empty receive FIFO which puts the radio
-       *  into an undefined state.
-       */
-
-      /* determine if CRC failed */
-      if (!(mrfiIncomingPacket.rxMetrics[MRFI_RX_METRICS_CRC_LQI_OFS] & MRFI_RX_METRICS_CRC_OK_MASK))
-      {
-        /* CRC failed - do nothing, skip to end */
-      }
-      else
-      {
-        /* CRC passed - continue processing */
-
-        /* ------------------------------------------------------------------
-         *    Filtering
-         *   -----------
-         */
-
-        /* if address is not filtered, receive is successful */
-        if (!MRFI_RxAddrIsFiltered(MRFI_P_DST_ADDR(&mrfiIncomingPacket)))
-        {
-          {
-            /* ------------------------------------------------------------------
-             *    Receive successful
-             *   --------------------
-             */
-
-            /* Convert the raw RSSI value and do offset compensation for this radio */
-            mrfiIncomingPacket.rxMetrics[MRFI_RX_METRICS_RSSI_OFS] =
-                Mrfi_CalculateRssi(mrfiIncomingPacket.rxMetrics[MRFI_RX_METRICS_RSSI_OFS]);
-
-            /* Remove the CRC valid bit from the LQI byte */
-            mrfiIncomingPacket.rxMetrics[MRFI_RX_METRICS_CRC_LQI_OFS] =
-              (mrfiIncomingPacket.rxMetrics[MRFI_RX_METRICS_CRC_LQI_OFS] & MRFI_RX_METRICS_LQI_MASK);
-
+#endif
+  mrfiSpiWriteTxFifo(&(pPacket->frame[0]), txFirst);
+  Mrfi_TxLoaded();
 
-            /* call external, higher level "receive complete" processing routine */
-            MRFI_RxCompleteISR();
-          }
-        }
-      }
-    }
-  }
+  BSP_EXIT_CRITICAL_SECTION(s);
 
-  /* ------------------------------------------------------------------
-   *    End of function
-   *   -------------------
-   */
+  return( MRFI_TX_RESULT_SUCCESS );
 }
 
+
 /**************************************************************************************************
- * @fn          Mrfi_RxModeOn
+ * @fn          Mrfi_TxLoaded
  *
- * @brief       Put radio into receive mode.
+ * @brief       Asynchronous transmit: the frame is in the Tx FIFO. Send it now or start the
+ *              CCA. Called from interrupt context or with interrupts off.
  *
  * @param       none
  *
  * @return      none
  **************************************************************************************************
  */
-static void Mrfi_RxModeOn(void)
+static void Mrfi_TxLoaded(void)
 {
-  /* clear any residual receive interrupt */
-  MRFI_CLEAR_SYNC_PIN_INT_FLAG();
-
-  /* send strobe to enter receive mode */
-  mrfiSpiCmdStrobe( SRX );
+  if (mrfiTxType == MRFI_TX_TYPE_FORCED)
+  {
+    /* SYNC falls at the end of the frame. Mrfi_RxModeOff() cleared the flag. */
+    mrfiSpiCmdStrobe( STX );
+    Mrfi_TxOnAir();
+  }
+  else
+  {
+    MRFI_ASSERT( mrfiTxType == MRFI_TX_TYPE_CCA );
 
-  /* enable receive interrupts */
-  MRFI_ENABLE_SYNC_PIN_INT();
+    /* PA_PD on GDO0 tells when the radio goes to Tx. See MRFI_Transmit(). */
+    mrfiTxRetries = MRFI_CCA_RETRIES;
+    MRFI_CONFIG_GDO0_AS_PAPD_SIGNAL();
+    Mrfi_TxCcaStart();
+  }
 }
+#endif  /* MRFI_TX_ASYNC */
+
 
 /**************************************************************************************************
- * @fn          MRFI_RxOn
+ * @fn          MRFI_TxBusy
  *
- * @brief       Turn on the receiver.  No harm is done if this function is called when
- *              receiver is already on.
+ * @brief       Is a transmit running? Started by either MRFI_Transmit() or
+ *              MRFI_TransmitAsync().
  *
  * @param       none
  *
- * @return      none
+ * @return      non-zero while the radio is transmitting
  **************************************************************************************************
  */
-void MRFI_RxOn(void)
+uint8_t MRFI_TxBusy(void)
 {
-  /* radio must be awake before we can move it to RX state */
-  MRFI_ASSERT( mrfiRadioState != MRFI_RADIO_STATE_OFF );
-
-  /* if radio is off, turn it on */
-  if(mrfiRadioState != MRFI_RADIO_STATE_RX)
-  {
-    mrfiRadioState = MRFI_RADIO_STATE_RX;
-    Mrfi_RxModeOn();
-  }
+  return( mrfiTxState != MRFI_TX_STATE_IDLE );
 }
 
+
+#ifdef MRFI_TX_ASYNC
 /**************************************************************************************************
- * @fn          Mrfi_RxModeOff
+ * @fn          Mrfi_TxCcaStart
  *
- * @brief       -
+ * @brief       Asynchronous transmit: turn on the receiver for CCA and start waiting for
+ *              the RSSI to be valid. Called from interrupt context or with interrupts off.
  *
  * @param       none
  *
  * @return      none
  **************************************************************************************************
  */
-static void Mrfi_RxModeOff(void)
+static void Mrfi_TxCcaStart(void)
 {
-  /*disable receive interrupts */
-  MRFI_DISABLE_SYNC_PIN_INT();
-
-  /* turn off radio */
-  MRFI_STROBE_IDLE_AND_WAIT();
-
-  /* flush the receive FIFO of any residual data */
-  mrfiSpiCmdStrobe( SFRX );
+  /* Rx without the Rx interrupt. See MRFI_Transmit(). */
+  mrfiSpiCmdStrobe( SRX );
 
-  /* clear receive interrupt */
-  MRFI_CLEAR_SYNC_PIN_INT_FLAG();
+  mrfiTxState    = MRFI_TX_STATE_RSSI;
+  mrfiTxRssiWait = MRFI_RSSI_VALID_DELAY_US;
+  Mrfi_TxTimerIsr();
 }
 
 
 /**************************************************************************************************
- * @fn          MRFI_RxIdle
+ * @fn          Mrfi_TxOnAir
  *
- * @brief       Put radio in idle mode (receiver if off).  No harm is done this function is
- *              called when radio is already idle.
+ * @brief       Asynchronous transmit: the frame is going out. Set up the interrupt for its
+ *              end. That is a falling SYNC edge for a forced transmit and a rising PA_PD
+ *              edge after CCA. Called from interrupt context or with interrupts off.
  *
  * @param       none
  *
  * @return      none
  **************************************************************************************************
  */
-void MRFI_RxIdle(void)
+static void Mrfi_TxOnAir(void)
 {
-  /* radio must be awake to move it to idle mode */
+  mrfiTxState = MRFI_TX_STATE_ON_AIR;
+
+#ifdef MRFI_STREAM_FIFO
+  /* the rest of a long frame goes in from the FIFO pin interrupt */
+  Mrfi_TxFifoPinIsr();
+#endif
+
+  if (mrfiTxType == MRFI_TX_TYPE_CCA)
+  {
+    /* Changing the edge can set the flag so clear it after. The frame may
+     * have ended before the edge was set up so look at the pin too.
+     */
+    MRFI_CONFIG_PAPD_RISING_EDGE_INT();
+    MRFI_CLEAR_PAPD_PIN_INT_FLAG();
+    MRFI_ENABLE_SYNC_PIN_INT();
+
+    if (MRFI_PAPD_PIN_IS_HIGH())
+    {
+      Mrfi_TxFinish(MRFI_TX_RESULT_SUCCESS);
+    }
+  }
+  else
+  {
+    MRFI_ENABLE_SYNC_PIN_INT();
+  }
+}
+
+
+/**************************************************************************************************
+ * @fn          Mrfi_TxTimerArm
+ *
+ * @brief       Asynchronous transmit: call Mrfi_TxTimerIsr() after a delay.
+ *
+ * @param       usec - delay in microseconds. limited to half the timer range.
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void Mrfi_TxTimerArm(uint32_t usec)
+{
+  uint32_t ticks = MRFI_USECS_TO_TICKS(usec);
+
+  if (ticks > 0x7FFF)
+  {
+    ticks = 0x7FFF;
+  }
+  BSP_TimerArm(&mrfiTxTimer, BSP_TimerNow() + (uint16_t)ticks, Mrfi_TxTimerIsr);
+}
+
+
+/**************************************************************************************************
+ * @fn          Mrfi_TxTimerIsr
+ *
+ * @brief       Asynchronous transmit: one-shot timer expired. Does the step of the CCA
+ *              algorithm in MRFI_Transmit() that follows the delay just done.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void Mrfi_TxTimerIsr(void)
+{
+  switch (mrfiTxState)
+  {
+    case MRFI_TX_STATE_RSSI:
+      /* RSSI is valid once CS or CCA is up or the worst case wait is over.
+       * Check every 64 usecs like MRFI_RSSI_VALID_WAIT().
+       */
+      if ((mrfiTxRssiWait > 0) &&
+          !(mrfiSpiReadReg(PKTSTATUS) & (MRFI_PKTSTATUS_CCA | MRFI_PKTSTATUS_CS)))
+      {
+        mrfiTxRssiWait -= 64;
+        Mrfi_TxTimerArm(64);
+        break;
+      }
+
+      /* the PA_PD flag catches the move to Tx if CCA passes */
+      MRFI_CLEAR_PAPD_PIN_INT_FLAG();
+      mrfiSpiCmdStrobe( STX );
+
+      /* see MRFI_Transmit() for the 25 usecs */
+      mrfiTxState = MRFI_TX_STATE_CCA;
+      Mrfi_TxTimerArm(25);
+      break;
+
+    case MRFI_TX_STATE_CCA:
+      if (MRFI_PAPD_INT_FLAG_IS_SET())
+      {
+        /* CCA passed */
+        MRFI_CLEAR_PAPD_PIN_INT_FLAG();
+        Mrfi_TxOnAir();
+        break;
+      }
+
+      /* CCA failed. Idle during the backoff and flush anything received. */
+      MRFI_STROBE_IDLE_AND_WAIT();
+      mrfiSpiCmdStrobe( SFRX );
+
+      if (mrfiTxRetries)
+      {
+        mrfiTxRetries--;
+
+        /* 1 to 16 backoff periods. See Mrfi_RandomBackoffDelay(). */
+        mrfiTxState = MRFI_TX_STATE_BACKOFF;
+        Mrfi_TxTimerArm((uint32_t)((MRFI_RandomByte() & 0x0F) + 1) * sBackoffHelper);
+      }
+      else
+      {
+        Mrfi_TxFinish(MRFI_TX_RESULT_FAILED);
+      }
+      break;
+
+    case MRFI_TX_STATE_BACKOFF:
+      Mrfi_TxCcaStart();
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+/**************************************************************************************************
+ * @fn          Mrfi_TxFinish
+ *
+ * @brief       Asynchronous transmit is done. Put the radio back the way MRFI_Transmit()
+ *              leaves it and report the result. Called from interrupt context or with
+ *              interrupts off.
+ *
+ * @param       result - MRFI_TX_RESULT_SUCCESS or MRFI_TX_RESULT_FAILED
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void Mrfi_TxFinish(uint8_t result)
+{
+  void (*done)(uint8_t) = mrfiTxDone;
+
+#ifdef MRFI_TIMESTAMP
+  if (result == MRFI_TX_RESULT_SUCCESS)
+  {
+    /* same end-of-frame edge MRFI_Transmit() uses */
+    mrfiTxTimestamp = MRFI_TimestampCapture();
+  }
+#endif
+
+  BSP_TimerDisarm(&mrfiTxTimer);
+  MRFI_DISABLE_SYNC_PIN_INT();
+
+  /* Radio is already in IDLE state */
+  mrfiSpiCmdStrobe( SFTX );
+
+  /* Restore GDO_0 to be SYNC signal, falling edge */
+  MRFI_CONFIG_GDO0_AS_SYNC_SIGNAL();
+  MRFI_CONFIG_SYNC_PIN_FALLING_EDGE_INT();
+  MRFI_CLEAR_SYNC_PIN_INT_FLAG();
+
+#ifdef MRFI_STREAM_FIFO
+  /* and GDO_2 to follow the receive FIFO, rising edge */
+  MRFI_DISABLE_FIFO_PIN_INT();
+  MRFI_CONFIG_GDO2_AS_RX_FIFO_SIGNAL();
+  MRFI_CONFIG_FIFO_PIN_RISING_EDGE_INT();
+  MRFI_CLEAR_FIFO_PIN_INT_FLAG();
+#endif
+
+  mrfiTxState = MRFI_TX_STATE_IDLE;
+
+  if(mrfiRadioState == MRFI_RADIO_STATE_RX)
+  {
+    Mrfi_RxModeOn();
+  }
+
+  if (done)
+  {
+    done(result);
+  }
+}
+#endif  /* MRFI_TX_ASYNC */
+
+
+#ifdef MRFI_TIMESTAMP
+/**************************************************************************************************
+ * @fn          MRFI_TxTimestamp
+ *
+ * @brief       Returns the time at which the last successful transmit finished, as
+ *              captured by MRFI_TimestampCapture() on the end-of-frame edge. This is
+ *              the same edge a receiver timestamps, so the two can be compared directly.
+ *
+ * @param       none
+ *
+ * @return      timestamp of last transmitted frame
+ **************************************************************************************************
+ */
+uint32_t MRFI_TxTimestamp(void)
+{
+  return mrfiTxTimestamp;
+}
+#endif
+
+
+/**************************************************************************************************
+ * @fn          Mrfi_SyncPinRxIsr
+ *
+ * @brief       This interrupt is called when the SYNC signal transition from high to low.
+ *              The sync signal is routed to the sync pin which is a GPIO pin.  This high-to-low
+ *              transition signifies a receive has completed.  The SYNC signal also goes from
+ *              high to low when a transmit completes.   This is protected against within the
+ *              transmit function by disabling sync pin interrupts until transmit completes.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void Mrfi_SyncPinRxIsr(void)
+{
+  uint8_t frameLen;
+  uint8_t rxBytes;
+  uint8_t got = 0;
+  uint8_t ok;
+  mrfiPacket_t *pPacket = NULL;
+#ifdef MRFI_TIMESTAMP
+  /* capture before any SPI traffic so only the interrupt latency is included */
+  uint32_t timestamp = MRFI_TimestampCapture();
+#endif
+
+  /* We should receive this interrupt only in RX state
+   * Should never receive it if RX was turned On only for
+   * some internal mrfi processing like - during CCA.
+   * Otherwise something is terribly wrong.
+   */
+  MRFI_ASSERT( mrfiRadioState == MRFI_RADIO_STATE_RX );
+
+  /* ------------------------------------------------------------------
+   *    Get RXBYTES
+   *   -------------
+   */
+#ifdef MRFI_STREAM_FIFO
+  /* The packet has ended so the radio writes nothing more to the FIFO until
+   * the next sync word. A single read of RXBYTES is accurate.
+   */
+  rxBytes = mrfiSpiReadReg( RXBYTES );
+
+  /* the start of a long frame may already have been read by Mrfi_FifoPinRxIsr() */
+  pPacket = mrfiRxStreamPkt;
+  got     = mrfiRxStreamGot;
+  mrfiRxStreamPkt = NULL;
+#else
+  rxBytes = Mrfi_RxBytes();
+#endif
+
+  if (pPacket)
+  {
+    /* ------------------------------------------------------------------
+     *    Rest of a streamed frame
+     *   --------------------------
+     */
+
+    /* The rest of the frame body and the receive metrics must be all that's in the
+     * FIFO. An overflow sets the high bit of rxBytes so it can't match either.
+     */
+    frameLen = pPacket->frame[MRFI_LENGTH_FIELD_OFS];
+    ok = (rxBytes == (frameLen - got + MRFI_RX_METRICS_SIZE));
+  }
+  else if (rxBytes == 0)
+  {
+    /* ------------------------------------------------------------------
+     *    FIFO empty?
+     *   -------------
+     */
+
+    /*
+     *  See if the receive FIFIO is empty before attempting to read from it.
+     *  It is possible nothing the FIFO is empty even though the interrupt fired.
+     *  This can happen if address check is enabled and a non-matching packet is
+     *  received.  In that case, the radio automatically removes the packet from
+     *  the FIFO.
+     */
+    return;
+  }
+  else
+  {
+    /* receive FIFO is not empty, continue processing */
+
+    /* ------------------------------------------------------------------
+     *    Process frame length
+     *   ----------------------
+     */
+
+    /* read the first byte from FIFO - the packet length */
+    mrfiSpiReadRxFifo(&frameLen, MRFI_LENGTH_FIELD_SIZE);
+
+    /*
+     *  Make sure that the frame length just read corresponds to number of bytes in the buffer.
+     *  If these do not match up something is wrong.
+     *
+     *  This can happen for several reasons:
+     *   1) Incoming packet has an incorrect format or is corrupted.
+     *   2) The receive FIFO overflowed.  Overflow is indicated by the high
+     *      bit of rxBytes.  This guarantees the value of rxBytes value will not
+     *      match the number of bytes in the FIFO for overflow condition.
+     *   3) Interrupts were blocked for an abnormally long time which
+     *      allowed a following packet to at least start filling the
+     *      receive FIFO.  In this case, all received and partially received
+     *      packets will be lost - the packet in the FIFO and the packet coming in.
+     *      This is the price the user pays if they implement a giant
+     *      critical section.
+     *   4) A failed transmit forced radio to IDLE state to flush the transmit FIFO.
+     *      This could cause an active receive to be cut short.
+     *
+     *  Also check the sanity of the length to guard against rogue frames.
+     *
+     *  Only then ask the higher level code for a buffer to read into, big
+     *  enough for this frame. If it has none the frame is dropped the same way.
+     */
+    ok = (rxBytes == (frameLen + MRFI_LENGTH_FIELD_SIZE + MRFI_RX_METRICS_SIZE))    &&
+         ((frameLen + MRFI_LENGTH_FIELD_SIZE) <= MRFI_MAX_FRAME_SIZE)               &&
+         (frameLen >= MRFI_MIN_SMPL_FRAME_SIZE)                                     &&
+         (pPacket = MRFI_RxBufferISR(frameLen + MRFI_LENGTH_FIELD_SIZE));
+
+    if (ok)
+    {
+      /* The buffer isn't cleared first. Everything past the length field is
+       * overwritten up to frameLen and nothing reads beyond that.
+       */
+
+      /* set length field */
+      pPacket->frame[MRFI_LENGTH_FIELD_OFS] = frameLen;
+    }
+  }
+
+  if (!ok)
+  {
+    /* mismatch between bytes-in-FIFO and frame length, or no buffer */
+    Mrfi_RxFlush();
+    return;
+  }
+
+  /* bytes-in-FIFO and frame length match up - continue processing */
+
+  /* ------------------------------------------------------------------
+   *    Get packet
+   *   ------------
+   */
+
+  /* get (the rest of the) packet from FIFO */
+  if (frameLen > got)
+  {
+    mrfiSpiReadRxFifo(&(pPacket->frame[MRFI_FRAME_BODY_OFS + got]), frameLen - got);
+  }
+
+  /* get receive metrics from FIFO */
+  mrfiSpiReadRxFifo(&(pPacket->rxMetrics[0]), MRFI_RX_METRICS_SIZE);
+
+#ifdef MRFI_TIMESTAMP
+  pPacket->timestamp = timestamp;
+#endif
+
+
+  /* ------------------------------------------------------------------
+   *    CRC check
+   *   ------------
+   */
+
+  /*
+   *  Note!  Automatic CRC check is not, and must not, be enabled.  This feature
+   *  flushes the *entire* receive FIFO when CRC fails.  If this feature is
+   *  enabled it is possible to be reading from the FIFO and have a second
+   *  receive occur that fails CRC and automatically flushes the receive FIFO.
+   *  This could cause reads from an empty receive FIFO which puts the radio
+   *  into an undefined state.
+   */
+
+  /* determine if CRC failed */
+  if (!(pPacket->rxMetrics[MRFI_RX_METRICS_CRC_LQI_OFS] & MRFI_RX_METRICS_CRC_OK_MASK))
+  {
+    /* CRC failed - do nothing, skip to end. The buffer stays with the
+     * higher level code and is handed out again for the next frame.
+     */
+  }
+  else
+  {
+    /* CRC passed - continue processing */
+
+    /* ------------------------------------------------------------------
+     *    Filtering
+     *   -----------
+     */
+
+    /* if address is not filtered, receive is successful */
+    if (!MRFI_RxAddrIsFiltered(MRFI_P_DST_ADDR(pPacket)))
+    {
+      /* ------------------------------------------------------------------
+       *    Receive successful
+       *   --------------------
+       */
+
+      /* Convert the raw RSSI value and do offset compensation for this radio */
+      pPacket->rxMetrics[MRFI_RX_METRICS_RSSI_OFS] =
+          Mrfi_CalculateRssi(pPacket->rxMetrics[MRFI_RX_METRICS_RSSI_OFS]);
+
+      /* Remove the CRC valid bit from the LQI byte */
+      pPacket->rxMetrics[MRFI_RX_METRICS_CRC_LQI_OFS] =
+        (pPacket->rxMetrics[MRFI_RX_METRICS_CRC_LQI_OFS] & MRFI_RX_METRICS_LQI_MASK);
+
+
+      /* call external, higher level "receive complete" processing routine */
+      MRFI_RxCompleteISR();
+    }
+  }
+
+  /* ------------------------------------------------------------------
+   *    End of function
+   *   -------------------
+   */
+}
+
+/**************************************************************************************************
+ * @fn          Mrfi_RxBytes
+ *
+ * @brief       Read the RXBYTES register while the radio may be writing to the FIFO.
+ *              Bit description of RXBYTES register:
+ *                bit 7     - RXFIFO_OVERFLOW, set if receive overflow occurred
+ *                bits 6:0  - NUM_BYTES, number of bytes in receive FIFO
+ *
+ *              Due a chip bug, the RXBYTES register must read the same value twice
+ *              in a row to guarantee an accurate value.
+ *
+ * @param       none
+ *
+ * @return      RXBYTES
+ **************************************************************************************************
+ */
+static uint8_t Mrfi_RxBytes(void)
+{
+  uint8_t rxBytes;
+  uint8_t rxBytesVerify;
+
+  rxBytesVerify = mrfiSpiReadReg( RXBYTES );
+
+  do
+  {
+    rxBytes = rxBytesVerify;
+    rxBytesVerify = mrfiSpiReadReg( RXBYTES );
+  }
+  while (rxBytes != rxBytesVerify);
+
+  return rxBytes;
+}
+
+/**************************************************************************************************
+ * @fn          Mrfi_RxFlush
+ *
+ * @brief       Drop whatever is in the receive FIFO, including a frame still arriving,
+ *              and go back to receive. The critical section guarantees a transmit does
+ *              not occur while cleaning up.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void Mrfi_RxFlush(void)
+{
+  bspIState_t s;
+
+  /*
+   *  Flush receive FIFO to reset receive.  Must go to IDLE state to do this.
+   */
+  BSP_ENTER_CRITICAL_SECTION(s);
+  MRFI_STROBE_IDLE_AND_WAIT();
+  mrfiSpiCmdStrobe( SFRX );
+  mrfiSpiCmdStrobe( SRX );
+#ifdef MRFI_STREAM_FIFO
+  mrfiRxStreamPkt = NULL;
+#endif
+  BSP_EXIT_CRITICAL_SECTION(s);
+}
+
+#ifdef MRFI_STREAM_FIFO
+/**************************************************************************************************
+ * @fn          Mrfi_FifoPinRxIsr
+ *
+ * @brief       The FIFO threshold signal on GDO2 rose while receiving: the receive FIFO
+ *              holds MRFI_FIFO_THR_BYTES bytes of a frame still arriving. Read them so a
+ *              frame longer than the FIFO can't overflow it. The first call for a frame
+ *              checks the length and gets the buffer. Mrfi_SyncPinRxIsr() reads the rest
+ *              of the frame when the packet ends.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void Mrfi_FifoPinRxIsr(void)
+{
+  uint8_t rxBytes;
+  uint8_t frameLen;
+
+  /* packet already ended. Mrfi_SyncPinRxIsr() reads all of it. */
+  if (!MRFI_SYNC_PIN_IS_HIGH())
+  {
+    return;
+  }
+
+  rxBytes = Mrfi_RxBytes();
+
+  if (rxBytes & MRFI_RXBYTES_OVERFLOW)
+  {
+    Mrfi_RxFlush();
+    return;
+  }
+
+  /* the FIFO must not be emptied while the packet is still arriving. leave
+   * the last byte for Mrfi_SyncPinRxIsr().
+   */
+  if (rxBytes < 2)
+  {
+    return;
+  }
+  rxBytes--;
+
+  if (!mrfiRxStreamPkt)
+  {
+    /* new frame. same checks as Mrfi_SyncPinRxIsr() except for the byte count. */
+    mrfiSpiReadRxFifo(&frameLen, MRFI_LENGTH_FIELD_SIZE);
+    rxBytes--;
+
+    if (((frameLen + MRFI_LENGTH_FIELD_SIZE) > MRFI_MAX_FRAME_SIZE) ||
+        (frameLen < MRFI_MIN_SMPL_FRAME_SIZE)                        ||
+        !(mrfiRxStreamPkt = MRFI_RxBufferISR(frameLen + MRFI_LENGTH_FIELD_SIZE))
+       )
+    {
+      Mrfi_RxFlush();
+      return;
+    }
+    mrfiRxStreamPkt->frame[MRFI_LENGTH_FIELD_OFS] = frameLen;
+    mrfiRxStreamGot = 0;
+  }
+
+  /* frame body only. the receive metrics are read at the end of the packet. */
+  frameLen = mrfiRxStreamPkt->frame[MRFI_LENGTH_FIELD_OFS];
+  if (rxBytes > (frameLen - mrfiRxStreamGot))
+  {
+    rxBytes = frameLen - mrfiRxStreamGot;
+  }
+  if (rxBytes)
+  {
+    mrfiSpiReadRxFifo(&(mrfiRxStreamPkt->frame[MRFI_FRAME_BODY_OFS + mrfiRxStreamGot]), rxBytes);
+    mrfiRxStreamGot += rxBytes;
+  }
+}
+
+/**************************************************************************************************
+ * @fn          Mrfi_TxFifoRefill
+ *
+ * @brief       Write the part of a frame that didn't fit in the transmit FIFO while the
+ *              frame goes out. GDO2 follows the Tx FIFO threshold. Each time it drops there
+ *              is room for MRFI_FIFO_THR_BYTES more bytes.
+ *
+ * @param       pData - rest of the frame
+ * @param       len   - number of bytes left
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void Mrfi_TxFifoRefill(uint8_t * pData, uint8_t len)
+{
+  uint8_t n;
+
+  while (len)
+  {
+    while (MRFI_FIFO_PIN_IS_HIGH()) ;
+
+    n = (len > MRFI_FIFO_THR_BYTES) ? MRFI_FIFO_THR_BYTES : len;
+    mrfiSpiWriteTxFifo(pData, n);
+    pData += n;
+    len   -= n;
+  }
+}
+
+#ifdef MRFI_TX_ASYNC
+/**************************************************************************************************
+ * @fn          Mrfi_TxFifoPinIsr
+ *
+ * @brief       Asynchronous transmit: the same refill as Mrfi_TxFifoRefill() driven by the
+ *              falling edge of GDO2. Writes while there is room, then sets up the interrupt
+ *              for the next drop until the whole frame is in.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void Mrfi_TxFifoPinIsr(void)
+{
+  uint8_t txBufLen = mrfiTxPkt->frame[MRFI_LENGTH_FIELD_OFS] + MRFI_LENGTH_FIELD_SIZE;
+  uint8_t n;
+
+  for (;;)
+  {
+    while ((mrfiTxSent < txBufLen) && !MRFI_FIFO_PIN_IS_HIGH())
+    {
+      n = txBufLen - mrfiTxSent;
+      if (n > MRFI_FIFO_THR_BYTES)
+      {
+        n = MRFI_FIFO_THR_BYTES;
+      }
+      mrfiSpiWriteTxFifo(&(mrfiTxPkt->frame[mrfiTxSent]), n);
+      mrfiTxSent += n;
+    }
+
+    if (mrfiTxSent >= txBufLen)
+    {
+      MRFI_DISABLE_FIFO_PIN_INT();
+      return;
+    }
+
+    /* the pin may have dropped before the edge was set up */
+    MRFI_CONFIG_FIFO_PIN_FALLING_EDGE_INT();
+    MRFI_CLEAR_FIFO_PIN_INT_FLAG();
+    MRFI_ENABLE_FIFO_PIN_INT();
+    if (MRFI_FIFO_PIN_IS_HIGH())
+    {
+      return;
+    }
+  }
+}
+#endif  /* MRFI_TX_ASYNC */
+#endif  /* MRFI_STREAM_FIFO */
+
+/**************************************************************************************************
+ * @fn          Mrfi_RxModeOn
+ *
+ * @brief       Put radio into receive mode.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void Mrfi_RxModeOn(void)
+{
+  /* clear any residual receive interrupt */
+  MRFI_CLEAR_SYNC_PIN_INT_FLAG();
+#ifdef MRFI_STREAM_FIFO
+  MRFI_CLEAR_FIFO_PIN_INT_FLAG();
+#endif
+
+  /* send strobe to enter receive mode */
+  mrfiSpiCmdStrobe( SRX );
+
+  /* enable receive interrupts */
+  MRFI_ENABLE_SYNC_PIN_INT();
+#ifdef MRFI_STREAM_FIFO
+  MRFI_ENABLE_FIFO_PIN_INT();
+#endif
+}
+
+/**************************************************************************************************
+ * @fn          MRFI_RxOn
+ *
+ * @brief       Turn on the receiver.  No harm is done if this function is called when
+ *              receiver is already on.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+void MRFI_RxOn(void)
+{
+  /* radio must be awake before we can move it to RX state */
+  MRFI_ASSERT( mrfiRadioState != MRFI_RADIO_STATE_OFF );
+
+  /* if radio is off, turn it on */
+  if(mrfiRadioState != MRFI_RADIO_STATE_RX)
+  {
+    mrfiRadioState = MRFI_RADIO_STATE_RX;
+
+    /* a running transmit turns the receiver on when it is done */
+    if (!MRFI_TxBusy())
+    {
+      Mrfi_RxModeOn();
+    }
+  }
+}
+
+/**************************************************************************************************
+ * @fn          Mrfi_RxModeOff
+ *
+ * @brief       -
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+static void Mrfi_RxModeOff(void)
+{
+  /*disable receive interrupts */
+  MRFI_DISABLE_SYNC_PIN_INT();
+#ifdef MRFI_STREAM_FIFO
+  MRFI_DISABLE_FIFO_PIN_INT();
+#endif
+
+  /* turn off radio */
+  MRFI_STROBE_IDLE_AND_WAIT();
+
+  /* flush the receive FIFO of any residual data */
+  mrfiSpiCmdStrobe( SFRX );
+
+  /* clear receive interrupt */
+  MRFI_CLEAR_SYNC_PIN_INT_FLAG();
+#ifdef MRFI_STREAM_FIFO
+  MRFI_CLEAR_FIFO_PIN_INT_FLAG();
+
+  /* a frame partly read is gone with the FIFO */
+  mrfiRxStreamPkt = NULL;
+#endif
+}
+
+
+/**************************************************************************************************
+ * @fn          MRFI_RxIdle
+ *
+ * @brief       Put radio in idle mode (receiver if off).  No harm is done this function is
+ *              called when radio is already idle.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+void MRFI_RxIdle(void)
+{
+  /* radio must be awake to move it to idle mode */
   MRFI_ASSERT( mrfiRadioState != MRFI_RADIO_STATE_OFF );
 
   /* if radio is on, turn it off */
   if(mrfiRadioState == MRFI_RADIO_STATE_RX)
   {
-    Mrfi_RxModeOff();
     mrfiRadioState = MRFI_RADIO_STATE_IDLE;
+
+    /* a running transmit leaves the receiver off when it is done */
+    if (!MRFI_TxBusy())
+    {
+      Mrfi_RxModeOff();
+    }
   }
 }
 
@@ -1041,6 +1768,10 @@ void MRFI_Sleep(void)
 {
   bspIState_t s;
 
+  /* let an asynchronous transmit finish */
+  while (MRFI_TxBusy() && BSP_INTERRUPTS_ARE_ENABLED()) ;
+  MRFI_ASSERT( !MRFI_TxBusy() );
+
   /* Critical section necessary for watertight testing and
    * setting of state variables.
    */
@@ -1121,6 +1852,31 @@ void MRFI_WakeUp(void)
  */
 void MRFI_GpioIsr(void)
 {
+#ifdef MRFI_TX_ASYNC
+  /* during an asynchronous transmit the pins signal the transmit, not a receive */
+  uint8_t onAir = (mrfiTxState == MRFI_TX_STATE_ON_AIR);
+#endif
+
+#ifdef MRFI_STREAM_FIFO
+  /* receive FIFO reached the threshold. drain it before looking at the end of the packet.
+   * Or the transmit FIFO has room for more.
+   */
+  if (MRFI_FIFO_PIN_INT_IS_ENABLED() && MRFI_FIFO_PIN_INT_FLAG_IS_SET())
+  {
+    MRFI_CLEAR_FIFO_PIN_INT_FLAG();
+#ifdef MRFI_TX_ASYNC
+    if (onAir)
+    {
+      Mrfi_TxFifoPinIsr();
+    }
+    else
+#endif
+    {
+      Mrfi_FifoPinRxIsr();
+    }
+  }
+#endif
+
   /* see if sync pin interrupt is enabled and has fired */
   if (MRFI_SYNC_PIN_INT_IS_ENABLED() && MRFI_SYNC_PIN_INT_FLAG_IS_SET())
   {
@@ -1134,7 +1890,17 @@ void MRFI_GpioIsr(void)
      *  naturally but it must be verified for every target.
      */
     MRFI_CLEAR_SYNC_PIN_INT_FLAG();
-    Mrfi_SyncPinRxIsr();
+#ifdef MRFI_TX_ASYNC
+    if (onAir)
+    {
+      /* end of the transmitted frame */
+      Mrfi_TxFinish(MRFI_TX_RESULT_SUCCESS);
+    }
+    else
+#endif
+    {
+      Mrfi_SyncPinRxIsr();
+    }
   }
 }
 
@@ -1239,27 +2005,20 @@ uint8_t MRFI_RandomByte(void)
 static void Mrfi_RandomBackoffDelay(void)
 {
   uint8_t backoffs;
-  uint8_t i;
 
   /* calculate random value for backoffs - 1 to 16 */
   backoffs = (MRFI_RandomByte() & 0x0F) + 1;
 
   /* delay for randomly computed number of backoff periods */
-  for (i=0; i<backoffs; i++)
-  {
-    Mrfi_DelayUsec( sBackoffHelper );
-  }
+  BSP_TimerWait(MRFI_USECS_TO_TICKS((uint32_t)backoffs * sBackoffHelper), NULL);
 }
 
 /****************************************************************************************************
  * @fn          Mrfi_DelayUsec
  *
- * @brief       Execute a delay loop using HW timer. The macro actually used to do the delay
- *              is not thread-safe. This routine makes the delay execution thread-safe by breaking
- *              up the requested delay up into small chunks and executing each chunk as a critical
- *              section. The chunk size is choosen to be the smallest value used by MRFI. The delay
- *              is only approximate because of the overhead computations. It errs on the side of
- *              being too long.
+ * @brief       Execute a short delay using the free running HW timer. The timer keeps
+ *              counting through interrupts so the delay needs no critical section and is
+ *              not stretched by an interrupt. Longer waits should use BSP_TimerWait().
  *
  * input parameters
  * @param   howLong - number of microseconds to delay
@@ -1269,63 +2028,14 @@ static void Mrfi_RandomBackoffDelay(void)
  */
 static void Mrfi_DelayUsec(uint16_t howLong)
 {
-  bspIState_t s;
-  uint16_t count = howLong/MRFI_MAX_DELAY_US;
-
-  if (howLong)
-  {
-    do
-    {
-      BSP_ENTER_CRITICAL_SECTION(s);
-      BSP_DELAY_USECS(MRFI_MAX_DELAY_US);
-      BSP_EXIT_CRITICAL_SECTION(s);
-    } while (count--);
-  }
-
-  return;
-}
-
-/****************************************************************************************************
- * @fn          Mrfi_DelayUsecSem
- *
- * @brief       Execute a delay loop using a HW timer. See comments for Mrfi_DelayUsec().
- *              Delay specified number of microseconds checking semaphore for
- *              early-out. Run in a separate thread when the reply delay is
- *              invoked. Cleaner then trying to make MRFI_DelayUsec() thread-safe
- *              and reentrant.
- *
- * input parameters
- * @param   howLong - number of microseconds to delay
- *
- * @return      none
- ****************************************************************************************************
- */
-static void Mrfi_DelayUsecSem(uint16_t howLong)
-{
-  bspIState_t s;
-  uint16_t count = howLong/MRFI_MAX_DELAY_US;
-
-  if (howLong)
-  {
-    do
-    {
-      BSP_ENTER_CRITICAL_SECTION(s);
-      BSP_DELAY_USECS(MRFI_MAX_DELAY_US);
-      BSP_EXIT_CRITICAL_SECTION(s);
-      if (sKillSem)
-      {
-        break;
-      }
-    } while (count--);
-  }
-
-  return;
+  BSP_DELAY_USECS(howLong);
 }
 
 /**************************************************************************************************
  * @fn          MRFI_DelayMs
  *
- * @brief       Delay the specified number of milliseconds.
+ * @brief       Delay the specified number of milliseconds. Sleeps on the one-shot timer
+ *              when interrupts are enabled.
  *
  * @param       milliseconds - delay time
  *
@@ -1334,20 +2044,15 @@ static void Mrfi_DelayUsecSem(uint16_t howLong)
  */
 void MRFI_DelayMs(uint16_t milliseconds)
 {
-  while (milliseconds)
-  {
-    Mrfi_DelayUsec( APP_USEC_VALUE );
-    milliseconds--;
-  }
+  BSP_TimerWait((uint32_t)milliseconds * BSP_TIMER_TICKS_PER_MS, NULL);
 }
 
 /**************************************************************************************************
  * @fn          MRFI_ReplyDelay
  *
  * @brief       Delay number of milliseconds scaled by data rate. Check semaphore for
- *              early-out. Run in a separate thread when the reply delay is
- *              invoked. Cleaner then trying to make MRFI_DelayMs() thread-safe
- *              and reentrant.
+ *              early-out. The kill semaphore is posted from the radio ISR, which wakes
+ *              the sleeping wait.
  *
  * @param       none
  *
@@ -1363,15 +2068,8 @@ void MRFI_ReplyDelay()
   sReplyDelayContext = 1;
   BSP_EXIT_CRITICAL_SECTION(s);
 
-  while (milliseconds)
-  {
-    Mrfi_DelayUsecSem( APP_USEC_VALUE );
-    if (sKillSem)
-    {
-      break;
-    }
-    milliseconds--;
-  }
+  /* sleeps until the delay runs out or the kill semaphore is posted */
+  BSP_TimerWait((uint32_t)milliseconds * BSP_TIMER_TICKS_PER_MS, &sKillSem);
 
   BSP_ENTER_CRITICAL_SECTION(s);
   sKillSem           = 0;
@@ -1379,6 +2077,22 @@ void MRFI_ReplyDelay()
   BSP_EXIT_CRITICAL_SECTION(s);
 }
 
+/**************************************************************************************************
+ * @fn          MRFI_ReplyDelayMs
+ *
+ * @brief       Length of the reply delay. For callers timing the wait for a reply
+ *              themselves instead of calling MRFI_ReplyDelay().
+ *
+ * @param       none
+ *
+ * @return      reply delay in milliseconds
+ **************************************************************************************************
+ */
+uint16_t MRFI_ReplyDelayMs(void)
+{
+  return sReplyDelayScalar;
+}
+
 /**************************************************************************************************
  * @fn          MRFI_PostKillSem
  *
@@ -1424,9 +2138,23 @@ uint8_t MRFI_GetRadioState(void)
 
 #define MRFI_RADIO_TX_FIFO_SIZE     64  /* from datasheet */
 
+#ifdef MRFI_STREAM_FIFO
+/* long frames are streamed through the FIFO but the length field is one byte
+ * and buffer sizes are passed as uint8_t.
+ */
+#if (MRFI_MAX_FRAME_SIZE > 255)
+#error "ERROR:  Maximum possible packet length exceeds 255 bytes.  Decrease value of maximum application payload."
+#endif
+#else
 /* verify largest possible packet fits within FIFO buffer */
 #if ((MRFI_MAX_FRAME_SIZE + MRFI_RX_METRICS_SIZE) > MRFI_RADIO_TX_FIFO_SIZE)
-#error "ERROR:  Maximum possible packet length exceeds FIFO buffer.  Decrease value of maximum application payload."
+#error "ERROR:  Maximum possible packet length exceeds FIFO buffer.  Decrease value of maximum application payload or define MRFI_STREAM_FIFO."
+#endif
+#endif
+
+/* queued SPI transfers are only used to load the FIFO for an asynchronous transmit */
+#if (defined MRFI_SPI_ASYNC) && (!defined MRFI_TX_ASYNC)
+#error "ERROR:  MRFI_SPI_ASYNC needs MRFI_TX_ASYNC."
 #endif
 
 /* verify that the SmartRF file supplied is compatible */
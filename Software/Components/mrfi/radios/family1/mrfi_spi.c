@@ -53,6 +53,13 @@
 #define READ_BIT                    0x80
 #define BURST_BIT                   0x40
 
+#ifdef MRFI_SPI_ASYNC
+/* number of transfers that can be queued */
+#ifndef MRFI_SPI_QUEUE_SIZE
+#define MRFI_SPI_QUEUE_SIZE         4
+#endif
+#endif
+
 
 /* ------------------------------------------------------------------------------------------------
  *                                            Macros
@@ -69,6 +76,33 @@
 #define MRFI_SPI_ASSERT(x)
 #endif
 
+/* A synchronous access takes the SPI from a queued transfer and gives it
+ * back when done. See spiEnginePark().
+ */
+#ifdef MRFI_SPI_ASYNC
+#define MRFI_SPI_PARK()                       spiEnginePark()
+#define MRFI_SPI_RESUME()                     spiEngineResume()
+#else
+#define MRFI_SPI_PARK()
+#define MRFI_SPI_RESUME()
+#endif
+
+
+/* ------------------------------------------------------------------------------------------------
+ *                                            Typedefs
+ * ------------------------------------------------------------------------------------------------
+ */
+#ifdef MRFI_SPI_ASYNC
+/* a queued transfer. register accesses are one byte. */
+typedef struct
+{
+  uint8_t    addrByte;
+  uint8_t    len;
+  uint8_t  * pData;
+  void    (* done)(void);
+} spiXfer_t;
+#endif
+
 
 /* ------------------------------------------------------------------------------------------------
  *                                       Local Prototypes
@@ -76,6 +110,27 @@
  */
 static uint8_t spiRegAccess(uint8_t addrByte, uint8_t writeValue);
 static void spiBurstFifoAccess(uint8_t addrByte, uint8_t * pData, uint8_t len);
+#ifdef MRFI_SPI_ASYNC
+static uint8_t spiQueue(uint8_t addrByte, uint8_t * pData, uint8_t len, void (*done)(void));
+static void spiEngineRx(void);
+static void spiEngineStep(void);
+static void spiEnginePark(void);
+static void spiEngineResume(void);
+
+
+/* ------------------------------------------------------------------------------------------------
+ *                                        Local Variables
+ * ------------------------------------------------------------------------------------------------
+ */
+static spiXfer_t          sSpiQ[MRFI_SPI_QUEUE_SIZE];
+static uint8_t            sSpiHead   = 0;
+static volatile uint8_t   sSpiCount  = 0;
+static uint8_t            sSpiActive = 0;   /* transfer at the head has started */
+static uint8_t            sSpiInAddr = 0;   /* byte on the wire is the address byte */
+static uint8_t            sSpiParked = 0;   /* synchronous accesses holding the SPI */
+static uint8_t          * sSpiPtr;          /* next data byte of the active transfer */
+static uint8_t            sSpiLeft;         /* data bytes left in the active transfer */
+#endif
 
 
 /**************************************************************************************************
@@ -125,6 +180,7 @@ uint8_t mrfiSpiCmdStrobe(uint8_t addr)
 
   /* disable interrupts that use SPI */
   MRFI_SPI_ENTER_CRITICAL_SECTION(s);
+  MRFI_SPI_PARK();
 
   /* turn chip select "off" and then "on" to clear any current SPI access */
   MRFI_SPI_TURN_CHIP_SELECT_OFF();
@@ -139,6 +195,7 @@ uint8_t mrfiSpiCmdStrobe(uint8_t addr)
 
   /* turn off chip select; enable interrupts that call SPI functions */
   MRFI_SPI_TURN_CHIP_SELECT_OFF();
+  MRFI_SPI_RESUME();
   MRFI_SPI_EXIT_CRITICAL_SECTION(s);
 
   /* return the status byte */
@@ -208,6 +265,7 @@ static uint8_t spiRegAccess(uint8_t addrByte, uint8_t writeValue)
 
   /* disable interrupts that use SPI */
   MRFI_SPI_ENTER_CRITICAL_SECTION(s);
+  MRFI_SPI_PARK();
 
   /* turn chip select "off" and then "on" to clear any current SPI access */
   MRFI_SPI_TURN_CHIP_SELECT_OFF();
@@ -233,6 +291,7 @@ static uint8_t spiRegAccess(uint8_t addrByte, uint8_t writeValue)
 
   /* turn off chip select; enable interrupts that call SPI functions */
   MRFI_SPI_TURN_CHIP_SELECT_OFF();
+  MRFI_SPI_RESUME();
   MRFI_SPI_EXIT_CRITICAL_SECTION(s);
 
   /* return the register value */
@@ -298,8 +357,11 @@ static void spiBurstFifoAccess(uint8_t addrByte, uint8_t * pData, uint8_t len)
   MRFI_SPI_ASSERT(len != 0);                      /* zero length is not allowed */
   MRFI_SPI_ASSERT(addrByte & BURST_BIT);          /* only burst mode supported */
 
-  /* disable interrupts that use SPI */
+  /* disable interrupts that use SPI. a queued transfer stays off the SPI
+   * through the windows below.
+   */
   MRFI_SPI_ENTER_CRITICAL_SECTION(s);
+  MRFI_SPI_PARK();
 
   /* turn chip select "off" and then "on" to clear any current SPI access */
   MRFI_SPI_TURN_CHIP_SELECT_OFF();
@@ -372,9 +434,314 @@ static void spiBurstFifoAccess(uint8_t addrByte, uint8_t * pData, uint8_t len)
 
   /* turn off chip select; enable interrupts that call SPI functions */
   MRFI_SPI_TURN_CHIP_SELECT_OFF();
+  MRFI_SPI_RESUME();
   MRFI_SPI_EXIT_CRITICAL_SECTION(s);
 }
 
 
+#ifdef MRFI_SPI_ASYNC
+/**************************************************************************************************
+ * @fn          mrfiSpiReadRegAsync
+ *
+ * @brief       Queue a read of a radio register.
+ *
+ * @param       addr   - address of register
+ * @param       pValue - where to put the register value
+ * @param       done   - called from the SPI interrupt when the value is in. may be NULL.
+ *
+ * @return      MRFI_SPI_QUEUED or MRFI_SPI_QUEUE_FULL
+ **************************************************************************************************
+ */
+uint8_t mrfiSpiReadRegAsync(uint8_t addr, uint8_t * pValue, void (*done)(void))
+{
+  MRFI_SPI_ASSERT(addr <= 0x3B);    /* invalid address */
+
+  /* burst bit for the status registers, as in mrfiSpiReadReg() */
+  return( spiQueue(addr | BURST_BIT | READ_BIT, pValue, 1, done) );
+}
+
+
+/**************************************************************************************************
+ * @fn          mrfiSpiWriteRegAsync
+ *
+ * @brief       Queue a write of a radio register.
+ *
+ * @param       addr   - address of register
+ * @param       pValue - register value to write
+ * @param       done   - called from the SPI interrupt when the write is done. may be NULL.
+ *
+ * @return      MRFI_SPI_QUEUED or MRFI_SPI_QUEUE_FULL
+ **************************************************************************************************
+ */
+uint8_t mrfiSpiWriteRegAsync(uint8_t addr, uint8_t * pValue, void (*done)(void))
+{
+  MRFI_SPI_ASSERT((addr <= 0x2E) || (addr == 0x3E));    /* invalid address */
+
+  return( spiQueue(addr, pValue, 1, done) );
+}
+
+
+/**************************************************************************************************
+ * @fn          mrfiSpiWriteTxFifoAsync
+ *
+ * @brief       Queue a write to the radio transmit FIFO.
+ *
+ * @param       pData - data to write
+ * @param       len   - length of data in bytes
+ * @param       done  - called from the SPI interrupt when the data is in. may be NULL.
+ *
+ * @return      MRFI_SPI_QUEUED or MRFI_SPI_QUEUE_FULL
+ **************************************************************************************************
+ */
+uint8_t mrfiSpiWriteTxFifoAsync(uint8_t * pData, uint8_t len, void (*done)(void))
+{
+  return( spiQueue(TXFIFO | BURST_BIT, pData, len, done) );
+}
+
+
+/**************************************************************************************************
+ * @fn          mrfiSpiReadRxFifoAsync
+ *
+ * @brief       Queue a read from the radio receive FIFO.
+ *
+ * @param       pData - pointer for storing read data
+ * @param       len   - length of data in bytes
+ * @param       done  - called from the SPI interrupt when the data is in. may be NULL.
+ *
+ * @return      MRFI_SPI_QUEUED or MRFI_SPI_QUEUE_FULL
+ **************************************************************************************************
+ */
+uint8_t mrfiSpiReadRxFifoAsync(uint8_t * pData, uint8_t len, void (*done)(void))
+{
+  return( spiQueue(RXFIFO | BURST_BIT | READ_BIT, pData, len, done) );
+}
+
+
+/**************************************************************************************************
+ * @fn          mrfiSpiBusy
+ *
+ * @brief       Are queued transfers still to finish?
+ *
+ * @param       none
+ *
+ * @return      number of transfers queued, including the one running
+ **************************************************************************************************
+ */
+uint8_t mrfiSpiBusy(void)
+{
+  return( sSpiCount );
+}
+
+
+/**************************************************************************************************
+ * @fn          mrfiSpiIsr
+ *
+ * @brief       SPI byte done interrupt. Store the byte read and put the next one on the wire.
+ *              Called from the ISR for MRFI_SPI_INT_VECTOR when the interrupt is enabled
+ *              and its flag is set.
+ *
+ * @param       none
+ *
+ * @return      none
+ **************************************************************************************************
+ */
+void mrfiSpiIsr(void)
+{
+  spiEngineRx();
+  spiEngineStep();
+}
+
+
+/*=================================================================================================
+ * @fn          spiQueue
+ *
+ * @brief       Add a transfer to the queue and start it if the SPI is free.
+ *
+ * @param       addrByte - first byte written to SPI, contains address and mode bits
+ * @param       pData    - pointer to data to read or write
+ * @param       len      - length of data in bytes
+ * @param       done     - called when the transfer is done. may be NULL.
+ *
+ * @return      MRFI_SPI_QUEUED or MRFI_SPI_QUEUE_FULL
+ *=================================================================================================
+ */
+static uint8_t spiQueue(uint8_t addrByte, uint8_t * pData, uint8_t len, void (*done)(void))
+{
+  mrfiSpiIState_t s;
+  spiXfer_t * pXfer;
+
+  MRFI_SPI_ASSERT( MRFI_SPI_IS_INITIALIZED() );   /* SPI is not initialized */
+  MRFI_SPI_ASSERT(len != 0);                      /* zero length is not allowed */
+
+  MRFI_SPI_ENTER_CRITICAL_SECTION(s);
+
+  if (sSpiCount == MRFI_SPI_QUEUE_SIZE)
+  {
+    MRFI_SPI_EXIT_CRITICAL_SECTION(s);
+    return( MRFI_SPI_QUEUE_FULL );
+  }
+
+  pXfer = &sSpiQ[(sSpiHead + sSpiCount) % MRFI_SPI_QUEUE_SIZE];
+  pXfer->addrByte = addrByte;
+  pXfer->len      = len;
+  pXfer->pData    = pData;
+  pXfer->done     = done;
+
+  /* start it unless a transfer or a synchronous access has the SPI */
+  if (!sSpiCount++ && !sSpiParked)
+  {
+    spiEngineStep();
+  }
+
+  MRFI_SPI_EXIT_CRITICAL_SECTION(s);
+
+  return( MRFI_SPI_QUEUED );
+}
+
+
+/*=================================================================================================
+ * @fn          spiEngineRx
+ *
+ * @brief       The byte on the wire is done. Store it if the active transfer is a read.
+ *              Interrupts must be off.
+ *
+ * @param       none
+ *
+ * @return      none
+ *=================================================================================================
+ */
+static void spiEngineRx(void)
+{
+  if (sSpiInAddr)
+  {
+    sSpiInAddr = 0;
+    return;
+  }
+
+  if (sSpiQ[sSpiHead].addrByte & READ_BIT)
+  {
+    *sSpiPtr = MRFI_SPI_READ_BYTE();
+  }
+  sSpiPtr++;
+  sSpiLeft--;
+}
+
+
+/*=================================================================================================
+ * @fn          spiEngineStep
+ *
+ * @brief       Put the next byte of the queue on the wire. Finishes transfers that are done,
+ *              calls their done functions and starts the next transfer. Turns the SPI
+ *              interrupt off when the queue is empty. Interrupts must be off.
+ *
+ * @param       none
+ *
+ * @return      none
+ *=================================================================================================
+ */
+static void spiEngineStep(void)
+{
+  spiXfer_t * pXfer;
+  void     (* done)(void);
+
+  while (sSpiCount)
+  {
+    pXfer = &sSpiQ[sSpiHead];
+
+    if (!sSpiActive)
+    {
+      sSpiActive = 1;
+      sSpiPtr    = pXfer->pData;
+      sSpiLeft   = pXfer->len;
+      MRFI_SPI_TURN_CHIP_SELECT_OFF();
+    }
+
+    if (sSpiLeft)
+    {
+      /*
+       *  Chip select is "off" at the start of a transfer and after a synchronous
+       *  access got in. Send the address byte again. A FIFO access picks up where
+       *  it was interrupted, like in spiBurstFifoAccess().
+       */
+      if (MRFI_SPI_CHIP_SELECT_IS_OFF())
+      {
+        MRFI_SPI_TURN_CHIP_SELECT_ON();
+        sSpiInAddr = 1;
+        MRFI_SPI_WRITE_BYTE(pXfer->addrByte);
+      }
+      else
+      {
+        MRFI_SPI_WRITE_BYTE(*sSpiPtr);
+      }
+      MRFI_SPI_ENABLE_RX_INT();
+      return;
+    }
+
+    /* transfer done */
+    MRFI_SPI_TURN_CHIP_SELECT_OFF();
+    MRFI_SPI_DISABLE_RX_INT();
+
+    done       = pXfer->done;
+    sSpiActive = 0;
+    sSpiHead   = (sSpiHead + 1) % MRFI_SPI_QUEUE_SIZE;
+    sSpiCount--;
+
+    /* hold the SPI so a transfer queued by done waits for this loop */
+    if (done)
+    {
+      sSpiParked++;
+      done();
+      sSpiParked--;
+    }
+  }
+
+  MRFI_SPI_DISABLE_RX_INT();
+}
+
+
+/*=================================================================================================
+ * @fn          spiEnginePark
+ *
+ * @brief       A synchronous access is about to use the SPI. Take the byte of a running
+ *              transfer off the wire and keep the transfer from going on. Calls may nest.
+ *              Interrupts must be off.
+ *
+ * @param       none
+ *
+ * @return      none
+ *=================================================================================================
+ */
+static void spiEnginePark(void)
+{
+  if (!sSpiParked++ && sSpiActive)
+  {
+    MRFI_SPI_DISABLE_RX_INT();
+    MRFI_SPI_WAIT_DONE();
+    spiEngineRx();
+  }
+}
+
+
+/*=================================================================================================
+ * @fn          spiEngineResume
+ *
+ * @brief       A synchronous access is done with the SPI. Go on with the queue when the
+ *              last one is done. Interrupts must be off.
+ *
+ * @param       none
+ *
+ * @return      none
+ *=================================================================================================
+ */
+static void spiEngineResume(void)
+{
+  if (!--sSpiParked)
+  {
+    spiEngineStep();
+  }
+}
+#endif  /* MRFI_SPI_ASYNC */
+
+
 /**************************************************************************************************
 */
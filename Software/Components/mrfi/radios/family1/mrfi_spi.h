@@ -150,6 +150,21 @@ void mrfiSpiWriteReg(uint8_t addr, uint8_t value);
 void mrfiSpiWriteTxFifo(uint8_t * pWriteData, uint8_t len);
 void mrfiSpiReadRxFifo(uint8_t * pReadData, uint8_t len);
 
+#ifdef MRFI_SPI_ASYNC
+/* Queued transfers. They run from the SPI interrupt and call done from it
+ * when finished. The data must stay put until then.
+ */
+#define MRFI_SPI_QUEUED         0
+#define MRFI_SPI_QUEUE_FULL     1
+
+uint8_t mrfiSpiReadRegAsync(uint8_t addr, uint8_t * pValue, void (*done)(void));
+uint8_t mrfiSpiWriteRegAsync(uint8_t addr, uint8_t * pValue, void (*done)(void));
+uint8_t mrfiSpiWriteTxFifoAsync(uint8_t * pWriteData, uint8_t len, void (*done)(void));
+uint8_t mrfiSpiReadRxFifoAsync(uint8_t * pReadData, uint8_t len, void (*done)(void));
+uint8_t mrfiSpiBusy(void);
+void    mrfiSpiIsr(void); /* called from the ISR for MRFI_SPI_INT_VECTOR */
+#endif
+
 
 /**************************************************************************************************
  */
@@ -994,6 +994,22 @@ uint8_t MRFI_RandomByte(void)
   return mrfiRndSeed;
 }
 
+/**************************************************************************************************
+ * @fn          MRFI_ReplyDelayMs
+ *
+ * @brief       Length of the reply delay. For callers timing the wait for a reply
+ *              themselves instead of calling MRFI_ReplyDelay().
+ *
+ * @param       none
+ *
+ * @return      reply delay in milliseconds
+ **************************************************************************************************
+ */
+uint16_t MRFI_ReplyDelayMs(void)
+{
+  return sReplyDelayScalar;
+}
+
 /**************************************************************************************************
  * @fn          MRFI_PostKillSem
  *
@@ -1432,6 +1432,22 @@ void MRFI_ReplyDelay(void)
   BSP_EXIT_CRITICAL_SECTION(s);
 }
 
+/**************************************************************************************************
+ * @fn          MRFI_ReplyDelayMs
+ *
+ * @brief       Length of the reply delay. For callers timing the wait for a reply
+ *              themselves instead of calling MRFI_ReplyDelay().
+ *
+ * @param       none
+ *
+ * @return      reply delay in milliseconds
+ **************************************************************************************************
+ */
+uint16_t MRFI_ReplyDelayMs(void)
+{
+  return sReplyDelayScalar;
+}
+
 /**************************************************************************************************
  * @fn          MRFI_PostKillSem
  *
@@ -1645,18 +1661,22 @@ uint8_t Mrfi_RxAddrIsFiltered(uint8_t * pAddr)
     {
       filterAddrMatches++;
     }
-    if (addrByte == mrfiBroadcastAddr[i])
+    /* the last byte of the broadcast address is not compared. addresses that
+     * differ from broadcast only there are multicast group addresses. group
+     * membership is checked by the network layer.
+     */
+    if ((i < MRFI_ADDR_SIZE-1) && (addrByte == mrfiBroadcastAddr[i]))
     {
       broadcastAddrMatches++;
     }
   }
 
   /*
-   *  If address is *not* filtered, either the "filter address match count" or
-   *  the "broadcast address match count" will equal the total number of bytes
-   *  in the address.
+   *  If address is *not* filtered, either the "filter address match count" will
+   *  equal the total number of bytes in the address or the "broadcast address
+   *  match count" will equal all but the last.
    */
-  if ((broadcastAddrMatches == MRFI_ADDR_SIZE) || (filterAddrMatches == MRFI_ADDR_SIZE))
+  if ((broadcastAddrMatches == MRFI_ADDR_SIZE-1) || (filterAddrMatches == MRFI_ADDR_SIZE))
   {
     /* address *not* filtered, return zero */
     return( 0 );
@@ -101,19 +101,87 @@
 /******************************************************************************
  * CONSTANTS AND DEFINES
  */
-#define SYS_NUM_CONNECTIONS   (NUM_CONNECTIONS+1)
-
 /* Increment this if the persistentContext_t structure is changed. It will help
  * detect the upgrade context: any saved values will have a version with a
  * lower number.
  */
-#define  CONNTABLEINFO_STRUCTURE_VERSION   1
+#define  CONNTABLEINFO_STRUCTURE_VERSION   2
 
 #define  SIZEOF_NV_OBJ   sizeof(sPersistInfo)
 
+/* Size of the Link ID map and the connection lookup hint tables. Power of 2
+ * no smaller than the connection table.
+ */
+#if SYS_NUM_CONNECTIONS <= 2
+#define  CONN_HASH_SIZE   2
+#elif SYS_NUM_CONNECTIONS <= 4
+#define  CONN_HASH_SIZE   4
+#elif SYS_NUM_CONNECTIONS <= 8
+#define  CONN_HASH_SIZE   8
+#elif SYS_NUM_CONNECTIONS <= 16
+#define  CONN_HASH_SIZE   16
+#elif SYS_NUM_CONNECTIONS <= 32
+#define  CONN_HASH_SIZE   32
+#elif SYS_NUM_CONNECTIONS <= 64
+#define  CONN_HASH_SIZE   64
+#else
+#define  CONN_HASH_SIZE   128
+#endif
+
+/* Width of the per-connection duplicate filter in transaction IDs. The
+ * window is one byte of bits.
+ */
+#define  TID_WINDOW       8
+
+/* Frames in a row from behind the window that mean the sender restarted its
+ * count rather than that they are late retransmits or replays.
+ */
+#define  TID_RESYNC       4
+
+/* Number of senders on the UUD link whose transaction IDs are tracked. The
+ * least recently added sender is replaced when a new one shows up.
+ */
+#ifndef UUD_TID_SOURCES
+#define  UUD_TID_SOURCES  2
+#endif
+
+/* Longest ack wait. Keeps the deadline within half the one-shot timer's range:
+ * 32 ms at 8 MHz, 16 ms at 16 MHz.
+ */
+#define  ACK_WAIT_MAX_MS  (0x7FFF / BSP_TIMER_TICKS_PER_MS)
+
 /******************************************************************************
  * TYPEDEFS
  */
+/* transaction IDs recently received from one sender. bit n of 'seen' is set
+ * if lastTID-n has been received. a lastTID of 0 means nothing received.
+ * 'behind' counts the frames in a row rejected for being behind the window.
+ */
+typedef struct
+{
+  uint8_t lastTID;
+  uint8_t seen;
+  uint8_t behind;
+} tidWindow_t;
+
+typedef struct
+{
+  uint8_t     addr[NET_ADDR_SIZE];
+  tidWindow_t win;
+} uudWindow_t;
+
+#if defined(APP_AUTO_ACK)
+/* a sent frame waiting for its ack. completed by the ack in the Rx ISR thread
+ * or by the timeout in the timer ISR thread.
+ */
+typedef struct
+{
+  volatile smplStatus_t   status;
+           uint16_t       deadline;
+           void         (*done)(linkID_t, smplStatus_t);
+} ackWait_t;
+#endif  /* APP_AUTO_ACK */
+
 /* This structure aggregates everything necessary to save if we want to restore
  * the connection information later.
  */
@@ -134,6 +202,15 @@ typedef struct
 #ifdef ACCESS_POINT
         sfInfo_t   sSandFContext;
 #endif
+/* Network context kept by other modules. Copied in on a GET and pushed back
+ * out on a SET so a restored device needn't join again.
+ */
+        uint32_t   joinToken;
+        uint32_t   linkToken;
+        addr_t     apAddr;
+#ifdef FREQUENCY_AGILITY
+        freqEntry_t curChan;
+#endif
 /* Connection table entries last... */
         connInfo_t connStruct[SYS_NUM_CONNECTIONS];
 } persistentContext_t;
@@ -148,11 +225,51 @@ typedef struct
  */
 static persistentContext_t sPersistInfo = {CONNTABLEINFO_STRUCTURE_VERSION};
 
+/* Link ID map, indexed by the low bits of the Link ID. Link IDs are handed
+ * out so that no two entries in use share a slot, so the slot holds the
+ * index of the only entry that can own the Link ID.
+ */
+static uint8_t sLidMap[CONN_HASH_SIZE];
+
+/* Connection table lookup hints, indexed by a hash of the peer address and
+ * port for frames received (local Rx port) and for links (peer's Tx port).
+ * Each holds the index of the entry that last matched.
+ */
+static uint8_t sRxHint[CONN_HASH_SIZE];
+static uint8_t sTxHint[CONN_HASH_SIZE];
+
+/* duplicate filters. by connection table index and, for the UUD link, by sender. */
+static tidWindow_t sTidWin[NUM_CONNECTIONS];
+static uudWindow_t sUudWin[UUD_TID_SOURCES];
+static uint8_t     sUudNext = 0;
+
+#if defined(APP_AUTO_ACK)
+/* ack waits, by connection table index. the UUD link can't request an ack. */
+static ackWait_t sAckWait[NUM_CONNECTIONS];
+
+/* fires at the earliest ack deadline */
+static bspTimer_t sAckTimer;
+#endif
+
 /******************************************************************************
  * LOCAL FUNCTIONS
  */
-static uint8_t map_lid2idx(linkID_t, uint8_t *);
-static void    initializeConnection(connInfo_t *);
+static uint8_t     map_lid2idx(linkID_t, uint8_t *);
+static uint8_t     lidSlotBusy(linkID_t, const connInfo_t *);
+static uint8_t     lidMapFill(uint8_t *, const connInfo_t *);
+static void        initializeConnection(connInfo_t *);
+static uint8_t     connMatch(connInfo_t *, const uint8_t *, uint8_t, uint8_t);
+static connInfo_t *findConn(uint8_t *, const uint8_t *, uint8_t, uint8_t);
+static uint8_t     isDupTID(connInfo_t *, mrfiPacket_t *);
+static uint8_t     isEmptyPollRsp(mrfiPacket_t *);
+#if defined(APP_AUTO_ACK)
+static void        ackDone(uint8_t, smplStatus_t);
+static void        ackTimerArm(void);
+static void        ackTimeout(void);
+#endif
+#ifdef NVOBJECT_SUPPORT
+static void        restoreContext(const persistentContext_t *);
+#endif
 
 /******************************************************************************
  * GLOBAL VARIABLES
@@ -186,6 +303,23 @@ smplStatus_t nwk_nwkInit(uint8_t (*f)(linkID_t))
   sPersistInfo.curMaxReplyPort  = PORT_BASE_NUMBER;
   sPersistInfo.nextLinkID       = 1;
 
+  /* no Link IDs in use and no hints yet. the first lookup of each key scans. */
+  memset(sLidMap, 0xFF, sizeof(sLidMap));
+  memset(sRxHint, 0xFF, sizeof(sRxHint));
+  memset(sTxHint, 0xFF, sizeof(sTxHint));
+
+#if defined(APP_AUTO_ACK)
+  {
+    uint8_t i;
+
+    /* nothing sent yet */
+    for (i=0; i<NUM_CONNECTIONS; ++i)
+    {
+      sAckWait[i].status = SMPL_BAD_PARAM;
+    }
+  }
+#endif
+
   /* initialize globals */
   nwk_globalsInit();
 
@@ -202,6 +336,7 @@ smplStatus_t nwk_nwkInit(uint8_t (*f)(linkID_t))
   nwk_mgmtInit();
   nwk_linkInit();
   nwk_securityInit();
+  nwk_bulkInit();
 
   /* set up the last connection as the broadcast port mapped to the broadcast Link ID */
   if (CONNSTATE_FREE == sPersistInfo.connStruct[NUM_CONNECTIONS].connState)
@@ -211,6 +346,7 @@ smplStatus_t nwk_nwkInit(uint8_t (*f)(linkID_t))
     sPersistInfo.connStruct[NUM_CONNECTIONS].portRx      = SMPL_PORT_USER_BCAST;
     sPersistInfo.connStruct[NUM_CONNECTIONS].portTx      = SMPL_PORT_USER_BCAST;
     sPersistInfo.connStruct[NUM_CONNECTIONS].thisLinkID  = SMPL_LINKID_USER_UUD;
+    sLidMap[SMPL_LINKID_USER_UUD & (CONN_HASH_SIZE-1)]   = NUM_CONNECTIONS;
     /* set peer address to broadcast so it is used when Application sends to the broadcast Link ID */
     memcpy(sPersistInfo.connStruct[NUM_CONNECTIONS].peerAddr, nwk_getBCastAddress(), NET_ADDR_SIZE);
   }
@@ -278,19 +414,37 @@ static void initializeConnection(connInfo_t *pCInfo)
 
     /* this element will be populated during the exchange with the peer. */
   pCInfo->portTx = 0;
+  nwk_dropHdrTemplate(pCInfo);
+
+  /* a restored next Link ID may map to a slot that is taken */
+  while (!*locLID || (*locLID == SMPL_LINKID_USER_UUD) || lidSlotBusy(*locLID, pCInfo))
+  {
+    (*locLID)++;
+  }
+
+  tmp = nwk_getConnIndex(pCInfo);
 
   pCInfo->connState  =  CONNSTATE_CONNECTED;
   pCInfo->thisLinkID = *locLID;
+  sLidMap[*locLID & (CONN_HASH_SIZE-1)] = tmp;
+
+  /* new peer. forget the old one's transaction IDs. */
+  if (tmp < NUM_CONNECTIONS)
+  {
+    sTidWin[tmp].lastTID = 0;
+  }
 
   /* Generate the next Link ID. This isn't foolproof. If the count wraps
    * we can end up with confusing duplicates. We can protect aginst using
    * one that is already in use but we can't protect against a stale Link ID
    * remembered by an application that doesn't know its connection has been
    * torn down. The test for 0 will hopefully never be true (indicating a wrap).
+   * A Link ID whose map slot is held by another entry is skipped too. There
+   * are at least as many slots as entries so one is always free.
    */
   (*locLID)++;
 
-  while (!*locLID || (*locLID == SMPL_LINKID_USER_UUD) || map_lid2idx(*locLID, &tmp))
+  while (!*locLID || (*locLID == SMPL_LINKID_USER_UUD) || lidSlotBusy(*locLID, pCInfo))
   {
     (*locLID)++;
   }
@@ -344,12 +498,238 @@ connInfo_t *nwk_getConnInfo(linkID_t linkID)
   return (rc && (CONNSTATE_CONNECTED == sPersistInfo.connStruct[idx].connState)) ? &sPersistInfo.connStruct[idx] : (connInfo_t *)0;
 }
 
+/******************************************************************************
+ * @fn          nwk_getConnIndex
+ *
+ * @brief       Return the position of a connection info structure in the
+ *              connection table. Used to key per-link frame queues.
+ *
+ * input parameters
+ * @param   pCInfo  - pointer to Connection Table entry
+ *
+ * output parameters
+ *
+ * @return   index of the entry, 0 to SYS_NUM_CONNECTIONS-1.
+ */
+uint8_t nwk_getConnIndex(connInfo_t *pCInfo)
+{
+  return pCInfo - sPersistInfo.connStruct;
+}
+
+/******************************************************************************
+ * @fn          nwk_getConnByIndex
+ *
+ * @brief       Return the connection info structure at a position in the
+ *              connection table. The reverse of nwk_getConnIndex().
+ *
+ * input parameters
+ * @param   idx  - index of the entry
+ *
+ * output parameters
+ *
+ * @return   pointer to Connection Table entry, or NULL if the index is out
+ *           of range or the entry isn't in use.
+ */
+connInfo_t *nwk_getConnByIndex(uint8_t idx)
+{
+  if ((idx < SYS_NUM_CONNECTIONS) &&
+      (CONNSTATE_CONNECTED == sPersistInfo.connStruct[idx].connState))
+  {
+    return &sPersistInfo.connStruct[idx];
+  }
+
+  return (connInfo_t *)NULL;
+}
+
+#if defined(APP_AUTO_ACK)
+/******************************************************************************
+ * @fn          nwk_ackWaitStart
+ *
+ * @brief       Start waiting for the ack to the frame just sent on a connection.
+ *              The wait ends when the ack arrives or the reply delay runs out
+ *              on the one-shot hardware timer. Nothing spins. Each connection
+ *              can have one wait going, so sends to different peers can wait
+ *              for their acks at the same time.
+ *
+ * input parameters
+ * @param   pCInfo  - connection the ack request frame was sent on
+ * @param   done    - called with the Link ID and SMPL_SUCCESS or SMPL_NO_ACK
+ *                    when the wait ends, from the Rx or timer ISR thread. May
+ *                    be NULL.
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+void nwk_ackWaitStart(connInfo_t *pCInfo, void (*done)(linkID_t, smplStatus_t))
+{
+  uint8_t      idx = nwk_getConnIndex(pCInfo);
+  uint16_t     ms  = MRFI_ReplyDelayMs();
+  bspIState_t  intState;
+
+  if (ms > ACK_WAIT_MAX_MS)
+  {
+    ms = ACK_WAIT_MAX_MS;
+  }
+
+  BSP_ENTER_CRITICAL_SECTION(intState);
+  sAckWait[idx].done     = done;
+  sAckWait[idx].deadline = BSP_TimerNow() + ms * BSP_TIMER_TICKS_PER_MS;
+  sAckWait[idx].status   = SMPL_TX_PENDING;
+  if (!pCInfo->ackTID)
+  {
+    /* the ack beat us here */
+    ackDone(idx, SMPL_SUCCESS);
+  }
+  else
+  {
+    ackTimerArm();
+  }
+  BSP_EXIT_CRITICAL_SECTION(intState);
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          nwk_ackStatus
+ *
+ * @brief       Get the state of the ack wait on a connection.
+ *
+ * input parameters
+ * @param   pCInfo  - pointer to Connection Table entry
+ *
+ * output parameters
+ *
+ * @return   SMPL_TX_PENDING  still waiting
+ *           SMPL_SUCCESS     acked
+ *           SMPL_NO_ACK      no ack in time
+ *           SMPL_BAD_PARAM   nothing has been sent with an ack request
+ */
+smplStatus_t nwk_ackStatus(connInfo_t *pCInfo)
+{
+  uint8_t idx = nwk_getConnIndex(pCInfo);
+
+  return (idx < NUM_CONNECTIONS) ? sAckWait[idx].status : SMPL_BAD_PARAM;
+}
+
+/******************************************************************************
+ * @fn          ackDone
+ *
+ * @brief       End an ack wait. Runs with interrupts off.
+ *
+ * input parameters
+ * @param   idx     - connection table index
+ * @param   status  - SMPL_SUCCESS or SMPL_NO_ACK
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+static void ackDone(uint8_t idx, smplStatus_t status)
+{
+  ackWait_t *pAW = &sAckWait[idx];
+
+  if (SMPL_TX_PENDING != pAW->status)
+  {
+    return;
+  }
+  pAW->status = status;
+  ackTimerArm();
+  if (pAW->done)
+  {
+    pAW->done(sPersistInfo.connStruct[idx].thisLinkID, status);
+  }
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          ackTimerArm
+ *
+ * @brief       Arm the one-shot timer for the earliest ack deadline, or stop
+ *              it if nothing is waiting. Runs with interrupts off.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+static void ackTimerArm(void)
+{
+  uint8_t  i, any = 0;
+  uint16_t now = BSP_TimerNow();
+  uint16_t left, soonest = 0xFFFF;
+
+  for (i=0; i<NUM_CONNECTIONS; ++i)
+  {
+    if (SMPL_TX_PENDING == sAckWait[i].status)
+    {
+      left = sAckWait[i].deadline - now;
+      if ((int16_t)left < 0)
+      {
+        left = 0;
+      }
+      if (left < soonest)
+      {
+        soonest = left;
+      }
+      any = 1;
+    }
+  }
+
+  if (any)
+  {
+    BSP_TimerArm(&sAckTimer, now + soonest, ackTimeout);
+  }
+  else
+  {
+    BSP_TimerDisarm(&sAckTimer);
+  }
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          ackTimeout
+ *
+ * @brief       One-shot timer expired. Fail every ack wait whose deadline has
+ *              passed. Runs in the timer ISR thread.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+static void ackTimeout(void)
+{
+  uint8_t  i;
+  uint16_t now = BSP_TimerNow();
+
+  for (i=0; i<NUM_CONNECTIONS; ++i)
+  {
+    if ((SMPL_TX_PENDING == sAckWait[i].status) && ((int16_t)(now - sAckWait[i].deadline) >= 0))
+    {
+      /* a late ack must not match */
+      sPersistInfo.connStruct[i].ackTID = 0;
+      ackDone(i, SMPL_NO_ACK);
+    }
+  }
+  ackTimerArm();
+
+  return;
+}
+#endif  /* APP_AUTO_ACK */
+
 /******************************************************************************
  * @fn          nwk_isLinkDuplicate
  *
  * @brief       Help determine if the link has already been established.. Defense
  *              against duplicate link frames. This file owns the data structure
- *              so the comparison is done here.
+ *              so the comparison is done here. Runs in the Rx ISR thread. A
+ *              new link is a miss, so it costs a scan of the whole table: at
+ *              most SYS_NUM_CONNECTIONS compares (see findConn()).
  *
  * input parameters
  * @param   addr       - pointer to address of linker in question
@@ -363,19 +743,12 @@ connInfo_t *nwk_getConnInfo(linkID_t linkID)
 connInfo_t *nwk_isLinkDuplicate(uint8_t *addr, uint8_t remotePort)
 {
 #if NUM_CONNECTIONS > 0
-  uint8_t       i;
-  connInfo_t   *ptr = sPersistInfo.connStruct;
+  connInfo_t   *ptr = findConn(sTxHint, addr, remotePort, CHK_TX);
 
-  for (i=0; i<NUM_CONNECTIONS; ++i,++ptr)
+  /* the UUD entry is not a link */
+  if (ptr != &sPersistInfo.connStruct[NUM_CONNECTIONS])
   {
-    if (CONNSTATE_CONNECTED == ptr->connState)
-    {
-      if (!(memcmp(ptr->peerAddr, addr, NET_ADDR_SIZE)) &&
-          (ptr->portTx == remotePort))
-      {
-        return ptr;
-      }
-    }
+    return ptr;
   }
 #endif
 
@@ -571,7 +944,11 @@ smplStatus_t nwk_checkConnInfo(connInfo_t *ptr, uint8_t which)
  * @fn          nwk_isConnectionValid
  *
  * @brief       Do a sanity/validity check on the frame target address by
- *              validating frame against connection info
+ *              validating frame against connection info. Runs in the Rx ISR
+ *              thread for every user frame. A known peer costs one compare.
+ *              A frame that matches no connection, or whose peer shares a
+ *              hint slot with another, costs a scan of the whole table: at
+ *              most SYS_NUM_CONNECTIONS compares (see findConn()).
  *
  * input parameters
  * @param   frame   - pointer to frame in question
@@ -583,63 +960,62 @@ smplStatus_t nwk_checkConnInfo(connInfo_t *ptr, uint8_t which)
  */
 uint8_t nwk_isConnectionValid(mrfiPacket_t *frame, linkID_t *lid)
 {
-  uint8_t       i;
-  connInfo_t   *ptr  = sPersistInfo.connStruct;
+  connInfo_t   *ptr;
   uint8_t       port = GET_FROM_FRAME(MRFI_P_PAYLOAD(frame), F_PORT_OS);
+  uint8_t       rc   = 1;
 
-  for (i=0; i<SYS_NUM_CONNECTIONS; ++i,++ptr)
+  /* the address is ignored if the port is the user bcast port. */
+  if (!(ptr = findConn(sRxHint, MRFI_P_SRC_ADDR(frame), port, CHK_RX)))
   {
-    if (CONNSTATE_CONNECTED == ptr->connState)
-    {
-      /* check port first since we're done if the port is the user bcast port. */
-      if (port == ptr->portRx)
-      {
-        /* yep...ports match. */
-        if ((SMPL_PORT_USER_BCAST == port) || !(memcmp(ptr->peerAddr, MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE)))
-        {
-          uint8_t rc = 1;
+    /* no matches */
+    return 0;
+  }
 
-          /* we're done. */
-          *lid = ptr->thisLinkID;
+  /* we're done. */
+  *lid = ptr->thisLinkID;
 #ifdef APP_AUTO_ACK
-          /* can't ack the broadcast port... */
-          if (!(SMPL_PORT_USER_BCAST == port))
-          {
-            if (GET_FROM_FRAME(MRFI_P_PAYLOAD(frame), F_ACK_REQ))
-            {
-              /* Ack requested. Send ack now */
-              nwk_sendAckReply(frame, ptr->portTx);
-            }
-            else if (GET_FROM_FRAME(MRFI_P_PAYLOAD(frame), F_ACK_RPLY))
-            {
-              /* This is a reply. Signal that it was received by resetting the
-               * saved transaction ID in the connection object if they match. The
-               * main thread is polling this value. The setting here is in the
-               * Rx ISR thread.
-               */
-              if (ptr->ackTID == GET_FROM_FRAME(MRFI_P_PAYLOAD(frame), F_TRACTID_OS))
-              {
-                ptr->ackTID = 0;
-              }
-              /* This causes the frame to be dropped. All ack frames are
-               * dropped.
-               */
-              rc = 0;
-            }
-          }
-#endif  /* APP_AUTO_ACK */
-          /* Unconditionally kill the reply delay semaphore. This used to be done
-           * unconditionally in the calling routine.
-           */
-          MRFI_PostKillSem();
-          return rc;
-        }
+  /* can't ack the broadcast port... */
+  if (!(SMPL_PORT_USER_BCAST == port))
+  {
+    if (GET_FROM_FRAME(MRFI_P_PAYLOAD(frame), F_ACK_REQ))
+    {
+      /* Ack requested. Send ack now */
+      nwk_sendAckReply(frame, ptr->portTx);
+    }
+    else if (GET_FROM_FRAME(MRFI_P_PAYLOAD(frame), F_ACK_RPLY))
+    {
+      /* This is a reply. Signal that it was received by resetting the
+       * saved transaction ID in the connection object if they match. The
+       * main thread is polling this value. The setting here is in the
+       * Rx ISR thread.
+       */
+      if (ptr->ackTID == GET_FROM_FRAME(MRFI_P_PAYLOAD(frame), F_TRACTID_OS))
+      {
+        ptr->ackTID = 0;
+        ackDone(nwk_getConnIndex(ptr), SMPL_SUCCESS);
       }
+      /* This causes the frame to be dropped. All ack frames are
+       * dropped.
+       */
+      rc = 0;
     }
   }
-
-  /* no matches */
-  return 0;
+#endif  /* APP_AUTO_ACK */
+  /* Drop replays of a frame we already have, for instance the copy relayed
+   * by a range extender. An ack was still sent above in case the first one
+   * was lost. An empty poll reply from the AP carries the polled peer's
+   * address but a TID from the AP's own count, so it is kept out of the
+   * peer's window. A second copy of an empty frame does no harm.
+   */
+  if (rc && !isEmptyPollRsp(frame) && isDupTID(ptr, frame))
+  {
+    rc = 0;
+  }
+  /* Unconditionally kill the reply delay semaphore. This used to be done
+   * unconditionally in the calling routine.
+   */
+  MRFI_PostKillSem();
+  return rc;
 }
 
 /******************************************************************************
@@ -814,7 +1190,9 @@ uint8_t nwk_isValidReply(mrfiPacket_t *frame, uint8_t tid, uint8_t infoOffset, u
 /******************************************************************************
  * @fn          map_lid2idx
  *
- * @brief       Map link ID to index into connection table.
+ * @brief       Map link ID to index into connection table. The Link ID map
+ *              names the only entry that can own the Link ID so this is a
+ *              single compare.
  *
  * input parameters
  * @param   lid   - Link ID to be matched
@@ -826,25 +1204,181 @@ uint8_t nwk_isValidReply(mrfiPacket_t *frame, uint8_t tid, uint8_t infoOffset, u
  */
 static uint8_t map_lid2idx(linkID_t lid, uint8_t *idx)
 {
-  uint8_t     i;
-  connInfo_t *ptr = sPersistInfo.connStruct;
+  uint8_t i = sLidMap[lid & (CONN_HASH_SIZE-1)];
 
+  if ((i < SYS_NUM_CONNECTIONS) &&
+      (CONNSTATE_CONNECTED == sPersistInfo.connStruct[i].connState) &&
+      (sPersistInfo.connStruct[i].thisLinkID == lid))
+  {
+    *idx = i;
+    return 1;
+  }
+
+  return 0;
+}
+
+/******************************************************************************
+ * @fn          lidSlotBusy
+ *
+ * @brief       Is the Link ID map slot for a Link ID held by an entry other
+ *              than the one being set up? An entry holds its slot from the
+ *              time it is given a Link ID until it is freed, including while
+ *              the link exchange is in progress.
+ *
+ * input parameters
+ * @param   lid    - candidate Link ID
+ * @param   pSelf  - entry the Link ID is for
+ *
+ * output parameters
+ *
+ * @return   Non-zero if the slot is taken.
+ */
+static uint8_t lidSlotBusy(linkID_t lid, const connInfo_t *pSelf)
+{
+  uint8_t           i = sLidMap[lid & (CONN_HASH_SIZE-1)];
+  const connInfo_t *ptr;
+
+  if (i >= SYS_NUM_CONNECTIONS)
+  {
+    return 0;
+  }
+  ptr = &sPersistInfo.connStruct[i];
+
+  return (ptr != pSelf) && (CONNSTATE_FREE != ptr->connState) &&
+         !((ptr->thisLinkID ^ lid) & (CONN_HASH_SIZE-1));
+}
+
+/******************************************************************************
+ * @fn          lidMapFill
+ *
+ * @brief       Build a Link ID map for a connection table.
+ *
+ * input parameters
+ * @param   pTable  - connection table, SYS_NUM_CONNECTIONS entries
+ *
+ * output parameters
+ * @param   map     - CONN_HASH_SIZE slots
+ *
+ * @return   0 if two entries in use share a slot, else non-zero.
+ */
+static uint8_t lidMapFill(uint8_t *map, const connInfo_t *pTable)
+{
+  uint8_t  i;
+  uint8_t *slot;
+
+  memset(map, 0xFF, CONN_HASH_SIZE);
+  for (i=0; i<SYS_NUM_CONNECTIONS; ++i, ++pTable)
+  {
+    if (CONNSTATE_FREE != pTable->connState)
+    {
+      slot = &map[pTable->thisLinkID & (CONN_HASH_SIZE-1)];
+      if (*slot < SYS_NUM_CONNECTIONS)
+      {
+        return 0;
+      }
+      *slot = i;
+    }
+  }
+
+  return 1;
+}
+
+/******************************************************************************
+ * @fn          connMatch
+ *
+ * @brief       Does a connected entry match a peer address and port?
+ *
+ * input parameters
+ * @param   ptr     - connection table entry
+ * @param   addr    - peer address. ignored for the user bcast Rx port.
+ * @param   port    - port to match
+ * @param   which   - CHK_RX to match the local Rx port, CHK_TX the peer's port
+ *
+ * output parameters
+ *
+ * @return   Non-zero if the entry matches.
+ */
+static uint8_t connMatch(connInfo_t *ptr, const uint8_t *addr, uint8_t port, uint8_t which)
+{
+  if (CONNSTATE_CONNECTED != ptr->connState)
+  {
+    return 0;
+  }
+  if (CHK_RX == which)
+  {
+    /* check port first since we're done if the port is the user bcast port. */
+    return (port == ptr->portRx) &&
+           ((SMPL_PORT_USER_BCAST == port) || !memcmp(ptr->peerAddr, addr, NET_ADDR_SIZE));
+  }
+
+  return (port == ptr->portTx) && !memcmp(ptr->peerAddr, addr, NET_ADDR_SIZE);
+}
+
+/******************************************************************************
+ * @fn          findConn
+ *
+ * @brief       Find the connected entry for a peer address and port. The hint
+ *              table remembers which entry each address/port hash last matched
+ *              so a lookup is normally one compare. A hint is always verified,
+ *              so entries that were freed, re-linked or restored from NV behind
+ *              our back only cost a scan of the table. The hints are not
+ *              authoritative: the peers' addresses aren't ours to choose, so
+ *              unlike Link IDs they can't be kept from sharing a slot. A miss
+ *              and a peer whose slot another peer last used both scan, so the
+ *              worst case is SYS_NUM_CONNECTIONS compares. The scan checks the
+ *              state and port of an entry before its address.
+ *              The port is shifted before it is mixed in because the AP hands
+ *              out descending Rx ports to EDs whose addresses differ only in
+ *              the ascending first byte, and a plain XOR cancels the two.
+ *
+ * input parameters
+ * @param   hint    - hint table for this kind of lookup
+ * @param   addr    - peer address. ignored for the user bcast Rx port.
+ * @param   port    - port to match
+ * @param   which   - CHK_RX to match the local Rx port, CHK_TX the peer's port
+ *
+ * output parameters
+ *
+ * @return   Pointer to matching connection table entry else 0.
+ */
+static connInfo_t *findConn(uint8_t *hint, const uint8_t *addr, uint8_t port, uint8_t which)
+{
+  uint8_t     i, h = port << 1;
+  connInfo_t *ptr;
+
+  if ((CHK_TX == which) || (SMPL_PORT_USER_BCAST != port))
+  {
+    for (i=0; i<NET_ADDR_SIZE; ++i)
+    {
+      h ^= addr[i];
+    }
+  }
+  hint += h & (CONN_HASH_SIZE-1);
+
+  if ((*hint < SYS_NUM_CONNECTIONS) && connMatch(&sPersistInfo.connStruct[*hint], addr, port, which))
+  {
+    return &sPersistInfo.connStruct[*hint];
+  }
+
+  ptr = sPersistInfo.connStruct;
   for (i=0; i<SYS_NUM_CONNECTIONS; ++i, ++ptr)
   {
-    if ((CONNSTATE_CONNECTED == ptr->connState) && (ptr->thisLinkID == lid))
+    if (connMatch(ptr, addr, port, which))
     {
-      *idx = i;
-      return 1;
+      *hint = i;
+      return ptr;
     }
   }
 
-  return 0;
+  return (connInfo_t *)NULL;
 }
 
 /******************************************************************************
  * @fn          nwk_findPeer
  *
- * @brief       Find connection entry for a peer
+ * @brief       Find connection entry for a peer. Runs in the Rx ISR thread
+ *              for unlink frames. At most SYS_NUM_CONNECTIONS compares when
+ *              the hint misses (see findConn()).
  *
  * input parameters
  * @param   peerAddr   - address of peer
@@ -856,24 +1390,159 @@ static uint8_t map_lid2idx(linkID_t lid, uint8_t *idx)
  */
 connInfo_t *nwk_findPeer(addr_t *peerAddr, uint8_t peerPort)
 {
-  uint8_t     i;
-  connInfo_t *ptr = sPersistInfo.connStruct;
+  return findConn(sTxHint, peerAddr->addr, peerPort, CHK_TX);
+}
 
-  for (i=0; i<SYS_NUM_CONNECTIONS; ++i, ++ptr)
+/******************************************************************************
+ * @fn          isDupTID
+ *
+ * @brief       Check the frame's transaction ID against the sliding window
+ *              for its connection and record it. Runs in the Rx ISR thread.
+ *              Each sender numbers every frame it sends from one counter, so
+ *              the IDs seen on a connection increase but may skip a lot: an AP
+ *              sending to 8 peers moves on by 8 or more between frames on one
+ *              link. A forward jump just slides the window. An ID behind the
+ *              window is a late retransmit or replay and is rejected, unless
+ *              TID_RESYNC of them arrive in a row with nothing newer between.
+ *              Then the sender must have restarted its count without
+ *              relinking and the window starts over there. A reconnect or
+ *              a Ping from the peer (nwk_resetPeerTIDs()) starts it over too.
+ *
+ * input parameters
+ * @param   pCInfo  - connection the frame was received on
+ * @param   frame   - received frame
+ *
+ * output parameters
+ *
+ * @return   Non-zero if the frame has already been received.
+ */
+static uint8_t isDupTID(connInfo_t *pCInfo, mrfiPacket_t *frame)
+{
+  uint8_t      tid = GET_FROM_FRAME(MRFI_P_PAYLOAD(frame), F_TRACTID_OS);
+  uint8_t      idx = nwk_getConnIndex(pCInfo);
+  tidWindow_t *pW;
+  int8_t       diff;
+
+  if (idx < NUM_CONNECTIONS)
   {
-    if (CONNSTATE_CONNECTED == ptr->connState)
+    pW = &sTidWin[idx];
+  }
+  else
+  {
+    /* UUD link. find the sender's window or take over the oldest one. */
+    for (idx=0; idx<UUD_TID_SOURCES; ++idx)
     {
-      if (!memcmp(peerAddr, ptr->peerAddr, NET_ADDR_SIZE))
+      if (!memcmp(sUudWin[idx].addr, MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE))
       {
-        if (peerPort == ptr->portTx)
-        {
-          return ptr;
-        }
+        break;
       }
     }
+    if (UUD_TID_SOURCES == idx)
+    {
+      idx = sUudNext;
+      sUudNext = (sUudNext + 1) % UUD_TID_SOURCES;
+      memcpy(sUudWin[idx].addr, MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE);
+      sUudWin[idx].win.lastTID = 0;
+    }
+    pW = &sUudWin[idx].win;
   }
 
-  return (connInfo_t *)NULL;
+  diff = (int8_t)(tid - pW->lastTID);
+  if (pW->lastTID && (diff <= -TID_WINDOW))
+  {
+    if (++pW->behind < TID_RESYNC)
+    {
+      return 1;
+    }
+    /* the sender restarted. start over. */
+    pW->lastTID = 0;
+  }
+  pW->behind = 0;
+
+  if (!pW->lastTID)
+  {
+    /* first frame. start the window here. */
+    pW->lastTID = tid;
+    pW->seen    = 1;
+  }
+  else if (diff > 0)
+  {
+    /* newest yet. slide the window. */
+    pW->lastTID = tid;
+    pW->seen    = (diff < TID_WINDOW) ? (uint8_t)((pW->seen << diff) | 1) : 1;
+  }
+  else if (pW->seen & (1 << -diff))
+  {
+    return 1;
+  }
+  else
+  {
+    /* late but not seen yet */
+    pW->seen |= 1 << -diff;
+  }
+
+  return 0;
+}
+
+/******************************************************************************
+ * @fn          isEmptyPollRsp
+ *
+ * @brief       Is this the empty frame an AP sends in answer to a poll when
+ *              it holds nothing for the poller? It has no application payload
+ *              and is marked as forwarded by an AP.
+ *
+ * input parameters
+ * @param   frame   - received frame
+ *
+ * output parameters
+ *
+ * @return   Non-zero if it is.
+ */
+static uint8_t isEmptyPollRsp(mrfiPacket_t *frame)
+{
+  return (F_APP_PAYLOAD_OS == MRFI_GET_PAYLOAD_LEN(frame)) &&
+         (F_TX_DEVICE_AP == GET_FROM_FRAME(MRFI_P_PAYLOAD(frame), F_TX_DEVICE)) &&
+         GET_FROM_FRAME(MRFI_P_PAYLOAD(frame), F_FWD_FRAME);
+}
+
+/******************************************************************************
+ * @fn          nwk_resetPeerTIDs
+ *
+ * @brief       Forget the transaction IDs received from a peer on every
+ *              connection to it and on the UUD link. Called when the peer
+ *              Pings us, which a device resuming a saved link does before it
+ *              sends anything else. It restarted its count at a random value,
+ *              and without this its first TID_RESYNC-1 frames could be taken
+ *              for replays. Runs in the Rx ISR thread.
+ *
+ * input parameters
+ * @param   addr    - peer address
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+void nwk_resetPeerTIDs(const uint8_t *addr)
+{
+  uint8_t i;
+
+  for (i=0; i<NUM_CONNECTIONS; ++i)
+  {
+    if ((CONNSTATE_CONNECTED == sPersistInfo.connStruct[i].connState) &&
+        !memcmp(sPersistInfo.connStruct[i].peerAddr, addr, NET_ADDR_SIZE))
+    {
+      sTidWin[i].lastTID = 0;
+    }
+  }
+  for (i=0; i<UUD_TID_SOURCES; ++i)
+  {
+    if (!memcmp(sUudWin[i].addr, addr, NET_ADDR_SIZE))
+    {
+      sUudWin[i].win.lastTID = 0;
+    }
+  }
+
+  return;
 }
 
 /******************************************************************************
@@ -1030,12 +1699,11 @@ void nwk_putNumObjectIntoMsg(void *src, void *dest, uint8_t objSize)
  * @param   action  - GET or SET
  * @param   val     - (GET/SET) pointer to NV IOCTL object.
  *                    (SET) NV length and version values to be used for sanity
- *                    checks.
+ *                    checks and pointer to the saved connection context.
  *
  * output parameters
  * @param   val     - (GET) Version number of NV object, size of NV object and
  *                          pointer to the connection context memory.
- *                  - (SET) Pointer to the connection context memory.
  *
  * @return   SMPL_SUCCESS
  *           SMPL_BAD_PARAM   Object version or size do not conform on a SET call
@@ -1048,6 +1716,17 @@ smplStatus_t nwk_NVObj(ioctlAction_t action, ioctlNVObj_t *val)
 
   if (IOCTL_ACT_GET == action)
   {
+    /* bring the context kept elsewhere up to date so the image is complete */
+    nwk_getJoinToken(&sPersistInfo.joinToken);
+    nwk_getLinkToken(&sPersistInfo.linkToken);
+    if (nwk_getAPAddress())
+    {
+      memcpy(&sPersistInfo.apAddr, nwk_getAPAddress(), NET_ADDR_SIZE);
+    }
+#ifdef FREQUENCY_AGILITY
+    nwk_getChannel(&sPersistInfo.curChan);
+#endif
+
     /* Populate helper objects */
     val->objLen     = SIZEOF_NV_OBJ;
     val->objVersion = sPersistInfo.structureVersion;
@@ -1057,6 +1736,39 @@ smplStatus_t nwk_NVObj(ioctlAction_t action, ioctlNVObj_t *val)
       *(val->objPtr) = (uint8_t *)&sPersistInfo;
     }
   }
+  else if (IOCTL_ACT_SET == action)
+  {
+    const persistentContext_t *pSaved;
+
+    /* the saved image must come from this build of the structure. the
+     * version is checked both as stated and as stored in the image.
+     */
+    if (!val->objPtr || !*(val->objPtr) ||
+        (val->objVersion != sPersistInfo.structureVersion) ||
+        (val->objLen != SIZEOF_NV_OBJ))
+    {
+      return SMPL_BAD_PARAM;
+    }
+    pSaved = (const persistentContext_t *)*(val->objPtr);
+    if ((pSaved->structureVersion != sPersistInfo.structureVersion) ||
+        (pSaved->numConnections != SYS_NUM_CONNECTIONS))
+    {
+      return SMPL_BAD_PARAM;
+    }
+    {
+      /* the Link IDs must fit the map. only images from builds that
+       * handed them out in sequence can fail this.
+       */
+      uint8_t map[CONN_HASH_SIZE];
+
+      if (!lidMapFill(map, pSaved->connStruct))
+      {
+        return SMPL_BAD_PARAM;
+      }
+    }
+
+    restoreContext(pSaved);
+  }
   else
   {
     rc = SMPL_BAD_PARAM;
@@ -1067,3 +1779,48 @@ smplStatus_t nwk_NVObj(ioctlAction_t action, ioctlNVObj_t *val)
   return SMPL_BAD_PARAM;
 #endif
 }
+
+#ifdef NVOBJECT_SUPPORT
+/******************************************************************************
+ * @fn          restoreContext
+ *
+ * @brief       Overwrite the connection context with a saved one and hand
+ *              the tokens, AP address and channel back to their modules.
+ *              The Link ID map is rebuilt for the new table. The lookup hints
+ *              and duplicate filters describe the old table so they start over.
+ *
+ * input parameters
+ * @param   pSaved  - saved context. version, size and Link IDs already checked.
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+static void restoreContext(const persistentContext_t *pSaved)
+{
+  bspIState_t intState;
+
+  BSP_ENTER_CRITICAL_SECTION(intState);
+
+  /* skip the const version element */
+  memcpy((((uint8_t *)&sPersistInfo)+1), (((const uint8_t *)pSaved)+1), (sizeof(sPersistInfo)-1));
+
+  lidMapFill(sLidMap, sPersistInfo.connStruct);
+  memset(sRxHint, 0xFF, sizeof(sRxHint));
+  memset(sTxHint, 0xFF, sizeof(sTxHint));
+  memset(sTidWin, 0x0, sizeof(sTidWin));
+  memset(sUudWin, 0x0, sizeof(sUudWin));
+  nwk_dropHdrTemplate(NULL);
+
+  BSP_EXIT_CRITICAL_SECTION(intState);
+
+  nwk_setJoinToken(sPersistInfo.joinToken);
+  nwk_setLinkToken(sPersistInfo.linkToken);
+  nwk_setAPAddress(&sPersistInfo.apAddr);
+#ifdef FREQUENCY_AGILITY
+  nwk_setChannel(&sPersistInfo.curChan);
+#endif
+
+  return;
+}
+#endif  /* NVOBJECT_SUPPORT */
@@ -44,6 +44,10 @@
 #define SMPL_PORT_SECURITY      0x04
 #define SMPL_PORT_FREQ          0x05
 #define SMPL_PORT_MGMT          0x06
+#define SMPL_PORT_BULK          0x07
+
+/* highest NWK application port */
+#define SMPL_PORT_NWK_MAX       SMPL_PORT_BULK
 
 #define SMPL_PORT_NWK_BCAST     0x1F
 #define SMPL_PORT_USER_BCAST    0x3F
@@ -76,6 +80,9 @@
 #define LINK_SEND   1
 #define LINK_REPLY  2
 
+/* connection table size. includes the UUD port/link ID */
+#define SYS_NUM_CONNECTIONS   (NUM_CONNECTIONS+1)
+
 #define  CONNSTATE_FREE       (0x00)
 #define  CONNSTATE_JOINED     (0x01)
 #define  CONNSTATE_CONNECTED  (0x02)
@@ -134,6 +141,8 @@ connInfo_t   *nwk_getNextConnection(void);
 void          nwk_freeConnection(connInfo_t *);
 uint8_t       nwk_getNextClientPort(void);
 connInfo_t   *nwk_getConnInfo(linkID_t port);
+uint8_t       nwk_getConnIndex(connInfo_t *);
+connInfo_t   *nwk_getConnByIndex(uint8_t);
 connInfo_t   *nwk_isLinkDuplicate(uint8_t *, uint8_t);
 uint8_t       nwk_findAddressMatch(mrfiPacket_t *);
 smplStatus_t  nwk_checkConnInfo(connInfo_t *, uint8_t);
@@ -141,7 +150,12 @@ uint8_t       nwk_isConnectionValid(mrfiPacket_t *, linkID_t *);
 uint8_t       nwk_allocateLocalRxPort(uint8_t, connInfo_t *);
 uint8_t       nwk_isValidReply(mrfiPacket_t *, uint8_t, uint8_t, uint8_t);
 connInfo_t   *nwk_findPeer(addr_t *, uint8_t);
+void          nwk_resetPeerTIDs(const uint8_t *);
 smplStatus_t  nwk_NVObj(ioctlAction_t, ioctlNVObj_t *);
+#ifdef APP_AUTO_ACK
+void          nwk_ackWaitStart(connInfo_t *, void (*)(linkID_t, smplStatus_t));
+smplStatus_t  nwk_ackStatus(connInfo_t *);
+#endif
 
 
 uint8_t       nwk_checkAppMsgTID(appPTid_t, appPTid_t);
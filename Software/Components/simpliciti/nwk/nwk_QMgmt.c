@@ -38,6 +38,7 @@
  * INCLUDES
  */
 #include <intrinsics.h>
+#include <stddef.h>
 #include <string.h>
 #include "bsp.h"
 #include "mrfi.h"
@@ -46,14 +47,51 @@
 #include "nwk_frame.h"
 #include "nwk_QMgmt.h"
 #include "nwk_mgmt.h"     /* need offsets for poll frames */
+#include "nwk_join.h"     /* store-and-forward client lookup */
 
 /******************************************************************************
  * MACROS
  */
+/* input frame queue entry by index. full size slots come first. */
+#if SIZE_INFRAME_SMALL_Q > 0
+#define  IN_SLOT(i)         ((i) < SIZE_INFRAME_Q ? &sInFrameQ[i] : (frameInfo_t *)sInSmallQ[(i)-SIZE_INFRAME_Q])
+#define  IS_SMALL_SLOT(p)   (((uint32_t *)(p) >= sInSmallQ[0]) && ((uint32_t *)(p) < sInSmallQ[SIZE_INFRAME_SMALL_Q]))
+#else
+#define  IN_SLOT(i)         (&sInFrameQ[i])
+#endif
+
+/* bytes of a packet in use: everything ahead of the frame buffer and the
+ * frame itself. the rest of the buffer may not exist (small Rx slot).
+ */
+#define  PKT_BYTES(p)       (offsetof(mrfiPacket_t, frame) + __mrfi_LENGTH_FIELD_SIZE__ + (p)->frame[__mrfi_LENGTH_FIELD_OFS__])
 
 /******************************************************************************
  * CONSTANTS AND DEFINES
  */
+/* end of list marker for the queue links */
+#define  Q_NIL   0xFF
+
+#if SIZE_INFRAME_Q + SIZE_INFRAME_SMALL_Q > 254
+#error ERROR: SIZE_INFRAME_Q plus SIZE_INFRAME_SMALL_Q must be < 255
+#endif
+
+#if SIZE_INFRAME_SMALL_Q > 0
+#if SIZE_INFRAME_Q < 1
+#error ERROR: SIZE_INFRAME_SMALL_Q needs at least one full size slot (SIZE_INFRAME_Q)
+#endif
+#ifndef MRFI_RX_IN_PLACE
+#error ERROR: SIZE_INFRAME_SMALL_Q needs a radio that reads frames in place
+#endif
+#if SMALL_APP_PAYLOAD >= MAX_APP_PAYLOAD
+#error ERROR: SMALL_APP_PAYLOAD must be less than MAX_APP_PAYLOAD
+#endif
+
+/* A small slot is a frameInfo_t cut short after SMALL_FRAME_SIZE bytes of
+ * frame buffer. That works because the frame buffer comes last.
+ */
+#define  SMALL_FRAME_SIZE   (MRFI_MAX_FRAME_SIZE - MAX_APP_PAYLOAD + SMALL_APP_PAYLOAD)
+#define  SMALL_SLOT_WORDS   ((sizeof(frameInfo_t) - MRFI_MAX_FRAME_SIZE + SMALL_FRAME_SIZE + 3) / 4)
+#endif  /* SIZE_INFRAME_SMALL_Q > 0 */
 
 /******************************************************************************
  * TYPEDEFS
@@ -65,15 +103,49 @@
 
 #if SIZE_INFRAME_Q > 0
 static frameInfo_t   sInFrameQ[SIZE_INFRAME_Q];
+#if SIZE_INFRAME_SMALL_Q > 0
+static uint32_t      sInSmallQ[SIZE_INFRAME_SMALL_Q][SMALL_SLOT_WORDS];
+#endif
+
+/* head and tail of each port or link queue */
+static uint8_t       sQHead[NUM_RX_QUEUES];
+static uint8_t       sQTail[NUM_RX_QUEUES];
+
+/* free entries of each size, and both ends of the age list of queued entries */
+static uint8_t       sFreeHead;
+#if SIZE_INFRAME_SMALL_Q > 0
+static uint8_t       sFreeSmall;
+#endif
+static uint8_t       sOldest;
+static uint8_t       sNewest;
 #else
 static frameInfo_t  *sInFrameQ = NULL;
 #endif  /* SIZE_INFRAME_Q > 0 */
 
 static frameInfo_t   sOutFrameQ[SIZE_OUTFRAME_Q];
 
+#ifdef ACCESS_POINT
+/* store-and-forward pool: a queue and a frame count for each client, and the
+ * free entries. queue links are indices into the pool.
+ */
+static frameInfo_t   sSandFQ[SIZE_SANDF_Q];
+static uint8_t       sSFHead[NUM_STORE_AND_FWD_CLIENTS];
+static uint8_t       sSFTail[NUM_STORE_AND_FWD_CLIENTS];
+static uint8_t       sSFCount[NUM_STORE_AND_FWD_CLIENTS];
+static uint8_t       sSFFree;
+#endif  /* ACCESS_POINT */
+
 /******************************************************************************
  * LOCAL FUNCTIONS
  */
+#if SIZE_INFRAME_Q > 0
+static uint8_t inIndex(frameInfo_t *);
+static void    unlinkQueue(uint8_t);
+static void    unlinkAge(uint8_t);
+#endif
+#ifdef ACCESS_POINT
+static frameInfo_t *takeSandFHead(uint8_t);
+#endif
 
 /******************************************************************************
  * GLOBAL VARIABLES
@@ -97,20 +169,56 @@ static frameInfo_t   sOutFrameQ[SIZE_OUTFRAME_Q];
 void nwk_QInit(void)
 {
 #if SIZE_INFRAME_Q > 0
+  uint8_t i;
+
   memset(sInFrameQ, 0, sizeof(sInFrameQ));
+  memset(sQHead, Q_NIL, sizeof(sQHead));
+  memset(sQTail, Q_NIL, sizeof(sQTail));
+
+  /* every entry starts out on the free list */
+  for (i=0; i<SIZE_INFRAME_Q; ++i)
+  {
+    sInFrameQ[i].qNext = i + 1;
+  }
+  sInFrameQ[SIZE_INFRAME_Q-1].qNext = Q_NIL;
+  sFreeHead = 0;
+#if SIZE_INFRAME_SMALL_Q > 0
+  memset(sInSmallQ, 0, sizeof(sInSmallQ));
+  for (i=SIZE_INFRAME_Q; i<SIZE_INFRAME_Q+SIZE_INFRAME_SMALL_Q; ++i)
+  {
+    IN_SLOT(i)->qNext = i + 1;
+  }
+  IN_SLOT(SIZE_INFRAME_Q+SIZE_INFRAME_SMALL_Q-1)->qNext = Q_NIL;
+  sFreeSmall = SIZE_INFRAME_Q;
+#endif
+  sOldest   = Q_NIL;
+  sNewest   = Q_NIL;
 #endif  // SIZE_INFRAME_Q > 0
   memset(sOutFrameQ, 0, sizeof(sOutFrameQ));
+
+#ifdef ACCESS_POINT
+  {
+    uint8_t j;
+
+    memset(sSandFQ, 0, sizeof(sSandFQ));
+    memset(sSFHead, Q_NIL, sizeof(sSFHead));
+    memset(sSFTail, Q_NIL, sizeof(sSFTail));
+    memset(sSFCount, 0, sizeof(sSFCount));
+    for (j=0; j<SIZE_SANDF_Q; ++j)
+    {
+      sSandFQ[j].qNext = j + 1;
+    }
+    sSandFQ[SIZE_SANDF_Q-1].qNext = Q_NIL;
+    sSFFree = 0;
+  }
+#endif  /* ACCESS_POINT */
 }
  
 /******************************************************************************
  * @fn          nwk_QfindSlot
  *
- * @brief       Finds a slot to use to retrieve the frame from the radio. It
- *              uses a LRU cast-out scheme. It is possible that this routine
- *              finds no slot. This can happen if the queue is of size 1 or 2
- *              and the Rx interrupt occurs during a retrieval call from an
- *              application. There are meta-states for frames as the application
- *              looks for the oldest frame on the port being requested.
+ * @brief       Finds a slot to use for a frame. An input slot is full size.
+ *              See nwk_QfindRxSlot().
  *
  *              This routine is running in interrupt context.
  *
@@ -119,130 +227,276 @@ void nwk_QInit(void)
  *
  * output parameters
  *
- * @return      Pointer to oldest available frame in the queue
+ * @return      Pointer to available frame in the queue
  */
 frameInfo_t *nwk_QfindSlot(uint8_t which)
 {
-  frameInfo_t *pFI, *oldest= 0, *newFI = 0;
-  uint8_t        i, num, newOrder = 0, orderTest;
+  frameInfo_t *pFI;
+  uint8_t      i;
 
   if (INQ == which)
   {
-    pFI  = sInFrameQ;
-    num  = SIZE_INFRAME_Q;
+    return nwk_QfindRxSlot(MRFI_MAX_FRAME_SIZE);
   }
-  else
+
+  /* TODO: do cast-out for Tx as well */
+  pFI = sOutFrameQ;
+  for (i=0; i<SIZE_OUTFRAME_Q; ++i, ++pFI)
   {
-    pFI  = sOutFrameQ;
-    num  = SIZE_OUTFRAME_Q;
+    if (FI_AVAILABLE == pFI->fi_usage)
+    {
+      return pFI;
+    }
   }
 
-  orderTest = num + 1;
+  return (frameInfo_t *)0;
+}
 
-  for (i=0; i<num; ++i, ++pFI)
-  {
-    /* if frame is available it's a candidate. */
-    if (pFI->fi_usage != FI_AVAILABLE)
-    {
-      if (INQ == which)  /* TODO: do cast-out for Tx as well */
-      {
+/******************************************************************************
+ * @fn          nwk_QfindRxSlot
+ *
+ * @brief       Finds a slot to use to retrieve the frame from the radio. A
+ *              frame that fits a small slot gets one if there's one free so
+ *              the full size slots are left for frames that need them. It
+ *              uses a LRU cast-out scheme: if no slot big enough is free the
+ *              oldest queued frame in a slot big enough is reused. Frames
+ *              being retrieved by the application are on no queue so they are
+ *              never cast out. It is possible that this routine finds no slot.
+ *              This can happen if the queue is of size 1 or 2 and the Rx
+ *              interrupt occurs during a retrieval call from an application.
+ *
+ *              The Rx slot is returned in the FI_INUSE_TRANSITION state. It is
+ *              up to the caller to queue it or free it.
+ *
+ *              This routine is running in interrupt context.
+ *
+ * input parameters
+ * @param   size    - bytes of frame buffer the frame needs, including the
+ *                    length field
+ *
+ * output parameters
+ *
+ * @return      Pointer to available frame in the queue
+ */
+frameInfo_t *nwk_QfindRxSlot(uint8_t size)
+{
+#if SIZE_INFRAME_Q > 0
+  frameInfo_t *pFI;
+  uint8_t      i;
+#if SIZE_INFRAME_SMALL_Q > 0
+  uint8_t      small = (size <= SMALL_FRAME_SIZE);
 
-        /* need to know the number of occupied slots so we know the age value
-         * for the unoccupied slot (if there is one).
-         */
-        newOrder++;
-
-        /* make sure nwk_retrieveFrame() is not processing this frame */
-        if (FI_INUSE_TRANSITION == pFI->fi_usage)
-        {
-          continue;
-        }
-        /* is this frame older than any we've seen? */
-        if (orderTest > pFI->orderStamp)
-        {
-          /* yes. */
-          oldest    = pFI;
-          orderTest = pFI->orderStamp;
-        }
-      }
-    }
-    else
-    {
-      if (OUTQ == which)  /* TODO: do cast-out for Tx as well */
-      {
-        return pFI;
-      }
-      newFI = pFI;
-    }
+  if (small && (Q_NIL != (i = sFreeSmall)))
+  {
+    pFI        = IN_SLOT(i);
+    sFreeSmall = pFI->qNext;
   }
+  else
+#else
+  uint8_t      small = 1;
 
-  /* did we find anything? */
-  if (!newFI)
+  (void) size;
+#endif
+  if (Q_NIL != (i = sFreeHead))
+  {
+    pFI       = &sInFrameQ[i];
+    sFreeHead = pFI->qNext;
+  }
+  else
   {
     /* queue was full. cast-out happens here...unless... */
-    if (!oldest)
+    for (i = sOldest; (Q_NIL != i) && !small && (i >= SIZE_INFRAME_Q); i = IN_SLOT(i)->ageNewer)
+    {
+      ;
+    }
+    if (Q_NIL == i)
     {
       /* This can happen if the queue is only of size 1 or 2 and all
        * the frames are in transition when the Rx interrupt occurs.
        */
       return (frameInfo_t *)0;
     }
-    newFI = oldest;
-    nwk_QadjustOrder(which, newFI->orderStamp);
-    newFI->orderStamp = i;
+    pFI = IN_SLOT(i);
+
+    unlinkQueue(i);
+    unlinkAge(i);
+  }
+  pFI->fi_usage = FI_INUSE_TRANSITION;
+
+  return pFI;
+#else
+  (void) size;
+  return (frameInfo_t *)0;
+#endif  /* SIZE_INFRAME_Q > 0 */
+}
+
+/******************************************************************************
+ * @fn          nwk_QslotFits
+ *
+ * @brief       Check whether an Rx slot is big enough for a frame.
+ *
+ * input parameters
+ * @param   pFI     - slot from nwk_QfindRxSlot()
+ * @param   size    - bytes of frame buffer the frame needs, including the
+ *                    length field
+ *
+ * output parameters
+ *
+ * @return      Non-zero if the frame fits.
+ */
+uint8_t nwk_QslotFits(frameInfo_t *pFI, uint8_t size)
+{
+#if SIZE_INFRAME_SMALL_Q > 0
+  return !IS_SMALL_SLOT(pFI) || (size <= SMALL_FRAME_SIZE);
+#else
+  (void) pFI;
+  (void) size;
+  return 1;
+#endif
+}
+
+#if SIZE_INFRAME_Q > 0
+/******************************************************************************
+ * @fn          nwk_QappendFrame
+ *
+ * @brief       Add a received frame to the tail of a port or link queue and
+ *              mark it as the newest frame for the LRU cast-out.
+ *
+ *              This routine is running in interrupt context.
+ *
+ * input parameters
+ * @param   pFI     - frame from nwk_QfindSlot(INQ)
+ * @param   qid     - queue to use: QID_LINK() or QID_NWK()
+ * @param   usage   - FI_INUSE_UNTIL_DEL
+ *
+ * output parameters
+ *
+ * @return      void
+ */
+void nwk_QappendFrame(frameInfo_t *pFI, uint8_t qid, uint8_t usage)
+{
+  uint8_t i = inIndex(pFI);
+
+  pFI->qid   = qid;
+  pFI->qNext = Q_NIL;
+  if (Q_NIL == sQTail[qid])
+  {
+    sQHead[qid] = i;
   }
   else
   {
-    /* mark the available slot. */
-    newFI->orderStamp = ++newOrder;
+    IN_SLOT(sQTail[qid])->qNext = i;
   }
+  sQTail[qid] = i;
 
-  return newFI;
+  pFI->ageOlder = sNewest;
+  pFI->ageNewer = Q_NIL;
+  if (Q_NIL == sNewest)
+  {
+    sOldest = i;
+  }
+  else
+  {
+    IN_SLOT(sNewest)->ageNewer = i;
+  }
+  sNewest = i;
+
+  pFI->fi_usage = usage;
+
+  return;
 }
 
 /******************************************************************************
- * @fn          nwk_QadjustOrder
+ * @fn          nwk_QremoveFrame
  *
- * @brief       Adjusts the age of everyone in the queue newer than the frame
- *              being removed.
+ * @brief       Take a frame back off its queue and free it, for the case where
+ *              the frame was queued but then consumed in the Rx thread. Walks
+ *              the frame's own queue so it's not for the normal retrieval path.
+ *              Does nothing if the frame has already been retrieved.
+ *
+ *              This routine is running in interrupt context.
  *
  * input parameters
- * @param   which   - INQ or OUTQ to adjust
- * @param   stamp   - value of frame being removed
+ * @param   pFI     - frame to remove
  *
  * output parameters
  *
  * @return      void
  */
-void nwk_QadjustOrder(uint8_t which, uint8_t stamp)
+void nwk_QremoveFrame(frameInfo_t *pFI)
 {
-  frameInfo_t *pFI;
-  uint8_t      i, num;
-  bspIState_t  intState;
+  uint8_t i = inIndex(pFI);
 
-  if (INQ == which)
+  if (FI_INUSE_UNTIL_DEL != pFI->fi_usage)
   {
-    pFI  = sInFrameQ;
-    num  = SIZE_INFRAME_Q;
+    return;
   }
-  else
+
+  unlinkQueue(i);
+  unlinkAge(i);
+
+  nwk_QfreeFrame(pFI);
+
+  return;
+}
+#endif  /* SIZE_INFRAME_Q > 0 */
+
+/******************************************************************************
+ * @fn          nwk_QfreeFrame
+ *
+ * @brief       Return a frame that is on no queue to the pool. Input and
+ *              store-and-forward frames go back on their free lists. Safe to
+ *              call from either thread.
+ *
+ * input parameters
+ * @param   pFI     - frame to free
+ *
+ * output parameters
+ *
+ * @return      void
+ */
+void nwk_QfreeFrame(frameInfo_t *pFI)
+{
+#if SIZE_INFRAME_Q > 0
+  bspIState_t intState;
+
+  if ((pFI >= sInFrameQ) && (pFI < &sInFrameQ[SIZE_INFRAME_Q]))
   {
-/*    pFI  = sOutFrameQ; */
-/*    num  = SIZE_OUTFRAME_Q; */
+    BSP_ENTER_CRITICAL_SECTION(intState);
+    pFI->fi_usage = FI_AVAILABLE;
+    pFI->qNext    = sFreeHead;
+    sFreeHead     = pFI - sInFrameQ;
+    BSP_EXIT_CRITICAL_SECTION(intState);
     return;
   }
+#if SIZE_INFRAME_SMALL_Q > 0
+  if (IS_SMALL_SLOT(pFI))
+  {
+    BSP_ENTER_CRITICAL_SECTION(intState);
+    pFI->fi_usage = FI_AVAILABLE;
+    pFI->qNext    = sFreeSmall;
+    sFreeSmall    = inIndex(pFI);
+    BSP_EXIT_CRITICAL_SECTION(intState);
+    return;
+  }
+#endif
+#endif  /* SIZE_INFRAME_Q > 0 */
 
-  BSP_ENTER_CRITICAL_SECTION(intState);
-
-  for (i=0; i<num; ++i, ++pFI)
+#ifdef ACCESS_POINT
+  if ((pFI >= sSandFQ) && (pFI < &sSandFQ[SIZE_SANDF_Q]))
   {
-    if ((pFI->fi_usage != FI_AVAILABLE) && (pFI->orderStamp > stamp))
-    {
-      pFI->orderStamp--;
-    }
+    bspIState_t sfState;
+
+    BSP_ENTER_CRITICAL_SECTION(sfState);
+    pFI->fi_usage = FI_AVAILABLE;
+    pFI->qNext    = sSFFree;
+    sSFFree       = pFI - sSandFQ;
+    BSP_EXIT_CRITICAL_SECTION(sfState);
+    return;
   }
+#endif  /* ACCESS_POINT */
 
-  BSP_EXIT_CRITICAL_SECTION(intState);
+  pFI->fi_usage = FI_AVAILABLE;
 
   return;
 }
@@ -250,40 +504,38 @@ void nwk_QadjustOrder(uint8_t which, uint8_t stamp)
 /******************************************************************************
  * @fn          nwk_QfindOldest
  *
- * @brief       Look through frame queue and find the oldest available frame
- *              in the context in question. Supports connection-based (user),
- *              non-connection based (NWK applications), and the special case
- *              of store-and-forward.
+ * @brief       Take the oldest frame in the context in question off its queue.
+ *              Supports connection-based (user) and non-connection based (NWK
+ *              applications) contexts. Store-and-forward frames are taken
+ *              with nwk_QtakeSandF(). The
+ *              frame is returned in the FI_INUSE_TRANSITION state and must be
+ *              given back with nwk_QfreeFrame() (or sent) when done.
+ *
+ *              For RCV_APP_ANY the oldest frame on any peer link is taken. The
+ *              age list runs oldest first across all the queues so the first
+ *              entry on a peer link queue is also the head of that queue.
  *
  * input parameters
  * @param   which      - INQ or OUTQ to adjust
  * @param   rcvContext - context information for finding the oldest
- * @param   usage      - normal usage or store-and-forward usage
+ * @param   usage      - normal usage
  *
  * output parameters
+ * @param   rcvContext - (RCV_APP_ANY) Link ID of the frame's connection
  *
  * @return      Pointer to frame that is the oldsest on the requested port, or
  *              0 if there are none.
  */
 frameInfo_t *nwk_QfindOldest(uint8_t which, rcvContext_t *rcv, uint8_t fi_usage)
 {
-  uint8_t      i, oldest, num, port;
-  uint8_t      uType, addr12Compare;
+#if SIZE_INFRAME_Q > 0
+  uint8_t      i, qid;
   bspIState_t  intState;
-  frameInfo_t *fPtr = 0, *wPtr;
+  frameInfo_t *fPtr;
   connInfo_t  *pCInfo = 0;
-  uint8_t     *pAddr1, *pAddr2, *pAddr3 = 0;
 
-  if (INQ == which)
-  {
-    wPtr   = sInFrameQ;
-    num    = SIZE_INFRAME_Q;
-    oldest = SIZE_INFRAME_Q+1;
-  }
-  else
+  if (INQ != which)
   {
-/*    pFI  = sOutFrameQ; */
-/*    num  = SIZE_OUTFRAME_Q; */
     return 0;
   }
 
@@ -294,109 +546,373 @@ frameInfo_t *nwk_QfindOldest(uint8_t which, rcvContext_t *rcv, uint8_t fi_usage)
     {
       return (frameInfo_t *)0;
     }
-    port   = pCInfo->portRx;
-    pAddr2 = pCInfo->peerAddr;
+    qid = QID_LINK(nwk_getConnIndex(pCInfo));
+  }
+  else if (RCV_APP_ANY == rcv->type)
+  {
+    qid = Q_NIL;  /* found below with the queue links protected */
   }
   else if (RCV_NWK_PORT == rcv->type)
   {
-    port = rcv->t.port;
+    if (!rcv->t.port || (rcv->t.port > SMPL_PORT_NWK_MAX))
+    {
+      return (frameInfo_t *)0;
+    }
+    qid = QID_NWK(rcv->t.port);
+  }
+  else
+  {
+    return (frameInfo_t *)0;
   }
-#ifdef ACCESS_POINT
-  else if (RCV_RAW_POLL_FRAME == rcv->type)
+
+  (void) fi_usage;  /* implied by the queue */
+
+  do {
+    fPtr = 0;
+
+    BSP_ENTER_CRITICAL_SECTION(intState);   /* protect the queue links */
+    if (RCV_APP_ANY == rcv->type)
+    {
+      for (i = sOldest; (Q_NIL != i) && (IN_SLOT(i)->qid >= QID_LINK(NUM_CONNECTIONS)); i = IN_SLOT(i)->ageNewer)
+      {
+        ;
+      }
+      qid = i;
+      if (Q_NIL != i)
+      {
+        qid = IN_SLOT(i)->qid;
+      }
+    }
+    if ((Q_NIL != qid) && (Q_NIL != (i = sQHead[qid])))
+    {
+      fPtr = IN_SLOT(i);
+      if (Q_NIL == (sQHead[qid] = fPtr->qNext))
+      {
+        sQTail[qid] = Q_NIL;
+      }
+      unlinkAge(i);
+      fPtr->fi_usage = FI_INUSE_TRANSITION;
+    }
+    BSP_EXIT_CRITICAL_SECTION(intState);
+
+    if (fPtr && (RCV_APP_ANY == rcv->type))
+    {
+      if (!(pCInfo = nwk_getConnByIndex(qid)))
+      {
+        nwk_QfreeFrame(fPtr);
+        continue;
+      }
+      rcv->t.lid = pCInfo->thisLinkID;
+    }
+    if (fPtr && pCInfo)
+    {
+      /* The connection slot may have been freed and reused since the frame
+       * was queued. Only hand it over if it still matches the connection.
+       */
+      if ((GET_FROM_FRAME(MRFI_P_PAYLOAD(&fPtr->mrfiPkt), F_PORT_OS) != pCInfo->portRx) ||
+          ((SMPL_PORT_USER_BCAST != pCInfo->portRx) &&
+           memcmp(pCInfo->peerAddr, MRFI_P_SRC_ADDR(&fPtr->mrfiPkt), NET_ADDR_SIZE)))
+      {
+        nwk_QfreeFrame(fPtr);
+        continue;
+      }
+    }
+    break;
+  } while (1);
+
+  return fPtr;
+#else
+  return (frameInfo_t *)0;
+#endif  /* SIZE_INFRAME_Q > 0 */
+}
+
+#if SIZE_INFRAME_Q > 0
+/******************************************************************************
+ * @fn          inIndex
+ *
+ * @brief       Index of an entry in the input frame queue.
+ *
+ * input parameters
+ * @param   pFI - entry
+ *
+ * output parameters
+ *
+ * @return      index
+ */
+static uint8_t inIndex(frameInfo_t *pFI)
+{
+#if SIZE_INFRAME_SMALL_Q > 0
+  if (IS_SMALL_SLOT(pFI))
   {
-    port   = *(MRFI_P_PAYLOAD(rcv->t.pkt)+F_APP_PAYLOAD_OS+M_POLL_PORT_OS);
-    pAddr2 = MRFI_P_SRC_ADDR(rcv->t.pkt);
-    pAddr3 = MRFI_P_PAYLOAD(rcv->t.pkt)+F_APP_PAYLOAD_OS+M_POLL_ADDR_OS;
+    return SIZE_INFRAME_Q + ((uint32_t *)pFI - sInSmallQ[0]) / SMALL_SLOT_WORDS;
   }
 #endif
+  return pFI - sInFrameQ;
+}
+
+/******************************************************************************
+ * @fn          unlinkQueue
+ *
+ * @brief       Remove an entry from its port or link queue. Walks the queue
+ *              since the entry needn't be at the head. Caller protects the
+ *              links.
+ *
+ * input parameters
+ * @param   i   - index of entry in the input frame queue
+ *
+ * output parameters
+ *
+ * @return      void
+ */
+static void unlinkQueue(uint8_t i)
+{
+  frameInfo_t *pFI = IN_SLOT(i);
+  uint8_t      prev, cur;
+
+  prev = Q_NIL;
+  for (cur = sQHead[pFI->qid]; cur != i; cur = IN_SLOT(cur)->qNext)
+  {
+    prev = cur;
+  }
+  if (Q_NIL == prev)
+  {
+    sQHead[pFI->qid] = pFI->qNext;
+  }
   else
   {
-    return (frameInfo_t *)0;
+    IN_SLOT(prev)->qNext = pFI->qNext;
+  }
+  if (sQTail[pFI->qid] == i)
+  {
+    sQTail[pFI->qid] = prev;
   }
 
-  uType = (USAGE_NORMAL == fi_usage) ? FI_INUSE_UNTIL_DEL : FI_INUSE_UNTIL_FWD;
+  return;
+}
 
-  for (i=0; i<num; ++i, ++wPtr)
+/******************************************************************************
+ * @fn          unlinkAge
+ *
+ * @brief       Remove an entry from the age list. Caller protects the links.
+ *
+ * input parameters
+ * @param   i   - index of entry in the input frame queue
+ *
+ * output parameters
+ *
+ * @return      void
+ */
+static void unlinkAge(uint8_t i)
+{
+  frameInfo_t *pFI = IN_SLOT(i);
+
+  if (Q_NIL == pFI->ageOlder)
+  {
+    sOldest = pFI->ageNewer;
+  }
+  else
+  {
+    IN_SLOT(pFI->ageOlder)->ageNewer = pFI->ageNewer;
+  }
+  if (Q_NIL == pFI->ageNewer)
   {
+    sNewest = pFI->ageOlder;
+  }
+  else
+  {
+    IN_SLOT(pFI->ageNewer)->ageOlder = pFI->ageOlder;
+  }
 
-    BSP_ENTER_CRITICAL_SECTION(intState);   /* protect the frame states */
+  return;
+}
+#endif  /* SIZE_INFRAME_Q > 0 */
 
-    /* only check entries in use and waiting for this port */
-    if (uType == wPtr->fi_usage)
+#ifdef ACCESS_POINT
+/******************************************************************************
+ * @fn          nwk_QstoreSandF
+ *
+ * @brief       Hold a copy of a frame for a store-and-forward client until the
+ *              client polls for it. A copy of a frame already held is ignored.
+ *              If the client has SANDF_CLIENT_DEPTH frames held its oldest one
+ *              is cast out. If the pool is full the oldest frame of the client
+ *              with the most frames held is cast out, this client's if it has
+ *              as many as any.
+ *
+ *              Safe to call from either thread.
+ *
+ * input parameters
+ * @param   frame   - frame to hold. the caller keeps its own buffer.
+ * @param   loc     - client index from nwk_isSandFClient()
+ *
+ * output parameters
+ *
+ * @return      void
+ */
+void nwk_QstoreSandF(mrfiPacket_t *frame, uint8_t loc)
+{
+  uint8_t      i, plLen = MRFI_GET_PAYLOAD_LEN(frame);
+  frameInfo_t *pFI;
+  bspIState_t  intState;
+
+  BSP_ENTER_CRITICAL_SECTION(intState);
+
+  /* compare everything except the DEVICE INFO byte. the source is in the
+   * client's own queue or nowhere.
+   */
+  for (i = sSFHead[loc]; i != Q_NIL; i = pFI->qNext)
+  {
+    pFI = &sSandFQ[i];
+    if (MRFI_GET_PAYLOAD_LEN(&pFI->mrfiPkt) == plLen                                   &&
+        !memcmp(MRFI_P_SRC_ADDR(&pFI->mrfiPkt), MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE) &&
+        !memcmp(MRFI_P_PAYLOAD(&pFI->mrfiPkt), MRFI_P_PAYLOAD(frame), 1)               &&
+        !memcmp(MRFI_P_PAYLOAD(&pFI->mrfiPkt)+F_TRACTID_OS, MRFI_P_PAYLOAD(frame)+F_TRACTID_OS, plLen-F_TRACTID_OS)
+        )
     {
-      wPtr->fi_usage = FI_INUSE_TRANSITION;
+      BSP_EXIT_CRITICAL_SECTION(intState);
+      return;
+    }
+  }
 
-      BSP_EXIT_CRITICAL_SECTION(intState);  /* release hold */
-      /* message sent to this device? */
-      if (GET_FROM_FRAME(MRFI_P_PAYLOAD(&wPtr->mrfiPkt), F_PORT_OS) == port)
+  if (sSFCount[loc] >= SANDF_CLIENT_DEPTH)
+  {
+    pFI = takeSandFHead(loc);
+  }
+  else if (Q_NIL != (i = sSFFree))
+  {
+    pFI     = &sSandFQ[i];
+    sSFFree = pFI->qNext;
+  }
+  else
+  {
+    uint8_t j, most = loc;
+
+    /* on a tie the client's own oldest frame goes */
+    for (j=0; j<NUM_STORE_AND_FWD_CLIENTS; ++j)
+    {
+      if (sSFCount[j] > sSFCount[most])
       {
-        /* Port matches. If the port of interest is a NWK applicaiton we're a
-         * match...the NWK applications are not connection-based. If it is a
-         * NWK application we need to check the source address for disambiguation.
-         * Also need to check source address if it's a raw frame lookup (S&F frame)
-         */
-        if (RCV_APP_LID == rcv->type)
-        {
-          if (SMPL_PORT_USER_BCAST == port)
-          {
-            /* guarantee a match... */
-            pAddr1 = pCInfo->peerAddr;
-          }
-          else
-          {
-            pAddr1 = MRFI_P_SRC_ADDR(&wPtr->mrfiPkt);
-          }
-        }
-#ifdef ACCESS_POINT
-        else if (RCV_RAW_POLL_FRAME == rcv->type)
-        {
-          pAddr1 = MRFI_P_DST_ADDR(&wPtr->mrfiPkt);
-        }
-#endif
+        most = j;
+      }
+    }
+    pFI = takeSandFHead(most);
+  }
+
+  memcpy(&pFI->mrfiPkt, frame, PKT_BYTES(frame));
+  pFI->qid      = loc;
+  pFI->qNext    = Q_NIL;
+  pFI->fi_usage = FI_INUSE_UNTIL_FWD;
+
+  i = pFI - sSandFQ;
+  if (Q_NIL == sSFTail[loc])
+  {
+    sSFHead[loc] = i;
+  }
+  else
+  {
+    sSandFQ[sSFTail[loc]].qNext = i;
+  }
+  sSFTail[loc] = i;
+  sSFCount[loc]++;
+
+  BSP_EXIT_CRITICAL_SECTION(intState);
+
+  return;
+}
 
-        addr12Compare = memcmp(pAddr1, pAddr2, NET_ADDR_SIZE);
-        if (  (RCV_NWK_PORT == rcv->type) ||
-              (!pAddr3 && !addr12Compare) ||
-              (pAddr3 && !memcmp(pAddr3, MRFI_P_SRC_ADDR(&wPtr->mrfiPkt), NET_ADDR_SIZE))
-           )
-        {
-          if (wPtr->orderStamp < oldest)
-          {
-            if (fPtr)
-            {
-              /* restore previous oldest one */
-              fPtr->fi_usage = uType;
-            }
-            oldest = wPtr->orderStamp;
-            fPtr   = wPtr;
-            continue;
-          }
-          else
-          {
-            /* not oldest. restore state */
-            wPtr->fi_usage = uType;
-          }
-        }
-        else
-        {
-          /* not a match. restore state */
-          wPtr->fi_usage = uType;
-        }
+/******************************************************************************
+ * @fn          nwk_QtakeSandF
+ *
+ * @brief       Take the oldest frame held for a polling client from the source
+ *              and for the port named in its poll. The frame is returned
+ *              in the FI_INUSE_TRANSITION state and must be sent or given back
+ *              with nwk_QfreeFrame().
+ *
+ * input parameters
+ * @param   client  - address of the polling client
+ * @param   port    - port named in the poll
+ * @param   pAddr3  - source address named in the poll
+ *
+ * output parameters
+ * @param   more    - set non-zero if another frame for the same source and
+ *                    port is still held after the one returned
+ *
+ * @return      Pointer to frame, or 0 if none is held.
+ */
+frameInfo_t *nwk_QtakeSandF(const uint8_t *client, uint8_t port, const uint8_t *pAddr3, uint8_t *more)
+{
+  uint8_t      loc, i, prev = Q_NIL;
+  frameInfo_t *pFI, *pFound = 0;
+  bspIState_t  intState;
+
+  *more = 0;
+  if (!nwk_isSandFClient((uint8_t *)client, &loc))
+  {
+    return (frameInfo_t *)0;
+  }
+
+  BSP_ENTER_CRITICAL_SECTION(intState);
+  for (i = sSFHead[loc]; i != Q_NIL; i = pFI->qNext)
+  {
+    pFI = &sSandFQ[i];
+    if ((GET_FROM_FRAME(MRFI_P_PAYLOAD(&pFI->mrfiPkt), F_PORT_OS) == port) &&
+        !memcmp(pAddr3, MRFI_P_SRC_ADDR(&pFI->mrfiPkt), NET_ADDR_SIZE))
+    {
+      if (pFound)
+      {
+        *more = 1;
+        break;
+      }
+      pFound = pFI;
+      if (Q_NIL == prev)
+      {
+        sSFHead[loc] = pFI->qNext;
       }
       else
       {
-        /* wrong port. restore state */
-        wPtr->fi_usage = uType;
+        sSandFQ[prev].qNext = pFI->qNext;
       }
+      if (sSFTail[loc] == i)
+      {
+        sSFTail[loc] = prev;
+      }
+      sSFCount[loc]--;
+      pFound->fi_usage = FI_INUSE_TRANSITION;
+      /* prev stays put. the search goes on from the next entry. */
+      continue;
     }
-    else
-    {
-      BSP_EXIT_CRITICAL_SECTION(intState);
-    }
+    prev = i;
   }
+  BSP_EXIT_CRITICAL_SECTION(intState);
 
-  return fPtr;
+  return pFound;
+}
+
+/******************************************************************************
+ * @fn          takeSandFHead
+ *
+ * @brief       Cast out the oldest frame held for a client to reuse its entry.
+ *              Caller protects the links. The client must have a frame held.
+ *
+ * input parameters
+ * @param   loc   - client index
+ *
+ * output parameters
+ *
+ * @return      Pointer to the entry, off all queues.
+ */
+static frameInfo_t *takeSandFHead(uint8_t loc)
+{
+  frameInfo_t *pFI = &sSandFQ[sSFHead[loc]];
+
+  if (Q_NIL == (sSFHead[loc] = pFI->qNext))
+  {
+    sSFTail[loc] = Q_NIL;
+  }
+  sSFCount[loc]--;
+
+  return pFI;
 }
+#endif  /* ACCESS_POINT */
 
 /******************************************************************************
  * @fn          nwk_getQ
@@ -43,11 +43,55 @@
 #define  USAGE_NORMAL  1
 #define  USAGE_FWD     2
 
+/* Received frames are kept in FIFO order on one queue per connection (link)
+ * and one per NWK application port.
+ */
+#define  QID_LINK(idx)     (idx)
+#define  QID_NWK(port)     (SYS_NUM_CONNECTIONS + (port) - 1)
+#define  NUM_RX_QUEUES     (SYS_NUM_CONNECTIONS + SMPL_PORT_NWK_MAX)
+
+/* Besides the SIZE_INFRAME_Q full size input slots there can be
+ * SIZE_INFRAME_SMALL_Q small ones, each holding a frame with at most
+ * SMALL_APP_PAYLOAD bytes of application payload. Beacons and NWK frames fit
+ * so the same RAM holds more of them.
+ */
+#ifndef SIZE_INFRAME_SMALL_Q
+#define  SIZE_INFRAME_SMALL_Q  0
+#endif
+#ifndef SMALL_APP_PAYLOAD
+#define  SMALL_APP_PAYLOAD     16
+#endif
+
+#ifdef ACCESS_POINT
+/* Frames held for store-and-forward clients have their own pool so they can't
+ * push live traffic out of the input frame queue. Each client has a FIFO queue
+ * in the pool of at most SANDF_CLIENT_DEPTH frames.
+ */
+#ifndef SIZE_SANDF_Q
+#define  SIZE_SANDF_Q        NUM_STORE_AND_FWD_CLIENTS
+#endif
+#ifndef SANDF_CLIENT_DEPTH
+#define  SANDF_CLIENT_DEPTH  SIZE_SANDF_Q
+#endif
+
+#if SIZE_SANDF_Q < 1 || SIZE_SANDF_Q > 254
+#error ERROR: SIZE_SANDF_Q must be from 1 to 254
+#endif
+#endif  /* ACCESS_POINT */
+
 /* prototypes */
 void              nwk_QInit(void);
 frameInfo_t *nwk_QfindSlot(uint8_t);
-void              nwk_QadjustOrder(uint8_t, uint8_t);
+frameInfo_t *nwk_QfindRxSlot(uint8_t);
+uint8_t           nwk_QslotFits(frameInfo_t *, uint8_t);
+void              nwk_QappendFrame(frameInfo_t *, uint8_t, uint8_t);
+void              nwk_QremoveFrame(frameInfo_t *);
+void              nwk_QfreeFrame(frameInfo_t *);
 frameInfo_t *nwk_QfindOldest(uint8_t, rcvContext_t *, uint8_t);
 frameInfo_t *nwk_getQ(uint8_t);
+#ifdef ACCESS_POINT
+void              nwk_QstoreSandF(mrfiPacket_t *, uint8_t);
+frameInfo_t *nwk_QtakeSandF(const uint8_t *, uint8_t, const uint8_t *, uint8_t *);
+#endif
 
 #endif  /* NWK_QMGMT_H */
@@ -48,6 +48,7 @@
 #include "mrfi.h"
 #include "nwk_globals.h"
 #include "nwk_freq.h"
+#include "nwk_QMgmt.h"
 
 /******************************************************************************
  * MACROS
@@ -81,10 +82,21 @@
  */
 static uint8_t sInit_done = 0;
 
+#if defined(APP_AUTO_ACK)
+/* set when the ack wait of a blocking SMPL_SendOpt() ends */
+static volatile uint8_t sAckWaitOver = 0;
+#endif
+
 /******************************************************************************
  * LOCAL FUNCTIONS
  */
-static uint8_t ioctlPreInitAccessIsOK(ioctlObject_t);
+static uint8_t      ioctlPreInitAccessIsOK(ioctlObject_t);
+static smplStatus_t startStack(uint8_t (*)(linkID_t));
+static smplStatus_t buildAppFrame(connInfo_t *, uint8_t *, uint8_t, txOpt_t, frameInfo_t **);
+static uint8_t      isHeldForPoll(frameInfo_t *);
+#if defined(APP_AUTO_ACK)
+static void         ackWaitOver(linkID_t, smplStatus_t);
+#endif
 
 /******************************************************************************
  * GLOBAL VARIABLES
@@ -119,45 +131,78 @@ smplStatus_t SMPL_Init(uint8_t (*f)(linkID_t))
 {
   smplStatus_t rc;
 
-  if (!sInit_done)
+  if ((rc=startStack(f)) != SMPL_SUCCESS)
   {
-    /* set up radio. */
-    MRFI_Init();
+    return rc;
+  }
 
-    /* initialize network */
-    if ((rc=nwk_nwkInit(f)) != SMPL_SUCCESS)
-    {
-      return rc;
-    }
+  /* Join. if no AP or Join fails that status is returned. */
+  rc = nwk_join();
 
-    MRFI_WakeUp();
-#if defined( FREQUENCY_AGILITY )
-    {
-      freqEntry_t chan;
+  return rc;
+}
 
-      chan.logicalChan = 0;
-      /* ok to set default channel explicitly now that MRFI initialized. */
-      nwk_setChannel(&chan);
-    }
-#endif
-    /* don't turn Rx on if we're an end device that isn't always on. */
-#if !defined( END_DEVICE )
-    MRFI_RxOn();
-#endif
+#ifdef NVOBJECT_SUPPORT
+/******************************************************************************
+ * @fn          SMPL_Resume
+ *
+ * @brief       Initialize the SimpliciTI stack from a saved connection context
+ *              instead of joining. The context is the image returned by an
+ *              IOCTL_OBJ_NVOBJ GET on an earlier run. A single Ping on the
+ *              supplied link confirms the peer is still there. If it isn't,
+ *              the restored context is dropped and SMPL_Init() can be called
+ *              to join as usual. Boot time only: the context is written over
+ *              the tables the Rx ISR works from. A running stack already has
+ *              its context and confirms the peer with a Ping (nwk_ping()).
+ *
+ * input parameters
+ * @param   f    - Pointer to call back function. See SMPL_Init().
+ * @param   nv   - saved NV object: version, length and pointer to the image
+ * @param   lid  - restored link on which to confirm the peer
+ *
+ * output parameters
+ *
+ * @return   Status of operation:
+ *             SMPL_SUCCESS
+ *             SMPL_BAD_PARAM  Saved image doesn't fit this build or the
+ *                             stack is already up.
+ *             SMPL_TIMEOUT    No Ping reply. Context dropped.
+ *             SMPL_NO_CHANNEL Only if Frequency Agility enabled. Context dropped.
+ */
+smplStatus_t SMPL_Resume(uint8_t (*f)(linkID_t), ioctlNVObj_t *nv, linkID_t lid)
+{
+  smplStatus_t rc;
+  bspIState_t  intState;
 
-#if defined( END_DEVICE )
-    /* All except End Devices are in promiscuous mode */
-    MRFI_SetRxAddrFilter((uint8_t *)nwk_getMyAddress());
-    MRFI_EnableRxAddrFilter();
-#endif
+  if (sInit_done)
+  {
+    return SMPL_BAD_PARAM;
   }
-  sInit_done = 1;
 
-  /* Join. if no AP or Join fails that status is returned. */
-  rc = nwk_join();
+  if ((rc=startStack(f)) != SMPL_SUCCESS)
+  {
+    return rc;
+  }
+
+  if ((rc=nwk_NVObj(IOCTL_ACT_SET, nv)) != SMPL_SUCCESS)
+  {
+    return rc;
+  }
+
+  if ((rc=nwk_ping(lid)) != SMPL_SUCCESS)
+  {
+    /* start over with an empty context. with the radio idle nothing new is
+     * received into the queues while they are rebuilt.
+     */
+    MRFI_RxIdle();
+    BSP_ENTER_CRITICAL_SECTION(intState);
+    nwk_nwkInit(f);
+    BSP_EXIT_CRITICAL_SECTION(intState);
+  }
 
   return rc;
 }
+#endif  /* NVOBJECT_SUPPORT */
 
 /******************************************************************************
  * @fn          SMPL_LinkListen
@@ -275,10 +320,7 @@ smplStatus_t SMPL_SendOpt(linkID_t lid, uint8_t *msg, uint8_t len, txOpt_t optio
   connInfo_t   *pCInfo     = nwk_getConnInfo(lid);
   smplStatus_t  rc         = SMPL_BAD_PARAM;
   uint8_t       radioState = MRFI_GetRadioState();
-  uint8_t       ackreq     = 0;
-#if defined(ACCESS_POINT)
-  uint8_t  loc;
-#endif
+  uint8_t       ackreq     = options & SMPL_TXOPTION_ACKREQ;
 
   /* we have the connection info for this Link ID. make sure it is valid. */
    if (!pCInfo || ((rc=nwk_checkConnInfo(pCInfo, CHK_TX)) != SMPL_SUCCESS))
@@ -286,109 +328,272 @@ smplStatus_t SMPL_SendOpt(linkID_t lid, uint8_t *msg, uint8_t len, txOpt_t optio
     return rc;
   }
 
-  /* parameter sanity check... */
-  if (!msg || (len > MAX_APP_PAYLOAD))
+#if defined(APP_AUTO_ACK)
+  /* the link has only one ack wait. an SMPL_SendAck() may still be running. */
+  if (ackreq && (SMPL_TX_PENDING == nwk_ackStatus(pCInfo)))
+  {
+    return SMPL_NOMEM;
+  }
+#endif
+
+  if ((rc=buildAppFrame(pCInfo, msg, len, options, &pFrameInfo)) != SMPL_SUCCESS)
   {
     return rc;
   }
 
-  /* Build an outgoing message frame destined for the port from the
-   * connection info using the destination address also from the
-   * connection info.
-   */
-  if (SMPL_TXOPTION_NONE == options)
+  if (isHeldForPoll(pFrameInfo))
   {
-    pFrameInfo = nwk_buildFrame(pCInfo->portTx, msg, len, pCInfo->hops2target);
+    return SMPL_SUCCESS;
   }
-#if defined(APP_AUTO_ACK)
-  else if (options & SMPL_TXOPTION_ACKREQ)
+
+  rc = nwk_sendFrame(pFrameInfo, MRFI_TX_TYPE_CCA);
+
+#if !defined(APP_AUTO_ACK)
+  /* save a little code space with this #if */
+  (void) ackreq;    /* keep compiler happy */
+  return rc;
+#else
+  /* we're done if the send failed or no ack requested. */
+  if (SMPL_SUCCESS != rc || !ackreq)
   {
-    if (SMPL_LINKID_USER_UUD != lid)
-    {
-      pFrameInfo = nwk_buildAckReqFrame(pCInfo->portTx, msg, len, pCInfo->hops2target, &pCInfo->ackTID);
-      ackreq     = 1;
-    }
-    else
-    {
-      /* can't request an ack on the UUD link ID */
-      return SMPL_BAD_PARAM;
-    }
+    return rc;
   }
+
+  /* the wait ends as soon as the ack arrives rather than after the full
+   * reply delay. the timeout clears the saved TID. the CPU sleeps on the
+   * timer meanwhile and the ISR that ends the wait wakes it.
+   */
+  NWK_CHECK_FOR_SETRX(radioState);
+  sAckWaitOver = 0;
+  nwk_ackWaitStart(pCInfo, ackWaitOver);
+  while (SMPL_TX_PENDING == (rc = nwk_ackStatus(pCInfo)))
+  {
+    BSP_TimerWait(BSP_TIMER_TICKS_PER_MS, &sAckWaitOver);
+  }
+  NWK_CHECK_FOR_RESTORE_STATE(radioState);
+
+  return rc;
 #endif  /* APP_AUTO_ACK */
-  else
+}
+
+#if defined(APP_AUTO_ACK)
+/******************************************************************************
+ * @fn          SMPL_SendAck
+ *
+ * @brief       Send a message with an ack request and return without waiting
+ *              for the ack. The Link ID is the handle for SMPL_AckStatus().
+ *              Each link can have one ack outstanding so sends to several
+ *              peers can wait for their acks together. The radio is left in
+ *              Rx so the acks can arrive.
+ *
+ * input parameters
+ * @param   lid     - Link ID (port) from application
+ * @param   msg     - pointer to message from app to be sent
+ * @param   len     - length of enclosed message
+ * @param   done    - called with the Link ID and SMPL_SUCCESS or SMPL_NO_ACK
+ *                    when the ack arrives or times out. called from the Rx or
+ *                    timer ISR thread. may be NULL.
+ *
+ * output parameters
+ *
+ * @return   Status of operation. On a failure the frame buffer is discarded
+ *           and the Send call must be redone by the app.
+ *             SMPL_SUCCESS      Sent. waiting for the ack.
+ *             SMPL_BAD_PARAM    No valid Connection Table entry for Link ID
+ *                               Data in Connection Table entry bad
+ *                               No message or message too long
+ *             SMPL_NOMEM        No room in output frame queue or an ack is
+ *                               still outstanding on the link
+ *             SMPL_TX_CCA_FAIL  CCA failure.
+ */
+smplStatus_t SMPL_SendAck(linkID_t lid, uint8_t *msg, uint8_t len, void (*done)(linkID_t, smplStatus_t))
+{
+  frameInfo_t  *pFrameInfo;
+  connInfo_t   *pCInfo = nwk_getConnInfo(lid);
+  smplStatus_t  rc     = SMPL_BAD_PARAM;
+
+  if (!pCInfo || ((rc=nwk_checkConnInfo(pCInfo, CHK_TX)) != SMPL_SUCCESS))
   {
-    return SMPL_BAD_PARAM;
+    return rc;
   }
 
-  if (!pFrameInfo)
+  if (SMPL_TX_PENDING == nwk_ackStatus(pCInfo))
   {
     return SMPL_NOMEM;
   }
-  memcpy(MRFI_P_DST_ADDR(&pFrameInfo->mrfiPkt), pCInfo->peerAddr, NET_ADDR_SIZE);
 
-#if defined(SMPL_SECURE)
+  if ((rc=buildAppFrame(pCInfo, msg, len, SMPL_TXOPTION_ACKREQ, &pFrameInfo)) != SMPL_SUCCESS)
   {
-    uint32_t *pUL = 0;
-
-    if (pCInfo->thisLinkID != SMPL_LINKID_USER_UUD)
-    {
-      pUL = &pCInfo->connTxCTR;
-    }
-    nwk_setSecureFrame(&pFrameInfo->mrfiPkt, len, pUL);
+    return rc;
   }
-#endif  /* SMPL_SECURE */
 
-#if defined(ACCESS_POINT)
-  /* If we are an AP trying to send to a polling device, don't do it.
-   * See if the target is a store-and-forward client.
-   */
-  if (nwk_isSandFClient(MRFI_P_DST_ADDR(&pFrameInfo->mrfiPkt), &loc))
+  if (isHeldForPoll(pFrameInfo))
   {
-     pFrameInfo->fi_usage = FI_INUSE_UNTIL_FWD;
-     return SMPL_SUCCESS;
+    /* no ack to wait for. reported as acked, same as SMPL_SendOpt(). */
+    pCInfo->ackTID = 0;
+  }
+  else if ((rc=nwk_sendFrame(pFrameInfo, MRFI_TX_TYPE_CCA)) != SMPL_SUCCESS)
+  {
+    pCInfo->ackTID = 0;
+    return rc;
   }
   else
-#endif  /* ACCESS_POINT */
   {
-    rc = nwk_sendFrame(pFrameInfo, MRFI_TX_TYPE_CCA);
+    MRFI_RxOn();
   }
 
-#if !defined(APP_AUTO_ACK)
-  /* save a little code space with this #if */
-  (void) ackreq;    /* keep compiler happy */
-  return rc;
-#else
-  /* we're done if the send failed or no ack requested. */
-  if (SMPL_SUCCESS != rc || !ackreq)
+  nwk_ackWaitStart(pCInfo, done);
+
+  return SMPL_SUCCESS;
+}
+
+/******************************************************************************
+ * @fn          SMPL_AckStatus
+ *
+ * @brief       Get the state of the last SMPL_SendAck() on a link.
+ *
+ * input parameters
+ * @param   lid     - Link ID used with SMPL_SendAck()
+ *
+ * output parameters
+ *
+ * @return   SMPL_TX_PENDING  still waiting for the ack
+ *           SMPL_SUCCESS     acked
+ *           SMPL_NO_ACK      no ack in time
+ *           SMPL_BAD_PARAM   bad Link ID or nothing sent on it
+ */
+smplStatus_t SMPL_AckStatus(linkID_t lid)
+{
+  connInfo_t *pCInfo = nwk_getConnInfo(lid);
+
+  return pCInfo ? nwk_ackStatus(pCInfo) : SMPL_BAD_PARAM;
+}
+#endif  /* APP_AUTO_ACK */
+
+/******************************************************************************
+ * @fn          SMPL_SendAsync
+ *
+ * @brief       Queue a message to a peer application and return without
+ *              waiting for it to go out. Queued frames are sent, oldest first,
+ *              by SMPL_TxService().
+ *
+ * input parameters
+ * @param   lid     - Link ID (port) from application
+ * @param   msg     - pointer to message from app to be sent. copied before
+ *                    the call returns.
+ * @param   len     - length of enclosed message
+ * @param   done    - called with the handle and the Tx status once the frame
+ *                    has gone out. called from the thread running
+ *                    SMPL_TxService(). With MRFI_TX_ASYNC defined it is
+ *                    called from the radio or timer interrupt that ends
+ *                    the send instead. may be NULL.
+ *
+ * output parameters
+ * @param   handle  - for SMPL_SendStatus(). 0 if an AP is holding the frame
+ *                    for a polling device, in which case there is no Tx to
+ *                    report.
+ *
+ * @return   Status of operation. On a failure the frame buffer is discarded
+ *           and the Send call must be redone by the app.
+ *             SMPL_SUCCESS      Frame queued
+ *             SMPL_BAD_PARAM    No valid Connection Table entry for Link ID
+ *                               Data in Connection Table entry bad
+ *                               No message or message too long
+ *             SMPL_NOMEM        No room in output frame queue
+ */
+smplStatus_t SMPL_SendAsync(linkID_t lid, uint8_t *msg, uint8_t len, void (*done)(uint8_t, smplStatus_t), uint8_t *handle)
+{
+  frameInfo_t  *pFrameInfo;
+  connInfo_t   *pCInfo = nwk_getConnInfo(lid);
+  smplStatus_t  rc     = SMPL_BAD_PARAM;
+
+  *handle = 0;
+
+  /* we have the connection info for this Link ID. make sure it is valid. */
+  if (!pCInfo || ((rc=nwk_checkConnInfo(pCInfo, CHK_TX)) != SMPL_SUCCESS))
   {
     return rc;
   }
 
-  NWK_CHECK_FOR_SETRX(radioState);
-  NWK_REPLY_DELAY();
-  NWK_CHECK_FOR_RESTORE_STATE(radioState);
-
+  if ((rc=buildAppFrame(pCInfo, msg, len, SMPL_TXOPTION_NONE, &pFrameInfo)) != SMPL_SUCCESS)
   {
-    bspIState_t intState;
+    return rc;
+  }
 
-    /* If the saved TID hasn't been reset then we never got the ack. */
-    BSP_ENTER_CRITICAL_SECTION(intState);
-    if (pCInfo->ackTID)
-    {
-      pCInfo->ackTID = 0;
-      rc = SMPL_NO_ACK;
-    }
-    BSP_EXIT_CRITICAL_SECTION(intState);
+  if (!isHeldForPoll(pFrameInfo))
+  {
+    *handle = nwk_queueFrame(pFrameInfo, MRFI_TX_TYPE_CCA, done);
   }
 
-  return rc;
-#endif  /* APP_AUTO_ACK */
+  return SMPL_SUCCESS;
+}
+
+/******************************************************************************
+ * @fn          SMPL_SendStatus
+ *
+ * @brief       Get the status of a frame queued by SMPL_SendAsync(). The
+ *              result is kept until the output queue slot is reused by a
+ *              later asynchronous send.
+ *
+ * input parameters
+ * @param   handle  - handle from SMPL_SendAsync()
+ *
+ * output parameters
+ *
+ * @return   Status of the send.
+ *             SMPL_TX_PENDING   Not sent yet
+ *             SMPL_SUCCESS      Sent
+ *             SMPL_TX_CCA_FAIL  CCA failure
+ *             SMPL_BAD_PARAM    Unknown or expired handle
+ */
+smplStatus_t SMPL_SendStatus(uint8_t handle)
+{
+  return nwk_txStatus(handle);
+}
+
+/******************************************************************************
+ * @fn          SMPL_TxPending
+ *
+ * @brief       Are frames from SMPL_SendAsync() waiting to go out?
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return   Number of frames waiting.
+ */
+uint8_t SMPL_TxPending(void)
+{
+  return nwk_txPending();
+}
+
+/******************************************************************************
+ * @fn          SMPL_TxService
+ *
+ * @brief       Send the frames queued by SMPL_SendAsync() and report the
+ *              results. Intended to be called from a periodic timer ISR. It
+ *              returns at once if a frame is already being sent, so the caller
+ *              may enable interrupts first to keep the UART and radio Rx
+ *              serviced while the frames go out. With MRFI_TX_ASYNC defined it
+ *              only starts the first frame and returns.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+void SMPL_TxService(void)
+{
+  nwk_drainTxQueue();
 }
 
 /**************************************************************************************
  * @fn          SMPL_Receive
  *
- * @brief       Receive a message from a peer application.
+ * @brief       Receive a message from a peer application. On a polling device
+ *              one poll can bring back several frames. Those still queued
+ *              are returned by the next calls without polling again.
  *
  * input parameters
  * @param   lid     - Link ID (port) from application
@@ -423,90 +628,422 @@ smplStatus_t SMPL_SendOpt(linkID_t lid, uint8_t *msg, uint8_t len, txOpt_t optio
  *              SMPL_NOMEM          No memory in output frame queue
  *              SMPL_NO_CHANNEL     Frequency Agility enabled and could not find channel
  */
-smplStatus_t SMPL_Receive(linkID_t lid, uint8_t *msg, uint8_t *len)
+smplStatus_t SMPL_Receive(linkID_t lid, uint8_t *msg, uint8_t *len)
+{
+  connInfo_t  *pCInfo = nwk_getConnInfo(lid);
+  smplStatus_t rc = SMPL_BAD_PARAM;
+  rcvContext_t rcv;
+
+  if (!pCInfo || ((rc=nwk_checkConnInfo(pCInfo, CHK_RX)) != SMPL_SUCCESS))
+  {
+    return rc;
+  }
+
+  rcv.type  = RCV_APP_LID;
+  rcv.t.lid = lid;
+
+#if defined(RX_POLLS)
+  /* the rest of the last batched poll reply may already be here */
+  if ((SMPL_SUCCESS == nwk_retrieveFrame(&rcv, msg, len, 0, 0)) && *len)
+  {
+    return SMPL_SUCCESS;
+  }
+
+  {
+    uint8_t numChans  = 1;
+#if defined(FREQUENCY_AGILITY)
+    freqEntry_t chans[NWK_FREQ_TBL_SIZE];
+    uint8_t     scannedB4 = 0;
+#endif
+
+    do
+    {
+      uint8_t radioState = MRFI_GetRadioState();
+
+      /* I'm polling. Do the poll to stimulate the sending of a frame. If the
+       * frame has application length of 0 it means there were no frames.  If
+       * no reply is received infer that the channel is changed. We then need
+       * to scan and then retry the poll on each channel returned.
+       */
+      if (SMPL_SUCCESS != (rc=nwk_poll(pCInfo->portRx, pCInfo->peerAddr)))
+      {
+        /* for some reason couldn't send the poll out. */
+        return rc;
+      }
+
+      /* do this before code block below which may reset it. */
+      numChans--;
+
+      /* Wait until there's a frame. if the len is 0 then return SMPL_NO_FRAME
+       * to the caller. In the poll case the AP always sends something.
+       */
+      NWK_CHECK_FOR_SETRX(radioState);
+      nwk_pollWait();
+      NWK_CHECK_FOR_RESTORE_STATE(radioState);
+
+      rc = nwk_retrieveFrame(&rcv, msg, len, 0, 0);
+
+#if defined(FREQUENCY_AGILITY)
+      if (SMPL_SUCCESS == rc)
+      {
+        /* we received something... */
+        return (*len) ? SMPL_SUCCESS : SMPL_NO_PAYLOAD;
+      }
+
+      /* No reply. scan for other channel(s) if we haven't already. Then set
+       * one and try again.
+       */
+      if (!scannedB4)
+      {
+        numChans  = nwk_scanForChannels(chans);
+        scannedB4 = 1;
+      }
+      if (numChans)
+      {
+        nwk_setChannel(&chans[numChans-1]);
+      }
+#else /*  FREQUENCY_AGILITY */
+      return (*len) ? rc : ((SMPL_SUCCESS == rc) ? SMPL_NO_PAYLOAD : SMPL_TIMEOUT);
+#endif
+    } while (numChans);
+  }
+
+#if defined(FREQUENCY_AGILITY)
+  return SMPL_NO_CHANNEL;
+#endif
+
+#else  /* RX_POLLS */
+  return nwk_retrieveFrame(&rcv, msg, len, 0, 0);
+#endif  /* RX_POLLS */
+}
+
+#if !defined(RX_POLLS)
+/**************************************************************************************
+ * @fn          SMPL_ReceiveView
+ *
+ * @brief       Receive a message from a peer application without copying it.
+ *              The view points at the payload in place in the input frame
+ *              queue. The frame is held, and can't be cast out by newer frames,
+ *              until SMPL_ReleaseView() is called, so release it promptly.
+ *              Not available on polling devices.
+ *
+ * input parameters
+ * @param   lid     - Link ID (port) from application
+ *
+ * output parameters
+ * @param   view    - populated with the payload pointer and length, the source
+ *                    address, hop count and Rx metrics of the received frame.
+ *
+ * @return    Status of operation.
+ *              SMPL_SUCCESS
+ *              SMPL_BAD_PARAM  No valid Connection Table entry for Link ID
+ *                              Data in Connection Table entry bad
+ *              SMPL_NO_FRAME   No frame received.
+ */
+smplStatus_t SMPL_ReceiveView(linkID_t lid, rxFrameView_t *view)
+{
+  connInfo_t  *pCInfo = nwk_getConnInfo(lid);
+  smplStatus_t rc = SMPL_BAD_PARAM;
+  rcvContext_t rcv;
+
+  view->frame = 0;
+  view->len   = 0;
+  if (!pCInfo || ((rc=nwk_checkConnInfo(pCInfo, CHK_RX)) != SMPL_SUCCESS))
+  {
+    return rc;
+  }
+
+  rcv.type  = RCV_APP_LID;
+  rcv.t.lid = lid;
+
+  return nwk_retrieveFrameView(&rcv, view);
+}
+
+/**************************************************************************************
+ * @fn          SMPL_ReleaseView
+ *
+ * @brief       Give back the frame held by a view from SMPL_ReceiveView(). The
+ *              view's pointers must not be used afterwards.
+ *
+ * input parameters
+ * @param   view    - view to release
+ *
+ * output parameters
+ *
+ * @return    void
+ */
+void SMPL_ReleaseView(rxFrameView_t *view)
+{
+  nwk_releaseFrameView(view);
+}
+
+/**************************************************************************************
+ * @fn          SMPL_ReceiveAny
+ *
+ * @brief       Receive the oldest message from any linked peer. For hub
+ *              devices with many links so they needn't try each Link ID in
+ *              turn. Frames on the unconnected user datagram link are not
+ *              included. Not available on polling devices.
+ *
+ * input parameters
+ *
+ * output parameters
+ * @param   lid     - Link ID the message was received on
+ * @param   msg     - pointer to where received message should be copied.
+ *                    Buffer should be of size == MAX_APP_PAYLOAD
+ * @param   len     - pointer to receive length of received message
+ *
+ * @return    Status of operation.
+ *              SMPL_SUCCESS
+ *              SMPL_NO_FRAME   No frame received.
+ */
+smplStatus_t SMPL_ReceiveAny(linkID_t *lid, uint8_t *msg, uint8_t *len)
+{
+  rcvContext_t rcv;
+  smplStatus_t rc;
+
+  rcv.type  = RCV_APP_ANY;
+  rcv.t.lid = 0;
+
+  rc   = nwk_retrieveFrame(&rcv, msg, len, 0, 0);
+  *lid = rcv.t.lid;
+
+  return rc;
+}
+
+/**************************************************************************************
+ * @fn          SMPL_ReceiveAnyView
+ *
+ * @brief       SMPL_ReceiveAny() without copying the message. See
+ *              SMPL_ReceiveView(). The frame is held until SMPL_ReleaseView()
+ *              is called.
+ *
+ * input parameters
+ *
+ * output parameters
+ * @param   lid     - Link ID the message was received on
+ * @param   view    - populated as by SMPL_ReceiveView()
+ *
+ * @return    Status of operation.
+ *              SMPL_SUCCESS
+ *              SMPL_NO_FRAME   No frame received.
+ */
+smplStatus_t SMPL_ReceiveAnyView(linkID_t *lid, rxFrameView_t *view)
+{
+  rcvContext_t rcv;
+  smplStatus_t rc;
+
+  rcv.type  = RCV_APP_ANY;
+  rcv.t.lid = 0;
+
+  rc   = nwk_retrieveFrameView(&rcv, view);
+  *lid = rcv.t.lid;
+
+  return rc;
+}
+#endif  /* !RX_POLLS */
+
+#if !defined(SMPL_SECURE)
+/**************************************************************************************
+ * @fn          SMPL_SetRxFastPath
+ *
+ * @brief       Have a function see each frame on a link in the Rx ISR, before
+ *              it is queued, with the payload in place and the radio Rx
+ *              timestamp. For frames whose handling can't wait for the main
+ *              loop, such as time beacons. The hook may consume the frame or
+ *              leave it to be queued for SMPL_Receive() as usual. It runs in
+ *              interrupt context so it must be short. The Rx callback from
+ *              SMPL_Init() is not called for consumed frames. Not available
+ *              with SMPL_SECURE.
+ *
+ * input parameters
+ * @param   lid     - Link ID, including SMPL_LINKID_USER_UUD
+ * @param   pF      - hook, or NULL to remove the link's hook
+ *
+ * output parameters
+ *
+ * @return    Status of operation.
+ *              SMPL_SUCCESS
+ *              SMPL_BAD_PARAM  No valid Connection Table entry for Link ID
+ *              SMPL_NOMEM      No room for another hook
+ */
+smplStatus_t SMPL_SetRxFastPath(linkID_t lid, rxFastPath_t pF)
+{
+  if (!nwk_getConnInfo(lid))
+  {
+    return SMPL_BAD_PARAM;
+  }
+
+  return nwk_setFastPath(lid, pF);
+}
+#endif  /* !SMPL_SECURE */
+
+/******************************************************************************
+ * @fn          SMPL_JoinGroup
+ *
+ * @brief       Join a multicast group. Frames sent to the group with
+ *              SMPL_SendGroup() are then received on the UUD link
+ *              (SMPL_LINKID_USER_UUD). Membership is not saved with the
+ *              connection context so it has to be set again after a reset.
+ *
+ * input parameters
+ * @param   group   - group number, less than NWK_GROUPS
+ *
+ * output parameters
+ *
+ * @return    Status of operation.
+ *              SMPL_SUCCESS
+ *              SMPL_BAD_PARAM  No such group
+ */
+smplStatus_t SMPL_JoinGroup(uint8_t group)
+{
+  if (group >= NWK_GROUPS)
+  {
+    return SMPL_BAD_PARAM;
+  }
+
+  nwk_setGroup(group, 1);
+
+  return SMPL_SUCCESS;
+}
+
+/******************************************************************************
+ * @fn          SMPL_LeaveGroup
+ *
+ * @brief       Leave a multicast group.
+ *
+ * input parameters
+ * @param   group   - group number, less than NWK_GROUPS
+ *
+ * output parameters
+ *
+ * @return    Status of operation.
+ *              SMPL_SUCCESS
+ *              SMPL_BAD_PARAM  No such group
+ */
+smplStatus_t SMPL_LeaveGroup(uint8_t group)
+{
+  if (group >= NWK_GROUPS)
+  {
+    return SMPL_BAD_PARAM;
+  }
+
+  nwk_setGroup(group, 0);
+
+  return SMPL_SUCCESS;
+}
+
+/******************************************************************************
+ * @fn          SMPL_SendGroup
+ *
+ * @brief       Send a message to every member of a multicast group. The frame
+ *              is a UUD frame with the group address as destination. APs and
+ *              REs replay it once. No ack can be requested. The sender need
+ *              not be a member and does not receive its own frame.
+ *
+ * input parameters
+ * @param   group   - group number, less than NWK_GROUPS
+ * @param   msg     - pointer to message from app to be sent
+ * @param   len     - length of enclosed message
+ *
+ * output parameters
+ *
+ * @return   Status of operation. On a failure the frame buffer is discarded
+ *           and the Send call must be redone by the app.
+ *             SMPL_SUCCESS
+ *             SMPL_BAD_PARAM    No such group, no message or message too long
+ *             SMPL_NOMEM        No room in output frame queue
+ *             SMPL_TX_CCA_FAIL  CCA failure.
+ */
+smplStatus_t SMPL_SendGroup(uint8_t group, uint8_t *msg, uint8_t len)
 {
-  connInfo_t  *pCInfo = nwk_getConnInfo(lid);
-  smplStatus_t rc = SMPL_BAD_PARAM;
-  rcvContext_t rcv;
+  frameInfo_t  *pFrameInfo;
+  connInfo_t   *pCInfo = nwk_getConnInfo(SMPL_LINKID_USER_UUD);
+  smplStatus_t  rc;
 
-  if (!pCInfo || ((rc=nwk_checkConnInfo(pCInfo, CHK_RX)) != SMPL_SUCCESS))
+  if (!pCInfo || (group >= NWK_GROUPS))
   {
-    return rc;
+    return SMPL_BAD_PARAM;
   }
 
-  rcv.type  = RCV_APP_LID;
-  rcv.t.lid = lid;
-
-#if defined(RX_POLLS)
+  if ((rc=buildAppFrame(pCInfo, msg, len, SMPL_TXOPTION_NONE, &pFrameInfo)) != SMPL_SUCCESS)
   {
-    uint8_t numChans  = 1;
-#if defined(FREQUENCY_AGILITY)
-    freqEntry_t chans[NWK_FREQ_TBL_SIZE];
-    uint8_t     scannedB4 = 0;
-#endif
-
-    do
-    {
-      uint8_t radioState = MRFI_GetRadioState();
-
-      /* I'm polling. Do the poll to stimulate the sending of a frame. If the
-       * frame has application length of 0 it means there were no frames.  If
-       * no reply is received infer that the channel is changed. We then need
-       * to scan and then retry the poll on each channel returned.
-       */
-      if (SMPL_SUCCESS != (rc=nwk_poll(pCInfo->portRx, pCInfo->peerAddr)))
-      {
-        /* for some reason couldn't send the poll out. */
-        return rc;
-      }
-
-      /* do this before code block below which may reset it. */
-      numChans--;
-
-      /* Wait until there's a frame. if the len is 0 then return SMPL_NO_FRAME
-       * to the caller. In the poll case the AP always sends something.
-       */
-      NWK_CHECK_FOR_SETRX(radioState);
-      NWK_REPLY_DELAY();
-      NWK_CHECK_FOR_RESTORE_STATE(radioState);
+    return rc;
+  }
 
-      /* TODO: deal with pending */
-      rc = nwk_retrieveFrame(&rcv, msg, len, 0, 0);
+  /* the UUD header is addressed to broadcast. the group goes in the last byte. */
+  MRFI_P_DST_ADDR(&pFrameInfo->mrfiPkt)[NWK_GROUP_ADDR_OS] = group;
 
-#if defined(FREQUENCY_AGILITY)
-      if (SMPL_SUCCESS == rc)
-      {
-        /* we received something... */
-        return (*len) ? SMPL_SUCCESS : SMPL_NO_PAYLOAD;
-      }
+  return nwk_sendFrame(pFrameInfo, MRFI_TX_TYPE_CCA);
+}
 
-      /* No reply. scan for other channel(s) if we haven't already. Then set
-       * one and try again.
-       */
-      if (!scannedB4)
-      {
-        numChans  = nwk_scanForChannels(chans);
-        scannedB4 = 1;
-      }
-      if (numChans)
-      {
-        nwk_setChannel(&chans[numChans-1]);
-      }
-#else /*  FREQUENCY_AGILITY */
-      return (*len) ? rc : ((SMPL_SUCCESS == rc) ? SMPL_NO_PAYLOAD : SMPL_TIMEOUT);
-#endif
-    } while (numChans);
-  }
 
-#if defined(FREQUENCY_AGILITY)
-  return SMPL_NO_CHANNEL;
-#endif
+#ifdef MAX_BULK_PAYLOAD
+/**************************************************************************************
+ * @fn          SMPL_BulkSend
+ *
+ * @brief       Send a payload larger than MAX_APP_PAYLOAD (up to MAX_BULK_PAYLOAD)
+ *              to a peer using the NWK Bulk transfer application. Synchronous call.
+ *              The payload is segmented and sent with a sliding window. Only the
+ *              segments the peer reports missing are resent.
+ *
+ * input parameters
+ * @param   lid     - Link ID of the peer
+ * @param   data    - payload
+ * @param   len     - length of payload
+ *
+ * output parameters
+ *
+ * @return   Status of operation.
+ *             SMPL_SUCCESS     Peer has the whole payload.
+ *             SMPL_BAD_PARAM   Bad Link ID, no payload or payload too long.
+ *             SMPL_NOMEM       Peer is holding another transfer.
+ *             SMPL_TIMEOUT     No reply from peer.
+ */
+smplStatus_t SMPL_BulkSend(linkID_t lid, const uint8_t *data, uint16_t len)
+{
+  return nwk_bulkSend(lid, data, len);
+}
 
-#else  /* RX_POLLS */
-  return nwk_retrieveFrame(&rcv, msg, len, 0, 0);
-#endif  /* RX_POLLS */
+/**************************************************************************************
+ * @fn          SMPL_BulkReceive
+ *
+ * @brief       Get a payload reassembled by the NWK Bulk transfer application. The
+ *              payload is not copied. It must be given back with SMPL_BulkRelease(),
+ *              and no further transfer is accepted until it is.
+ *
+ * input parameters
+ *
+ * output parameters
+ * @param   srcAddr - sender's address. may be NULL.
+ * @param   data    - pointer to payload
+ * @param   len     - length of payload
+ *
+ * @return   Status of operation.
+ *             SMPL_SUCCESS
+ *             SMPL_NO_FRAME    No transfer complete.
+ */
+smplStatus_t SMPL_BulkReceive(addr_t *srcAddr, const uint8_t **data, uint16_t *len)
+{
+  return nwk_bulkReceive(srcAddr, data, len);
 }
 
+/**************************************************************************************
+ * @fn          SMPL_BulkRelease
+ *
+ * @brief       Give back the payload from SMPL_BulkReceive().
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+void SMPL_BulkRelease(void)
+{
+  nwk_bulkRelease();
+}
+#endif  /* MAX_BULK_PAYLOAD */
 
 /******************************************************************************
  * @fn          SMPL_Link
@@ -815,6 +1352,139 @@ smplStatus_t SMPL_Ioctl(ioctlObject_t object, ioctlAction_t action, void *val)
   return rc;
 }
 
+/******************************************************************************
+ * @fn          buildAppFrame
+ *
+ * @brief       Build an outgoing user application frame for a connection.
+ *
+ * input parameters
+ * @param   pCInfo  - connection, already checked with nwk_checkConnInfo()
+ * @param   msg     - pointer to message from app to be sent
+ * @param   len     - length of enclosed message
+ * @param   options - Transmit options (bit map)
+ *
+ * output parameters
+ * @param   ppFI    - frame built in the output queue
+ *
+ * @return   Status of operation.
+ *             SMPL_SUCCESS
+ *             SMPL_BAD_PARAM    No message, message too long or bad options
+ *             SMPL_NOMEM        No room in output frame queue
+ */
+static smplStatus_t buildAppFrame(connInfo_t *pCInfo, uint8_t *msg, uint8_t len, txOpt_t options, frameInfo_t **ppFI)
+{
+  frameInfo_t  *pFrameInfo;
+
+  /* parameter sanity check... */
+  if (!msg || (len > MAX_APP_PAYLOAD))
+  {
+    return SMPL_BAD_PARAM;
+  }
+
+  /* Build an outgoing message frame from the connection's cached header.
+   * destination address and port come from the connection info.
+   */
+  if (SMPL_TXOPTION_NONE == options)
+  {
+    pFrameInfo = nwk_buildConnFrame(pCInfo, msg, len, NULL);
+  }
+#if defined(APP_AUTO_ACK)
+  else if (options & SMPL_TXOPTION_ACKREQ)
+  {
+    if (SMPL_LINKID_USER_UUD != pCInfo->thisLinkID)
+    {
+      pFrameInfo = nwk_buildConnFrame(pCInfo, msg, len, &pCInfo->ackTID);
+    }
+    else
+    {
+      /* can't request an ack on the UUD link ID */
+      return SMPL_BAD_PARAM;
+    }
+  }
+#endif  /* APP_AUTO_ACK */
+  else
+  {
+    return SMPL_BAD_PARAM;
+  }
+
+  if (!pFrameInfo)
+  {
+    return SMPL_NOMEM;
+  }
+
+#if defined(SMPL_SECURE)
+  {
+    uint32_t *pUL = 0;
+
+    if (pCInfo->thisLinkID != SMPL_LINKID_USER_UUD)
+    {
+      pUL = &pCInfo->connTxCTR;
+    }
+    nwk_setSecureFrame(&pFrameInfo->mrfiPkt, len, pUL);
+  }
+#endif  /* SMPL_SECURE */
+
+  *ppFI = pFrameInfo;
+
+  return SMPL_SUCCESS;
+}
+
+/******************************************************************************
+ * @fn          isHeldForPoll
+ *
+ * @brief       If we are an AP trying to send to a polling device, don't do
+ *              it. If the target is a store-and-forward client copy the frame
+ *              to the store-and-forward pool until the client polls for it.
+ *              The output queue entry is left free.
+ *
+ * input parameters
+ * @param   pFrameInfo  - frame built by buildAppFrame()
+ *
+ * output parameters
+ *
+ * @return   Non-zero if the frame is being held. It must not be sent.
+ */
+static uint8_t isHeldForPoll(frameInfo_t *pFrameInfo)
+{
+#if defined(ACCESS_POINT)
+  uint8_t  loc;
+
+  if (nwk_isSandFClient(MRFI_P_DST_ADDR(&pFrameInfo->mrfiPkt), &loc))
+  {
+     nwk_QstoreSandF(&pFrameInfo->mrfiPkt, loc);
+     return 1;
+  }
+#else
+  (void) pFrameInfo;
+#endif  /* ACCESS_POINT */
+
+  return 0;
+}
+
+#if defined(APP_AUTO_ACK)
+/******************************************************************************
+ * @fn          ackWaitOver
+ *
+ * @brief       The ack wait of a blocking SMPL_SendOpt() ended. Ends its sleep.
+ *              Runs in the Rx or timer ISR thread.
+ *
+ * input parameters
+ * @param   lid     - Link ID the wait was on
+ * @param   status  - SMPL_SUCCESS or SMPL_NO_ACK
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+static void ackWaitOver(linkID_t lid, smplStatus_t status)
+{
+  (void) lid;
+  (void) status;
+
+  sAckWaitOver = 1;
+}
+#endif  /* APP_AUTO_ACK */
+
 /******************************************************************************
  * @fn          ioctlPreInitAccessIsOK
  *
@@ -854,3 +1524,57 @@ static uint8_t ioctlPreInitAccessIsOK(ioctlObject_t object)
 
   return rc;
 }
+
+/******************************************************************************
+ * @fn          startStack
+ *
+ * @brief       Bring up the radio and the NWK layer the first time through.
+ *              Later calls do nothing.
+ *
+ * input parameters
+ * @param   f  - Pointer to call back function. See SMPL_Init().
+ *
+ * output parameters
+ *
+ * @return   Status of operation.
+ */
+static smplStatus_t startStack(uint8_t (*f)(linkID_t))
+{
+  smplStatus_t rc;
+
+  if (!sInit_done)
+  {
+    /* set up radio. */
+    MRFI_Init();
+
+    /* initialize network */
+    if ((rc=nwk_nwkInit(f)) != SMPL_SUCCESS)
+    {
+      return rc;
+    }
+
+    MRFI_WakeUp();
+#if defined( FREQUENCY_AGILITY )
+    {
+      freqEntry_t chan;
+
+      chan.logicalChan = 0;
+      /* ok to set default channel explicitly now that MRFI initialized. */
+      nwk_setChannel(&chan);
+    }
+#endif
+    /* don't turn Rx on if we're an end device that isn't always on. */
+#if !defined( END_DEVICE )
+    MRFI_RxOn();
+#endif
+
+#if defined( END_DEVICE )
+    /* All except End Devices are in promiscuous mode */
+    MRFI_SetRxAddrFilter((uint8_t *)nwk_getMyAddress());
+    MRFI_EnableRxAddrFilter();
+#endif
+  }
+  sInit_done = 1;
+
+  return SMPL_SUCCESS;
+}
@@ -41,12 +41,40 @@
 #define  SMPL_TXOPTION_ACKREQ     ((txOpt_t)0x01)
 
 smplStatus_t SMPL_Init(uint8_t (*)(linkID_t));
+#ifdef NVOBJECT_SUPPORT
+smplStatus_t SMPL_Resume(uint8_t (*)(linkID_t), ioctlNVObj_t *, linkID_t);
+#endif
 smplStatus_t SMPL_Link(linkID_t *);
 smplStatus_t SMPL_LinkListen(linkID_t *);
 smplStatus_t SMPL_Send(linkID_t lid, uint8_t *msg, uint8_t len);
 smplStatus_t SMPL_SendOpt(linkID_t lid, uint8_t *msg, uint8_t len, txOpt_t);
+smplStatus_t SMPL_SendAsync(linkID_t lid, uint8_t *msg, uint8_t len, void (*)(uint8_t, smplStatus_t), uint8_t *);
+smplStatus_t SMPL_SendStatus(uint8_t);
+uint8_t      SMPL_TxPending(void);
+void         SMPL_TxService(void);
+#if defined(APP_AUTO_ACK)
+smplStatus_t SMPL_SendAck(linkID_t lid, uint8_t *msg, uint8_t len, void (*)(linkID_t, smplStatus_t));
+smplStatus_t SMPL_AckStatus(linkID_t lid);
+#endif
 smplStatus_t SMPL_Receive(linkID_t lid, uint8_t *msg, uint8_t *len);
+#if !defined(RX_POLLS)
+smplStatus_t SMPL_ReceiveView(linkID_t lid, rxFrameView_t *view);
+void         SMPL_ReleaseView(rxFrameView_t *view);
+smplStatus_t SMPL_ReceiveAny(linkID_t *lid, uint8_t *msg, uint8_t *len);
+smplStatus_t SMPL_ReceiveAnyView(linkID_t *lid, rxFrameView_t *view);
+#endif
+#if !defined(SMPL_SECURE)
+smplStatus_t SMPL_SetRxFastPath(linkID_t lid, rxFastPath_t);
+#endif
+smplStatus_t SMPL_JoinGroup(uint8_t group);
+smplStatus_t SMPL_LeaveGroup(uint8_t group);
+smplStatus_t SMPL_SendGroup(uint8_t group, uint8_t *msg, uint8_t len);
 smplStatus_t SMPL_Ioctl(ioctlObject_t, ioctlAction_t, void *);
+#ifdef MAX_BULK_PAYLOAD
+smplStatus_t SMPL_BulkSend(linkID_t, const uint8_t *, uint16_t);
+smplStatus_t SMPL_BulkReceive(addr_t *, const uint8_t **, uint16_t *);
+void         SMPL_BulkRelease(void);
+#endif  /* MAX_BULK_PAYLOAD */
 #ifdef EXTENDED_API
 smplStatus_t SMPL_Ping(linkID_t);
 smplStatus_t SMPL_Unlink(linkID_t);
@@ -48,6 +48,7 @@
 #include "nwk_join.h"
 #include "nwk_security.h"
 #include "nwk_ioctl.h"
+#include "nwk_bulk.h"
 
 #endif
 
@@ -57,10 +57,64 @@
 /******************************************************************************
  * CONSTANTS AND DEFINES
  */
+#if !defined(END_DEVICE)
+/* Relays remember the last few frames they replayed, by source address and
+ * transaction ID. A replay waits a random 1 to RELAY_JITTER_MS ms so relays
+ * that heard the same frame don't transmit together. It is dropped if
+ * RELAY_SUPPRESS_COUNT copies of the frame have been heard by then. At most
+ * RELAY_PENDING frames wait. More are replayed at once.
+ */
+#ifndef RELAY_CACHE_SIZE
+#define RELAY_CACHE_SIZE      4
+#endif
+#ifndef RELAY_PENDING
+#define RELAY_PENDING         2
+#endif
+#define RELAY_JITTER_MS       8
+#define RELAY_SUPPRESS_COUNT  3
+
+#if RELAY_PENDING >= RELAY_CACHE_SIZE
+#error ERROR: RELAY_PENDING must be less than RELAY_CACHE_SIZE
+#endif
+#endif  /* !END_DEVICE */
+
+/* number of links that can have an Rx fast path hook */
+#ifndef RX_FASTPATH_HOOKS
+#define RX_FASTPATH_HOOKS     2
+#endif
 
 /******************************************************************************
  * TYPEDEFS
  */
+#if !defined(SMPL_SECURE)
+/* an Rx fast path hook and the link it serves */
+typedef struct
+{
+  linkID_t      lid;
+  rxFastPath_t  pF;
+} fastPath_t;
+#endif
+
+#if !defined(END_DEVICE)
+/* a frame heard by a relay. pFI is set while its replay is waiting. */
+typedef struct
+{
+  uint8_t      addr[NET_ADDR_SIZE];
+  uint8_t      tid;
+  uint8_t      heard;
+  uint16_t     due;
+  frameInfo_t *pFI;
+} relaySeen_t;
+#endif  /* !END_DEVICE */
+
+/* an asynchronous send. kept for the output queue slot that holds its frame */
+typedef struct
+{
+  uint8_t        handle;
+  uint8_t        txOption;
+  smplStatus_t   status;
+  void         (*done)(uint8_t, smplStatus_t);
+} txJob_t;
 
 /******************************************************************************
  * LOCAL VARIABLES
@@ -73,7 +127,8 @@ static  fhStatus_t (* const func[])(mrfiPacket_t *) = { nwk_processPing,
                                                         nwk_processJoin,
                                                         nwk_processSecurity,
                                                         nwk_processFreq,
-                                                        nwk_processMgmt
+                                                        nwk_processMgmt,
+                                                        nwk_processBulk
                                                       };
 #endif  /* SIZE_INFRAME_Q > 0 */
 
@@ -83,23 +138,92 @@ static addr_t const *sMyAddr = NULL;
 
 static uint8_t  sMyRxType = 0, sMyTxType = 0;
 
+#ifdef MRFI_TIMESTAMP
+/* receive timestamp of the frame most recently handed to the application */
+static uint32_t sRxTimestamp = 0;
+#endif
+
 #if !defined(RX_POLLS)
 static uint8_t  (*spCallback)(linkID_t) = NULL;
 #endif
 
+#if !defined(SMPL_SECURE)
+/* Rx fast path hooks. unused entries have a NULL function. */
+static fastPath_t sFastPath[RX_FASTPATH_HOOKS];
+#endif
+
+#if (SIZE_INFRAME_Q > 0) && defined(MRFI_RX_IN_PLACE)
+/* input queue slot the radio is reading the current frame into */
+static frameInfo_t *sRxSlot = NULL;
+#endif
+
+/* asynchronous sends. jobs are indexed by output queue slot. sTxOrder holds
+ * the slots of the frames waiting to go out, oldest first.
+ */
+static txJob_t          sTxJob[SIZE_OUTFRAME_Q];
+static uint8_t          sTxOrder[SIZE_OUTFRAME_Q];
+static uint8_t          sTxHead = 0, sTxCount = 0;
+static uint8_t          sTxHandle = 0;
+
+/* set while the radio is busy sending a frame */
+static volatile uint8_t sTxBusy = 0;
+
+#ifdef MRFI_TX_ASYNC
+/* nwk_sendFrame() calls waiting for or using the radio. The queue isn't
+ * started while there are any so they don't wait behind it.
+ */
+static volatile uint8_t sTxHold = 0;
+#endif
+
+#if !defined(END_DEVICE)
+/* recently relayed frames, the next entry to reuse, the number of replays
+ * waiting, and counts of replays sent and suppressed.
+ */
+static relaySeen_t      sRelaySeen[RELAY_CACHE_SIZE];
+static uint8_t          sRelayNext = 0;
+static uint8_t          sRelayWaiting = 0;
+static uint16_t         sRelaySent = 0, sRelaySuppressed = 0;
+static bspTimer_t       sRelayTimer;
+#endif
+
+/* cached header of each connection's application frames: destination and
+ * source addresses, port byte and device info byte, laid out as they are in
+ * the frame. A zero port byte means the template hasn't been built. No
+ * connection sends to port 0.
+ */
+#define  HDR_TMPL_PORT_OS   (2*NET_ADDR_SIZE + F_PORT_OS)
+#define  HDR_TMPL_SIZE      (2*NET_ADDR_SIZE + F_TRACTID_OS)
+
+#if (__mrfi_SRC_ADDR_OFS__ != __mrfi_DST_ADDR_OFS__ + NET_ADDR_SIZE) || \
+    (__mrfi_PAYLOAD_OFS__ != __mrfi_SRC_ADDR_OFS__ + NET_ADDR_SIZE)
+#error ERROR: Header templates need the addresses and NWK header to be contiguous
+#endif
+
+static uint8_t          sHdrTmpl[SYS_NUM_CONNECTIONS][HDR_TMPL_SIZE];
+
+/* multicast groups joined. one bit per group. */
+static uint8_t          sGroups[(NWK_GROUPS+7)/8];
+
 /******************************************************************************
  * LOCAL FUNCTIONS
  */
+static smplStatus_t txFrame(frameInfo_t *, uint8_t);
+#ifdef MRFI_TX_ASYNC
+static void         txDone(uint8_t);
+#endif
+static void         buildHdrTemplate(connInfo_t *, uint8_t *);
+#if !defined(END_DEVICE)
+static void         relayTimerArm(void);
+static void         relayTimeout(void);
+#endif
 
 #if SIZE_INFRAME_Q > 0
 /* local helper functions for Rx devices */
-static void  dispatchFrame(frameInfo_t *);
-#if !defined(END_DEVICE)
-#if defined(ACCESS_POINT)
-/* only Access Points need to worry about duplicate S&F frames */
-uint8_t  isDupSandFFrame(mrfiPacket_t *);
-#endif /* ACCESS_POINT */
-#endif  /* !END_DEVICE */
+static void    dispatchFrame(frameInfo_t *);
+static uint8_t linkQueue(linkID_t);
+static uint8_t fastPath(frameInfo_t *, linkID_t);
+static uint8_t isGroupAddr(const uint8_t *);
+static uint8_t isGroupMember(const uint8_t *);
 #endif  /* SIZE_INFRAME_Q > 0 */
 
 /******************************************************************************
@@ -155,6 +279,19 @@ void nwk_frameInit(uint8_t (*pF)(linkID_t))
 
   sMyAddr = nwk_getMyAddress();
 
+#if !defined(SMPL_SECURE)
+  memset(sFastPath, 0, sizeof(sFastPath));
+#endif
+
+  nwk_dropHdrTemplate(NULL);
+
+  /* the queues are about to be rebuilt: nothing may still point into them */
+#if (SIZE_INFRAME_Q > 0) && defined(MRFI_RX_IN_PLACE)
+  sRxSlot = NULL;
+#endif
+  sTxHead  = 0;
+  sTxCount = 0;
+
   while (!(sTRACTID=MRFI_RandomByte())) ;
 
   return;
@@ -254,7 +391,154 @@ frameInfo_t *nwk_buildAckReqFrame(uint8_t port, uint8_t *msg, uint8_t len, uint8
 }
 #endif  /* APP_AUTO_ACK */
 
+/******************************************************************************
+ * @fn          nwk_buildConnFrame
+ *
+ * @brief       Builds an application frame for a connection. The header is
+ *              copied in one piece from the connection's cached template and
+ *              only the transaction ID (and the ack request bit) are stamped
+ *              per frame. The template is built on the connection's first
+ *              frame.
+ *
+ * input parameters
+ * @param   pCInfo  - connection the frame is sent on
+ * @param   msg     - pointer to message from app to be sent
+ * @param   len     - length of enclosed message
+ * @param   tid     - if not NULL the frame requests an ack and the TID to
+ *                    match the reply is saved here.
+ *
+ * output parameters
+ *
+ * @return   pointer to frameInfo_t structure created. NULL if there is
+ *           no room in output queue.
+ */
+frameInfo_t *nwk_buildConnFrame(connInfo_t *pCInfo, uint8_t *msg, uint8_t len, volatile uint8_t *tid)
+{
+  frameInfo_t *fInfoPtr;
+  uint8_t     *pTmpl = sHdrTmpl[nwk_getConnIndex(pCInfo)];
+  uint8_t     *pNwk;
+
+  if (!(fInfoPtr=nwk_QfindSlot(OUTQ)))
+  {
+    return (frameInfo_t *)NULL;
+  }
+
+  if (!pTmpl[HDR_TMPL_PORT_OS])
+  {
+    buildHdrTemplate(pCInfo, pTmpl);
+  }
+
+  MRFI_SET_PAYLOAD_LEN(&fInfoPtr->mrfiPkt, len+F_APP_PAYLOAD_OS);
+  memcpy(MRFI_P_DST_ADDR(&fInfoPtr->mrfiPkt), pTmpl, HDR_TMPL_SIZE);
+
+  pNwk = MRFI_P_PAYLOAD(&fInfoPtr->mrfiPkt);
+  pNwk[F_TRACTID_OS] = sTRACTID;
+  while (!(++sTRACTID)) ;  /* transaction ID can't be 0 */
+
+  if (tid)
+  {
+    *tid = pNwk[F_TRACTID_OS];
+    PUT_INTO_FRAME(pNwk, F_ACK_REQ, F_ACK_REQ_TYPE);
+  }
+
+  memcpy(pNwk+F_APP_PAYLOAD_OS, msg, len);
+
+  return fInfoPtr;
+}
+
+/******************************************************************************
+ * @fn          nwk_dropHdrTemplate
+ *
+ * @brief       Forget the cached header template of a connection so it is
+ *              rebuilt on the next frame. Call whenever the peer address,
+ *              remote port or hop count of a connection may have changed.
+ *
+ * input parameters
+ * @param   pCInfo  - connection. NULL drops the templates of all connections.
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+void nwk_dropHdrTemplate(connInfo_t *pCInfo)
+{
+  if (!pCInfo)
+  {
+    memset(sHdrTmpl, 0x0, sizeof(sHdrTmpl));
+  }
+  else
+  {
+    sHdrTmpl[nwk_getConnIndex(pCInfo)][HDR_TMPL_PORT_OS] = 0;
+  }
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          buildHdrTemplate
+ *
+ * @brief       Fill in the header template of a connection. Same header
+ *              nwk_buildFrame() builds: not encrypted, not forwarded and
+ *              no ack request or reply.
+ *
+ * input parameters
+ * @param   pCInfo  - connection
+ *
+ * output parameters
+ * @param   pTmpl   - template filled in
+ *
+ * @return   void
+ */
+static void buildHdrTemplate(connInfo_t *pCInfo, uint8_t *pTmpl)
+{
+  uint8_t *pNwk = pTmpl + 2*NET_ADDR_SIZE;
+
+  memcpy(pTmpl, pCInfo->peerAddr, NET_ADDR_SIZE);
+  memcpy(pTmpl+NET_ADDR_SIZE, sMyAddr, NET_ADDR_SIZE);
+
+  pNwk[F_PORT_OS]  = pCInfo->portTx & F_PORT_OS_MSK;
+  pNwk[F_RX_TYPE]  = sMyRxType | (pCInfo->hops2target & F_HOP_COUNT_MSK);
+
+  return;
+}
+
 #if SIZE_INFRAME_Q > 0
+#ifdef MRFI_RX_IN_PLACE
+/******************************************************************************
+ * @fn          MRFI_RxBufferISR
+ *
+ * @brief       Here on Rx interrupt from radio before the frame is read. Reserve
+ *              the input queue slot the radio Rx FIFO is read into. If the frame
+ *              then fails CRC or address filtering MRFI_RxCompleteISR() is not
+ *              called and the slot stays reserved for the next frame.
+ *
+ * input parameters
+ * @param   size  - bytes of frame buffer the frame needs, including the
+ *                  length field
+ *
+ * output parameters
+ *
+ * @return      pointer to packet buffer, or NULL if there's no room.
+ */
+mrfiPacket_t *MRFI_RxBufferISR(uint8_t size)
+{
+  /* a slot kept from a bad frame may be too small for this one */
+  if (sRxSlot && !nwk_QslotFits(sRxSlot, size))
+  {
+    nwk_QfreeFrame(sRxSlot);
+    sRxSlot = NULL;
+  }
+
+  /* room for more? */
+  if (!sRxSlot)
+  {
+    sRxSlot = nwk_QfindRxSlot(size);
+  }
+
+  return sRxSlot ? &sRxSlot->mrfiPkt : (mrfiPacket_t *)NULL;
+}
+#endif  /* MRFI_RX_IN_PLACE */
+
 /******************************************************************************
  * @fn          MRFI_RxCompleteISR
  *
@@ -271,6 +555,15 @@ void MRFI_RxCompleteISR()
 {
   frameInfo_t  *fInfoPtr;
 
+#ifdef MRFI_RX_IN_PLACE
+  /* already read into the slot reserved by MRFI_RxBufferISR() */
+  fInfoPtr = sRxSlot;
+  sRxSlot  = NULL;
+  if (fInfoPtr)
+  {
+    dispatchFrame(fInfoPtr);
+  }
+#else
   /* room for more? */
   if (fInfoPtr=nwk_QfindSlot(INQ))
   {
@@ -278,45 +571,60 @@ void MRFI_RxCompleteISR()
 
     dispatchFrame(fInfoPtr);
   }
+#endif  /* MRFI_RX_IN_PLACE */
 
   return;
 }
 
 /******************************************************************************
- * @fn          nwk_retrieveFrame
+ * @fn          linkQueue
  *
- * @brief       Retrieve frame from Rx frame queue. Invoked by application-level
- *              code either app through SMPL_Receive() or IOCTL through raw Rx. This
- *              should run in a user thread, not an ISR thread.
+ * @brief       Map a Link ID validated by nwk_isConnectionValid() to the
+ *              input queue that holds that link's frames.
  *
  * input parameters
- * @param    port    - port on which to get a frame
+ * @param    lid   - Link ID of connection
  *
  * output parameters
- * @param    msg     - pointer to where app payload should be copied. Buffer
- *                     allocated should be == MAX_APP_PAYLOAD.
  *
- * @param    len      - pointer to where payload length should be stored. Caller
- *                      can check for non-zero when polling the port. initialized
- *                      to 0 even if no frame is retrieved.
- * @param    srcAddr  - if non-NULL, a pointer to where to copy the source address
- *                      of the retrieved message.
- * @param    hopCount - if non-NULL, a pointer to where to copy the hop count
-                        of the retrieved message.
+ * @return    queue ID
+ */
+static uint8_t linkQueue(linkID_t lid)
+{
+  return QID_LINK(nwk_getConnIndex(nwk_getConnInfo(lid)));
+}
+
+/******************************************************************************
+ * @fn          nwk_retrieveFrameView
+ *
+ * @brief       Retrieve frame from Rx frame queue without copying it. The
+ *              frame is taken off its queue and stays in FI_INUSE_TRANSITION
+ *              until nwk_releaseFrameView() is called, so the view stays valid
+ *              and the Rx ISR can't cast it out. This should run in a user
+ *              thread, not an ISR thread.
+ *
+ * input parameters
+ * @param    rcv     - context (port or Link ID) on which to get a frame
+ *
+ * output parameters
+ * @param    view    - populated with pointers into the frame buffer and the
+ *                     frame's source address, hop count and Rx metrics. The
+ *                     length is initialized to 0 even if no frame is retrieved.
  *
  * @return    SMPL_SUCCESS
  *            SMPL_NO_FRAME  - no frame found for specified destination
  *            SMPL_BAD_PARAM - no valid connection info for the Link ID
  *
  */
-smplStatus_t nwk_retrieveFrame(rcvContext_t *rcv, uint8_t *msg, uint8_t *len, addr_t *srcAddr, uint8_t *hopCount)
+smplStatus_t nwk_retrieveFrameView(rcvContext_t *rcv, rxFrameView_t *view)
 {
   frameInfo_t *fPtr;
   uint8_t      done;
 
+  view->frame = 0;
   do {
     /* look for a frame on requested port. */
-    *len = 0;
+    view->len = 0;
     done = 1;
 
     fPtr = nwk_QfindOldest(INQ, rcv, USAGE_NORMAL);
@@ -324,11 +632,13 @@ smplStatus_t nwk_retrieveFrame(rcvContext_t *rcv, uint8_t *msg, uint8_t *len, ad
     {
       connInfo_t  *pCInfo = 0;
 
-      if (RCV_APP_LID == rcv->type)
+      /* a receive on any link has had the Link ID filled in */
+      if ((RCV_APP_LID == rcv->type) || (RCV_APP_ANY == rcv->type))
       {
         pCInfo = nwk_getConnInfo(rcv->t.lid);
         if (!pCInfo)
         {
+          nwk_QfreeFrame(fPtr);
           return SMPL_BAD_PARAM;
         }
 #if defined(SMPL_SECURE)
@@ -363,6 +673,7 @@ smplStatus_t nwk_retrieveFrame(rcvContext_t *rcv, uint8_t *msg, uint8_t *len, ad
           else
           {
             /* Frame bogus. Check for another frame. */
+            nwk_QfreeFrame(fPtr);
             done = 0;
             continue;
           }
@@ -371,29 +682,22 @@ smplStatus_t nwk_retrieveFrame(rcvContext_t *rcv, uint8_t *msg, uint8_t *len, ad
       }
 
       /* it's on the requested port. */
-      *len = MRFI_GET_PAYLOAD_LEN(&fPtr->mrfiPkt) - F_APP_PAYLOAD_OS;
-      memcpy(msg, MRFI_P_PAYLOAD(&fPtr->mrfiPkt)+F_APP_PAYLOAD_OS, *len);
+      view->frame    = fPtr;
+      view->msg      = MRFI_P_PAYLOAD(&fPtr->mrfiPkt)+F_APP_PAYLOAD_OS;
+      view->len      = MRFI_GET_PAYLOAD_LEN(&fPtr->mrfiPkt) - F_APP_PAYLOAD_OS;
+      view->srcAddr  = (const addr_t *)MRFI_P_SRC_ADDR(&fPtr->mrfiPkt);
+      view->hopCount = GET_FROM_FRAME(MRFI_P_PAYLOAD(&fPtr->mrfiPkt), F_HOP_COUNT);
+      view->sigInfo.rssi = fPtr->mrfiPkt.rxMetrics[MRFI_RX_METRICS_RSSI_OFS];
+      view->sigInfo.lqi  = fPtr->mrfiPkt.rxMetrics[MRFI_RX_METRICS_CRC_LQI_OFS];
       /* save signal info */
       if (pCInfo)
       {
         /* Save Rx metrics... */
-        pCInfo->sigInfo.rssi = fPtr->mrfiPkt.rxMetrics[MRFI_RX_METRICS_RSSI_OFS];
-        pCInfo->sigInfo.lqi  = fPtr->mrfiPkt.rxMetrics[MRFI_RX_METRICS_CRC_LQI_OFS];
-      }
-      if (srcAddr)
-      {
-        /* copy source address if requested */
-        memcpy(srcAddr, MRFI_P_SRC_ADDR(&fPtr->mrfiPkt), NET_ADDR_SIZE);
-      }
-      if (hopCount)
-      {
-        /* copy hop count if requested */
-        *hopCount = GET_FROM_FRAME(MRFI_P_PAYLOAD(&fPtr->mrfiPkt), F_HOP_COUNT);
+        pCInfo->sigInfo = view->sigInfo;
       }
-      /* input frame no longer needed. free it. */
-      nwk_QadjustOrder(INQ, fPtr->orderStamp);
-
-      fPtr->fi_usage = FI_AVAILABLE;
+#ifdef MRFI_TIMESTAMP
+      sRxTimestamp = fPtr->mrfiPkt.timestamp;
+#endif
       return SMPL_SUCCESS;
     }
   } while (!done);
@@ -401,6 +705,130 @@ smplStatus_t nwk_retrieveFrame(rcvContext_t *rcv, uint8_t *msg, uint8_t *len, ad
   return SMPL_NO_FRAME;
 }
 
+/******************************************************************************
+ * @fn          nwk_releaseFrameView
+ *
+ * @brief       Give back a frame retrieved with nwk_retrieveFrameView(). The
+ *              view's pointers are no longer valid afterwards. Releasing a
+ *              view that holds no frame is harmless.
+ *
+ * input parameters
+ * @param    view    - view populated by nwk_retrieveFrameView()
+ *
+ * output parameters
+ *
+ * @return    void
+ */
+void nwk_releaseFrameView(rxFrameView_t *view)
+{
+  if (view->frame)
+  {
+    nwk_QfreeFrame((frameInfo_t *)view->frame);
+    view->frame = 0;
+  }
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          nwk_retrieveFrame
+ *
+ * @brief       Retrieve frame from Rx frame queue. Invoked by application-level
+ *              code either app through SMPL_Receive() or IOCTL through raw Rx. This
+ *              should run in a user thread, not an ISR thread.
+ *
+ * input parameters
+ * @param    port    - port on which to get a frame
+ *
+ * output parameters
+ * @param    msg     - pointer to where app payload should be copied. Buffer
+ *                     allocated should be == MAX_APP_PAYLOAD.
+ *
+ * @param    len      - pointer to where payload length should be stored. Caller
+ *                      can check for non-zero when polling the port. initialized
+ *                      to 0 even if no frame is retrieved.
+ * @param    srcAddr  - if non-NULL, a pointer to where to copy the source address
+ *                      of the retrieved message.
+ * @param    hopCount - if non-NULL, a pointer to where to copy the hop count
+                        of the retrieved message.
+ *
+ * @return    SMPL_SUCCESS
+ *            SMPL_NO_FRAME  - no frame found for specified destination
+ *            SMPL_BAD_PARAM - no valid connection info for the Link ID
+ *
+ */
+smplStatus_t nwk_retrieveFrame(rcvContext_t *rcv, uint8_t *msg, uint8_t *len, addr_t *srcAddr, uint8_t *hopCount)
+{
+  rxFrameView_t view;
+  smplStatus_t  rc;
+
+  rc   = nwk_retrieveFrameView(rcv, &view);
+  *len = view.len;
+  if (SMPL_SUCCESS == rc)
+  {
+    memcpy(msg, view.msg, view.len);
+    if (srcAddr)
+    {
+      /* copy source address if requested */
+      memcpy(srcAddr, view.srcAddr, NET_ADDR_SIZE);
+    }
+    if (hopCount)
+    {
+      /* copy hop count if requested */
+      *hopCount = view.hopCount;
+    }
+    /* input frame no longer needed. free it. */
+    nwk_releaseFrameView(&view);
+  }
+
+  return rc;
+}
+
+/******************************************************************************
+ * @fn          fastPath
+ *
+ * @brief       Offer a frame for a user application to the link's Rx fast
+ *              path hook, if it has one. Runs in the Rx ISR thread.
+ *
+ * input parameters
+ * @param   fiPtr    - received frame, on no queue
+ * @param   lid      - Link ID validated by nwk_isConnectionValid()
+ *
+ * output parameters
+ *
+ * @return   Non-zero if the hook consumed the frame. It has been freed.
+ */
+static uint8_t fastPath(frameInfo_t *fiPtr, linkID_t lid)
+{
+#if !defined(SMPL_SECURE)
+  uint8_t   i;
+  uint32_t  stamp = 0;
+
+  for (i=0; i<RX_FASTPATH_HOOKS; ++i)
+  {
+    if (sFastPath[i].pF && (sFastPath[i].lid == lid))
+    {
+#ifdef MRFI_TIMESTAMP
+      stamp = fiPtr->mrfiPkt.timestamp;
+#endif
+      if (sFastPath[i].pF(lid, MRFI_P_PAYLOAD(&fiPtr->mrfiPkt)+F_APP_PAYLOAD_OS,
+                          MRFI_GET_PAYLOAD_LEN(&fiPtr->mrfiPkt)-F_APP_PAYLOAD_OS, stamp))
+      {
+        nwk_QfreeFrame(fiPtr);
+        return 1;
+      }
+      break;
+    }
+  }
+#else
+  /* the payload is still encrypted here. it is decrypted on retrieval. */
+  (void) fiPtr;
+  (void) lid;
+#endif  /* !SMPL_SECURE */
+
+  return 0;
+}
+
 /******************************************************************************
  * @fn          dispatchFrame
  *
@@ -421,6 +849,7 @@ static void dispatchFrame(frameInfo_t *fiPtr)
   uint8_t     nwkAppSize = sizeof(func)/sizeof(func[0]);
   fhStatus_t  rc;
   linkID_t    lid;
+  uint8_t    *dst        = MRFI_P_DST_ADDR(&fiPtr->mrfiPkt);
 #if defined(ACCESS_POINT)
   uint8_t loc;
 #endif
@@ -431,7 +860,7 @@ static void dispatchFrame(frameInfo_t *fiPtr)
   /* be sure it's not an echo... */
   if (!memcmp(MRFI_P_SRC_ADDR(&fiPtr->mrfiPkt), sMyAddr, NET_ADDR_SIZE))
   {
-    fiPtr->fi_usage = FI_AVAILABLE;
+    nwk_QfreeFrame(fiPtr);
     return;
   }
 
@@ -440,14 +869,14 @@ static void dispatchFrame(frameInfo_t *fiPtr)
   if (!(GET_FROM_FRAME(MRFI_P_PAYLOAD(&fiPtr->mrfiPkt), F_ENCRYPT_OS)))
   {
     /* Encyrption bit is not on when when it should be */
-    fiPtr->fi_usage = FI_AVAILABLE;
+    nwk_QfreeFrame(fiPtr);
     return;
   }
 #else
   if (GET_FROM_FRAME(MRFI_P_PAYLOAD(&fiPtr->mrfiPkt), F_ENCRYPT_OS))
   {
     /* Encyrption bit is on when when it should not be */
-    fiPtr->fi_usage = FI_AVAILABLE;
+    nwk_QfreeFrame(fiPtr);
     return;
   }
 #endif  /* SMPL_SECURE */
@@ -461,14 +890,14 @@ static void dispatchFrame(frameInfo_t *fiPtr)
     /* Non-connection-based frame. We can decode here if it was encrypted */
     if (!nwk_getSecureFrame(&fiPtr->mrfiPkt, MRFI_GET_PAYLOAD_LEN(&fiPtr->mrfiPkt) - F_SEC_CTR_OS, 0))
     {
-      fiPtr->fi_usage = FI_AVAILABLE;
+      nwk_QfreeFrame(fiPtr);
       return;
     }
 #endif
     rc = func[port-1](&fiPtr->mrfiPkt);
     if (FHS_KEEP == rc)
     {
-      fiPtr->fi_usage = FI_INUSE_UNTIL_DEL;
+      nwk_QappendFrame(fiPtr, QID_NWK(port), FI_INUSE_UNTIL_DEL);
     }
 #if !defined(END_DEVICE)
     else if (FHS_REPLAY == rc)
@@ -479,7 +908,7 @@ static void dispatchFrame(frameInfo_t *fiPtr)
 #endif
     else  /* rc == FHS_RELEASE (default...) */
     {
-      fiPtr->fi_usage = FI_AVAILABLE;
+      nwk_QfreeFrame(fiPtr);
     }
     return;
   }
@@ -487,7 +916,7 @@ static void dispatchFrame(frameInfo_t *fiPtr)
   else if ((port != SMPL_PORT_USER_BCAST) && ((port < PORT_BASE_NUMBER) || (port > SMPL_PORT_STATIC_MAX)))
   {
     /* bogus port. drop frame */
-    fiPtr->fi_usage = FI_AVAILABLE;
+    nwk_QfreeFrame(fiPtr);
     return;
   }
 
@@ -499,7 +928,16 @@ static void dispatchFrame(frameInfo_t *fiPtr)
    */
 
 #if defined(END_DEVICE)
-  /* If we're s polling end device we only accept application frames from
+  /* The radio passes every multicast group frame. Keep only those for a
+   * group we've joined.
+   */
+  if (isGroupAddr(dst) && ((port != SMPL_PORT_USER_BCAST) || !isGroupMember(dst)))
+  {
+    nwk_QfreeFrame(fiPtr);
+    return;
+  }
+
+  /* If we're s polling end device we only accept application frames from
    * the AP. This prevents duplicate reception if we happen to be on when
    * a linked peer sends.
    */
@@ -508,31 +946,40 @@ static void dispatchFrame(frameInfo_t *fiPtr)
   {
     if (nwk_isConnectionValid(&fiPtr->mrfiPkt, &lid))
     {
-      fiPtr->fi_usage = FI_INUSE_UNTIL_DEL;
+      nwk_pollReplyRcvd(&fiPtr->mrfiPkt);
+      if (fastPath(fiPtr, lid))
+      {
+        return;
+      }
+      nwk_QappendFrame(fiPtr, linkQueue(lid), FI_INUSE_UNTIL_DEL);
     }
     else
     {
-      fiPtr->fi_usage = FI_AVAILABLE;
+      nwk_QfreeFrame(fiPtr);
     }
   }
   else
   {
-    fiPtr->fi_usage = FI_AVAILABLE;
+    nwk_QfreeFrame(fiPtr);
   }
 #else
   /* it's destined for a user app. */
   if (nwk_isConnectionValid(&fiPtr->mrfiPkt, &lid))
   {
-    fiPtr->fi_usage = FI_INUSE_UNTIL_DEL;
+    if (fastPath(fiPtr, lid))
+    {
+      return;
+    }
+    nwk_QappendFrame(fiPtr, linkQueue(lid), FI_INUSE_UNTIL_DEL);
     if (spCallback && spCallback(lid))
     {
-      fiPtr->fi_usage = FI_AVAILABLE;
+      nwk_QremoveFrame(fiPtr);
       return;
     }
   }
   else
   {
-    fiPtr->fi_usage = FI_AVAILABLE;
+    nwk_QfreeFrame(fiPtr);
   }
 #endif  /* RX_POLLS */
 
@@ -543,10 +990,11 @@ static void dispatchFrame(frameInfo_t *fiPtr)
    * running that is listening on that port. But if it's a broadcast it must also be
    * replayed. It isn't enough just to test for the UUD port because it could be a
    * directed frame to another device. We must check explicitly for broadcast
-   * destination address.
+   * destination address. Frames for a multicast group we've joined are
+   * handled the same way. Those for other groups are only replayed.
    */
-  isForMe = !memcmp(sMyAddr, MRFI_P_DST_ADDR(&fiPtr->mrfiPkt), NET_ADDR_SIZE);
-  if (isForMe || ((port == SMPL_PORT_USER_BCAST) && !memcmp(nwk_getBCastAddress(), MRFI_P_DST_ADDR(&fiPtr->mrfiPkt), NET_ADDR_SIZE)))
+  isForMe = !memcmp(sMyAddr, dst, NET_ADDR_SIZE);
+  if (isForMe || ((port == SMPL_PORT_USER_BCAST) && (!memcmp(nwk_getBCastAddress(), dst, NET_ADDR_SIZE) || isGroupMember(dst))))
   {
     /* The folllowing test will succeed for the UUD port regardless of the
      * source address.
@@ -564,56 +1012,59 @@ static void dispatchFrame(frameInfo_t *fiPtr)
       /* Do I need to replay it? */
       if (!isForMe)
       {
-        /* must be a broadcast for the UUD port */
+        /* must be a broadcast for the UUD port. Mark it held so the replay
+         * doesn't release the frame buffer.
+         */
+        fiPtr->fi_usage = FI_INUSE_UNTIL_DEL;
         nwk_replayFrame(fiPtr);
       }
       /* OK. Now I handle it... */
-      fiPtr->fi_usage = FI_INUSE_UNTIL_DEL;
+      if (fastPath(fiPtr, lid))
+      {
+        return;
+      }
+      nwk_QappendFrame(fiPtr, linkQueue(lid), FI_INUSE_UNTIL_DEL);
       if (spCallback && spCallback(lid))
       {
-        fiPtr->fi_usage = FI_AVAILABLE;
+        nwk_QremoveFrame(fiPtr);
         return;
       }
     }
     else
     {
-      fiPtr->fi_usage = FI_AVAILABLE;
+      nwk_QfreeFrame(fiPtr);
     }
   }
 #if defined( ACCESS_POINT )
   /* Check to see if we need to save this for a S and F client. Otherwise,
    * if it's not for us, get rid of it.
    */
-  else if (nwk_isSandFClient(MRFI_P_DST_ADDR(&fiPtr->mrfiPkt), &loc))
+  else if (nwk_isSandFClient(dst, &loc))
   {
-    /* Don't bother if it is a duplicate frame or if it's a forwarded frame
-     * echoed back from an RE.
+    /* Don't bother if it's a forwarded frame echoed back from an RE. The
+     * S&F pool drops duplicates. The frame is copied into the pool so the
+     * input queue slot is freed either way.
      */
-    if (!isDupSandFFrame(&fiPtr->mrfiPkt) &&
-        !(GET_FROM_FRAME(MRFI_P_PAYLOAD(&fiPtr->mrfiPkt), F_FWD_FRAME))
-       )
+    if (!(GET_FROM_FRAME(MRFI_P_PAYLOAD(&fiPtr->mrfiPkt), F_FWD_FRAME)))
     {
 #if defined(APP_AUTO_ACK)
       /* Make sure ack request bit is off. Sender will have gone away. */
       PUT_INTO_FRAME(MRFI_P_PAYLOAD(&fiPtr->mrfiPkt), F_ACK_REQ, 0);
 #endif
-      fiPtr->fi_usage = FI_INUSE_UNTIL_FWD;
-    }
-    else
-    {
-      fiPtr->fi_usage = FI_AVAILABLE;
+      nwk_QstoreSandF(&fiPtr->mrfiPkt, loc);
     }
+    nwk_QfreeFrame(fiPtr);
   }
   else if (GET_FROM_FRAME(MRFI_P_PAYLOAD(&fiPtr->mrfiPkt), F_TX_DEVICE) == F_TX_DEVICE_AP)
   {
     /* I'm an AP and this frame came from an AP. Don't replay. */
-    fiPtr->fi_usage = FI_AVAILABLE;
+    nwk_QfreeFrame(fiPtr);
   }
 #elif defined( RANGE_EXTENDER )
   else if (GET_FROM_FRAME(MRFI_P_PAYLOAD(&fiPtr->mrfiPkt), F_TX_DEVICE) == F_TX_DEVICE_RE)
   {
     /* I'm an RE and this frame came from an RE. Don't replay. */
-    fiPtr->fi_usage = FI_AVAILABLE;
+    nwk_QfreeFrame(fiPtr);
   }
 #endif
   else
@@ -626,8 +1077,77 @@ static void dispatchFrame(frameInfo_t *fiPtr)
 #endif  /* !END_DEVICE */
   return;
 }
+
+/******************************************************************************
+ * @fn          isGroupAddr
+ *
+ * @brief       Is the address a multicast group address: the broadcast
+ *              address except for a group number in the last byte.
+ *
+ * input parameters
+ * @param   addr  - destination address of a received frame
+ *
+ * output parameters
+ *
+ * @return   non-zero if it is a group address
+ */
+static uint8_t isGroupAddr(const uint8_t *addr)
+{
+  return (addr[NWK_GROUP_ADDR_OS] != nwk_getBCastAddress()->addr[NWK_GROUP_ADDR_OS]) &&
+         !memcmp(addr, nwk_getBCastAddress(), NWK_GROUP_ADDR_OS);
+}
+
+/******************************************************************************
+ * @fn          isGroupMember
+ *
+ * @brief       Have we joined the multicast group the address is for.
+ *
+ * input parameters
+ * @param   addr  - destination address of a received frame
+ *
+ * output parameters
+ *
+ * @return   non-zero if the address is for a group we've joined
+ */
+static uint8_t isGroupMember(const uint8_t *addr)
+{
+  uint8_t group = addr[NWK_GROUP_ADDR_OS];
+
+  return isGroupAddr(addr) && (group < NWK_GROUPS) && (sGroups[group>>3] & (1 << (group & 0x7)));
+}
 #endif   /* SIZE_INFRAME_Q > 0 */
 
+/******************************************************************************
+ * @fn          nwk_setGroup
+ *
+ * @brief       Join or leave a multicast group.
+ *
+ * input parameters
+ * @param   group  - group number, less than NWK_GROUPS
+ * @param   join   - non-zero to join, 0 to leave
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+void nwk_setGroup(uint8_t group, uint8_t join)
+{
+  bspIState_t intState;
+
+  BSP_ENTER_CRITICAL_SECTION(intState);
+  if (join)
+  {
+    sGroups[group>>3] |= 1 << (group & 0x7);
+  }
+  else
+  {
+    sGroups[group>>3] &= ~(1 << (group & 0x7));
+  }
+  BSP_EXIT_CRITICAL_SECTION(intState);
+
+  return;
+}
+
 /******************************************************************************
  * @fn          nwk_sendFrame
  *
@@ -646,28 +1166,298 @@ static void dispatchFrame(frameInfo_t *fiPtr)
 smplStatus_t nwk_sendFrame(frameInfo_t *pFrameInfo, uint8_t txOption)
 {
   smplStatus_t rc;
+#ifndef MRFI_TX_ASYNC
+  uint8_t      busy;
+#endif
+  bspIState_t  intState;
+
+#ifdef MRFI_TX_ASYNC
+  /* a queued frame may be on the air. MRFI_Transmit() waits for it to finish
+   * and the queue doesn't start another until we're done.
+   */
+  BSP_ENTER_CRITICAL_SECTION(intState);
+  sTxHold++;
+  BSP_EXIT_CRITICAL_SECTION(intState);
+
+  rc = txFrame(pFrameInfo, txOption);
+
+  BSP_ENTER_CRITICAL_SECTION(intState);
+  sTxHold--;
+  BSP_EXIT_CRITICAL_SECTION(intState);
+#else
+  /* keep the Tx queue drain off the radio until we're done. we may ourselves
+   * be running on top of the drain (Rx ISR replies) so put back what we found.
+   */
+  BSP_ENTER_CRITICAL_SECTION(intState);
+  busy    = sTxBusy;
+  sTxBusy = 1;
+  BSP_EXIT_CRITICAL_SECTION(intState);
+
+  rc = txFrame(pFrameInfo, txOption);
 
+  sTxBusy = busy;
+#endif
+
+  /* TX is done. free up the frame buffer unless it is also being held for
+   * a local receiver (UUD broadcast replay).
+   */
+  if (FI_INUSE_UNTIL_DEL != pFrameInfo->fi_usage)
+  {
+    nwk_QfreeFrame(pFrameInfo);
+  }
+
+  return rc;
+}
+
+
+/******************************************************************************
+ * @fn          txFrame
+ *
+ * @brief       Load a frame into the radio and send it.
+ *
+ * input parameters
+ * @param   pFrameInfo   - pointer to frame to be sent
+ * @param   txOption     - do CCA or force frame out.
+ *
+ * output parameters
+ *
+ * @return    SMPL_SUCCESS
+ *            SMPL_TX_CCA_FAIL Tx failed because of CCA failure.
+ *                             Tx FIFO flushed in this case.
+ */
+static smplStatus_t txFrame(frameInfo_t *pFrameInfo, uint8_t txOption)
+{
   /* set the type of device sending the frame in the header */
   PUT_INTO_FRAME(MRFI_P_PAYLOAD(&pFrameInfo->mrfiPkt), F_TX_DEVICE, sMyTxType);
 
   if (MRFI_TX_RESULT_SUCCESS == MRFI_Transmit(&pFrameInfo->mrfiPkt, txOption))
   {
-    rc = SMPL_SUCCESS;
+    return SMPL_SUCCESS;
   }
-  else
+
+  /* Tx failed -- probably CCA. We do not have NWK level retries. Let
+   * application do it.
+   */
+  return SMPL_TX_CCA_FAIL;
+}
+
+/******************************************************************************
+ * @fn          nwk_queueFrame
+ *
+ * @brief       Queue a built frame to be sent later by nwk_drainTxQueue()
+ *              instead of sending it now. Frames go out in the order they
+ *              were queued. Frames sent with nwk_sendFrame() don't wait
+ *              behind them.
+ *
+ * input parameters
+ * @param   pFrameInfo   - frame from nwk_buildFrame()
+ * @param   txOption     - do CCA or force frame out.
+ * @param   done         - called with the handle and the Tx status when the
+ *                         frame has gone out. runs in the thread doing the
+ *                         drain, or in interrupt context with MRFI_TX_ASYNC
+ *                         defined. may be NULL.
+ *
+ * output parameters
+ *
+ * @return    handle for nwk_txStatus(). never 0.
+ */
+uint8_t nwk_queueFrame(frameInfo_t *pFrameInfo, uint8_t txOption, void (*done)(uint8_t, smplStatus_t))
+{
+  uint8_t      i   = pFrameInfo - nwk_getQ(OUTQ);
+  txJob_t     *job = &sTxJob[i];
+  bspIState_t  intState;
+
+  while (!(++sTxHandle)) ;  /* handle can't be 0 */
+  job->handle   = sTxHandle;
+  job->txOption = txOption;
+  job->status   = SMPL_TX_PENDING;
+  job->done     = done;
+
+  BSP_ENTER_CRITICAL_SECTION(intState);
+  pFrameInfo->fi_usage = FI_INUSE_UNTIL_TX;
+  sTxOrder[(sTxHead + sTxCount) % SIZE_OUTFRAME_Q] = i;
+  sTxCount++;
+  BSP_EXIT_CRITICAL_SECTION(intState);
+
+  return job->handle;
+}
+
+/******************************************************************************
+ * @fn          nwk_drainTxQueue
+ *
+ * @brief       Send everything queued by nwk_queueFrame(), oldest first, and
+ *              report each result. Does nothing if the radio is already busy
+ *              sending, so it is safe to call from a timer ISR that preempts
+ *              the main thread. Interrupts may be enabled around the call: a
+ *              nested call returns at once.
+ *
+ *              With MRFI_TX_ASYNC defined this only starts the oldest frame
+ *              and returns. The radio interrupts
+ *              report it and start the next one. A queue held up by
+ *              nwk_sendFrame() goes on at the next call.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return    void
+ */
+#ifdef MRFI_TX_ASYNC
+void nwk_drainTxQueue(void)
+{
+  uint8_t      i;
+  frameInfo_t *pFI;
+  bspIState_t  intState;
+
+  BSP_ENTER_CRITICAL_SECTION(intState);
+  if (sTxBusy || sTxHold || !sTxCount)
   {
-    /* Tx failed -- probably CCA. free up frame buffer. We do not have NWK
-     * level retries. Let application do it.
-     */
-    rc = SMPL_TX_CCA_FAIL;
+    BSP_EXIT_CRITICAL_SECTION(intState);
+    return;
   }
+  sTxBusy = 1;
+  BSP_EXIT_CRITICAL_SECTION(intState);
 
-  /* TX is done. free up the frame buffer */
-  pFrameInfo->fi_usage = FI_AVAILABLE;
+  i   = sTxOrder[sTxHead];
+  pFI = nwk_getQ(OUTQ) + i;
 
-  return rc;
+  /* set the type of device sending the frame in the header */
+  PUT_INTO_FRAME(MRFI_P_PAYLOAD(&pFI->mrfiPkt), F_TX_DEVICE, sMyTxType);
+
+  if (MRFI_TX_RESULT_SUCCESS != MRFI_TransmitAsync(&pFI->mrfiPkt, sTxJob[i].txOption, txDone))
+  {
+    /* radio is busy with a frame from outside the queue. try again next call. */
+    sTxBusy = 0;
+  }
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          txDone
+ *
+ * @brief       MRFI_TransmitAsync() is done with the oldest queued frame.
+ *              Report the result and start the next frame. Runs in interrupt
+ *              context.
+ *
+ * input parameters
+ * @param   result   - MRFI_TX_RESULT_SUCCESS or MRFI_TX_RESULT_FAILED
+ *
+ * output parameters
+ *
+ * @return    void
+ */
+static void txDone(uint8_t result)
+{
+  uint8_t  i   = sTxOrder[sTxHead];
+  txJob_t *job = &sTxJob[i];
+
+  /* Tx failed -- probably CCA. same as txFrame(). */
+  job->status = (MRFI_TX_RESULT_SUCCESS == result) ? SMPL_SUCCESS : SMPL_TX_CCA_FAIL;
+
+  sTxHead = (sTxHead + 1) % SIZE_OUTFRAME_Q;
+  sTxCount--;
+  nwk_QfreeFrame(nwk_getQ(OUTQ) + i);
+  sTxBusy = 0;
+
+  if (job->done)
+  {
+    job->done(job->handle, job->status);
+  }
+
+  nwk_drainTxQueue();
+
+  return;
+}
+#else
+void nwk_drainTxQueue(void)
+{
+  uint8_t      i;
+  txJob_t     *job;
+  frameInfo_t *pFI;
+  bspIState_t  intState;
+
+  BSP_ENTER_CRITICAL_SECTION(intState);
+  if (sTxBusy || !sTxCount)
+  {
+    BSP_EXIT_CRITICAL_SECTION(intState);
+    return;
+  }
+  sTxBusy = 1;
+  BSP_EXIT_CRITICAL_SECTION(intState);
+
+  while (sTxCount)
+  {
+    i   = sTxOrder[sTxHead];
+    pFI = nwk_getQ(OUTQ) + i;
+    job = &sTxJob[i];
+
+    job->status = txFrame(pFI, job->txOption);
+
+    BSP_ENTER_CRITICAL_SECTION(intState);
+    sTxHead = (sTxHead + 1) % SIZE_OUTFRAME_Q;
+    sTxCount--;
+    BSP_EXIT_CRITICAL_SECTION(intState);
+
+    nwk_QfreeFrame(pFI);
+    if (job->done)
+    {
+      job->done(job->handle, job->status);
+    }
+  }
+
+  sTxBusy = 0;
+
+  return;
 }
+#endif  /* MRFI_TX_ASYNC */
+
+/******************************************************************************
+ * @fn          nwk_txPending
+ *
+ * @brief       Are there queued frames still to be sent?
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return    Number of frames waiting in the Tx queue.
+ */
+uint8_t nwk_txPending(void)
+{
+  return sTxCount;
+}
+
+/******************************************************************************
+ * @fn          nwk_txStatus
+ *
+ * @brief       Get the status of a queued frame. The result is kept until
+ *              the frame's output queue slot is used by another queued frame.
+ *
+ * input parameters
+ * @param   handle   - handle from nwk_queueFrame()
+ *
+ * output parameters
+ *
+ * @return    SMPL_TX_PENDING  Not sent yet.
+ *            SMPL_SUCCESS     Sent.
+ *            SMPL_TX_CCA_FAIL Tx failed because of CCA failure.
+ *            SMPL_BAD_PARAM   Unknown or expired handle.
+ */
+smplStatus_t nwk_txStatus(uint8_t handle)
+{
+  uint8_t i;
 
+  for (i=0; i<SIZE_OUTFRAME_Q; ++i)
+  {
+    if (handle && (sTxJob[i].handle == handle))
+    {
+      return sTxJob[i].status;
+    }
+  }
+
+  return SMPL_BAD_PARAM;
+}
 
 /******************************************************************************
  * @fn          nwk_getMyRxType
@@ -687,6 +1477,78 @@ uint8_t nwk_getMyRxType(void)
   return sMyRxType;
 }
 
+#ifdef MRFI_TIMESTAMP
+/******************************************************************************
+ * @fn          nwk_getRxTimestamp
+ *
+ * @brief       Get the receive timestamp of the last frame retrieved with
+ *              nwk_retrieveFrame(). Captured by MRFI at the end-of-frame edge
+ *              so it excludes queueing and polling delay.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return      Timestamp in MRFI_TimestampCapture() units.
+ */
+uint32_t nwk_getRxTimestamp(void)
+{
+  return sRxTimestamp;
+}
+#endif
+
+#if !defined(SMPL_SECURE)
+/******************************************************************************
+ * @fn          nwk_setFastPath
+ *
+ * @brief       Set, replace or remove the Rx fast path hook for a link.
+ *
+ * input parameters
+ * @param   lid   - Link ID, already validated
+ * @param   pF    - hook, or NULL to remove the link's hook
+ *
+ * output parameters
+ *
+ * @return      SMPL_SUCCESS
+ *              SMPL_NOMEM    all RX_FASTPATH_HOOKS entries in use
+ */
+smplStatus_t nwk_setFastPath(linkID_t lid, rxFastPath_t pF)
+{
+  uint8_t      i, freeIdx = RX_FASTPATH_HOOKS;
+  bspIState_t  intState;
+
+  BSP_ENTER_CRITICAL_SECTION(intState);
+  for (i=0; i<RX_FASTPATH_HOOKS; ++i)
+  {
+    if (sFastPath[i].pF && (sFastPath[i].lid == lid))
+    {
+      /* replace or remove */
+      sFastPath[i].pF = pF;
+      BSP_EXIT_CRITICAL_SECTION(intState);
+      return SMPL_SUCCESS;
+    }
+    if (!sFastPath[i].pF && (RX_FASTPATH_HOOKS == freeIdx))
+    {
+      freeIdx = i;
+    }
+  }
+
+  if (pF)
+  {
+    if (RX_FASTPATH_HOOKS == freeIdx)
+    {
+      BSP_EXIT_CRITICAL_SECTION(intState);
+      return SMPL_NOMEM;
+    }
+    sFastPath[freeIdx].lid = lid;
+    sFastPath[freeIdx].pF  = pF;
+  }
+  BSP_EXIT_CRITICAL_SECTION(intState);
+
+  return SMPL_SUCCESS;
+}
+#endif  /* !SMPL_SECURE */
+
 #if defined(APP_AUTO_ACK)
 /******************************************************************************
  * @fn          nwk_sendAckReply
@@ -755,8 +1617,14 @@ void nwk_sendAckReply(mrfiPacket_t *frame, uint8_t port)
 /******************************************************************************
  * @fn          nwk_replayFrame
  *
- * @brief       Deal with hop count on a Range Extender or Access Point replay.
- *              Queue entry usage always left as available when done.
+ * @brief       Replay a frame on a Range Extender or Access Point, unless it
+ *              has already been replayed or heard from enough other relays.
+ *              The replay is sent after a random delay by the one-shot timer,
+ *              so it must not be touched after this call unless it is also
+ *              held for a local receiver, in which case it goes out at once.
+ *              Queue entry usage always left as available when done unless
+ *              the frame is also held for a local receiver. Runs in the Rx
+ *              ISR thread.
  *
  * input parameters
  * @param   pFrameInfo   - pointer to frame information structure
@@ -766,6 +1634,80 @@ void nwk_sendAckReply(mrfiPacket_t *frame, uint8_t port)
  * @return      void
  */
 void nwk_replayFrame(frameInfo_t *pFrameInfo)
+{
+  mrfiPacket_t *pkt = &pFrameInfo->mrfiPkt;
+  uint8_t       tid = GET_FROM_FRAME(MRFI_P_PAYLOAD(pkt), F_TRACTID_OS);
+  relaySeen_t  *pS;
+  uint8_t       i;
+
+  if (!GET_FROM_FRAME(MRFI_P_PAYLOAD(pkt), F_HOP_COUNT))
+  {
+    nwk_replayFrameNow(pFrameInfo);   /* drops it */
+    return;
+  }
+
+  for (i=0, pS=sRelaySeen; i<RELAY_CACHE_SIZE; ++i, ++pS)
+  {
+    if (pS->heard && (pS->tid == tid) && !memcmp(pS->addr, MRFI_P_SRC_ADDR(pkt), NET_ADDR_SIZE))
+    {
+      /* heard it before: the original or another relay's replay. */
+      if (pS->heard < 0xFF)
+      {
+        pS->heard++;
+      }
+      sRelaySuppressed++;
+      if (FI_INUSE_UNTIL_DEL != pFrameInfo->fi_usage)
+      {
+        nwk_QfreeFrame(pFrameInfo);
+      }
+      return;
+    }
+  }
+
+  /* new frame. take the next entry that isn't waiting to replay. */
+  do
+  {
+    pS = &sRelaySeen[sRelayNext];
+    sRelayNext = (sRelayNext + 1) % RELAY_CACHE_SIZE;
+  } while (pS->pFI);
+  memcpy(pS->addr, MRFI_P_SRC_ADDR(pkt), NET_ADDR_SIZE);
+  pS->tid   = tid;
+  pS->heard = 1;
+
+  if ((FI_INUSE_UNTIL_DEL == pFrameInfo->fi_usage) || (sRelayWaiting >= RELAY_PENDING))
+  {
+    if (nwk_replayFrameNow(pFrameInfo))
+    {
+      sRelaySent++;
+    }
+    return;
+  }
+
+  pS->pFI = pFrameInfo;
+  pS->due = BSP_TimerNow() + (1 + MRFI_RandomByte() % RELAY_JITTER_MS) * BSP_TIMER_TICKS_PER_MS;
+  sRelayWaiting++;
+  relayTimerArm();
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          nwk_replayFrameNow
+ *
+ * @brief       Deal with hop count on a Range Extender or Access Point replay
+ *              and send the frame right away. No duplicate check. Queue entry
+ *              usage always left as available when done unless the frame is
+ *              also held for a local receiver.
+ *
+ * input parameters
+ * @param   pFrameInfo   - pointer to frame information structure
+ *
+ * output parameters
+ *
+ * @return      non-zero if the frame went out. 0 if it was dropped or the
+ *              send failed.
+ */
+uint8_t nwk_replayFrameNow(frameInfo_t *pFrameInfo)
 {
   uint8_t  hops = GET_FROM_FRAME(MRFI_P_PAYLOAD(&pFrameInfo->mrfiPkt), F_HOP_COUNT);
 
@@ -785,67 +1727,166 @@ void nwk_replayFrame(frameInfo_t *pFrameInfo)
       nwk_setSecureFrame(&pFrameInfo->mrfiPkt, MRFI_GET_PAYLOAD_LEN(&pFrameInfo->mrfiPkt)-F_APP_PAYLOAD_OS, 0);
     }
 #endif
-    MRFI_DelayMs(1);
-    nwk_sendFrame(pFrameInfo, MRFI_TX_TYPE_CCA);
+    return (SMPL_SUCCESS == nwk_sendFrame(pFrameInfo, MRFI_TX_TYPE_CCA));
   }
-  else
+  else if (FI_INUSE_UNTIL_DEL != pFrameInfo->fi_usage)
   {
-    pFrameInfo->fi_usage = FI_AVAILABLE;
+    nwk_QfreeFrame(pFrameInfo);
   }
+  return 0;
+}
+
+/******************************************************************************
+ * @fn          nwk_getRelayCounts
+ *
+ * @brief       Get the number of frames replayed and the number of copies not
+ *              replayed because they had already been replayed or heard from
+ *              other relays. The counts wrap.
+ *
+ * input parameters
+ *
+ * output parameters
+ * @param   sent        - replays that went out
+ * @param   suppressed  - replays suppressed
+ *
+ * @return      void
+ */
+void nwk_getRelayCounts(uint16_t *sent, uint16_t *suppressed)
+{
+  bspIState_t intState;
+
+  BSP_ENTER_CRITICAL_SECTION(intState);
+  *sent       = sRelaySent;
+  *suppressed = sRelaySuppressed;
+  BSP_EXIT_CRITICAL_SECTION(intState);
+
   return;
 }
 
-#if defined(ACCESS_POINT)
 /******************************************************************************
- * @fn          nwk_getSandFFrame
+ * @fn          relayTimerArm
  *
- * @brief       Get any frame waiting for the client on the port supplied in
- *              the frame payload.
- *              TODO: support returning NWK application frames always. the
- *              port requested in the call should be an user application port.
- *              NWK app ports will never be in the called frame.
- *              TODO: deal with broadcast NWK frames from AP.
+ * @brief       Arm the relay timer channel for the earliest waiting replay,
+ *              or stop it if none is waiting. Runs with interrupts off.
  *
  * input parameters
- * @param   frame   - pointer to frame in question
  *
  * output parameters
  *
- * @return      pointer to frame if there is one, otherwise 0.
+ * @return      void
  */
-frameInfo_t *nwk_getSandFFrame(mrfiPacket_t *frame, uint8_t osPort)
+static void relayTimerArm(void)
 {
-  uint8_t        i, port = *(MRFI_P_PAYLOAD(frame)+F_APP_PAYLOAD_OS+osPort);
-  frameInfo_t *fiPtr;
-  rcvContext_t rcv;
+  uint8_t  i;
+  uint16_t now = BSP_TimerNow();
+  uint16_t left, soonest = 0xFFFF;
+
+  for (i=0; i<RELAY_CACHE_SIZE; ++i)
+  {
+    if (sRelaySeen[i].pFI)
+    {
+      left = sRelaySeen[i].due - now;
+      if ((int16_t)left < 0)
+      {
+        left = 0;
+      }
+      if (left < soonest)
+      {
+        soonest = left;
+      }
+    }
+  }
 
-  rcv.type  = RCV_RAW_POLL_FRAME;
-  rcv.t.pkt = frame;
-  /* check the input queue for messages sent by others. */
-  if (fiPtr=nwk_QfindOldest(INQ, &rcv, USAGE_FWD))
+  if (sRelayWaiting)
   {
-    return fiPtr;
+    BSP_TimerArm(&sRelayTimer, now + soonest, relayTimeout);
+  }
+  else
+  {
+    BSP_TimerDisarm(&sRelayTimer);
   }
 
-  /* Check the output queue to see if we ourselves need to send anything.
-   * TODO: use the cast-out scheme for output queue so this routine finds
-   * the oldest in either queue.
-   */
-  fiPtr = nwk_getQ(OUTQ);
-  for (i=0; i<SIZE_OUTFRAME_Q; ++i, fiPtr++)
+  return;
+}
+
+/******************************************************************************
+ * @fn          relayTimeout
+ *
+ * @brief       Relay timer expired. Send the replays that are due unless
+ *              enough copies have been heard in the meantime. Runs in the
+ *              timer ISR thread. If it interrupted a send the replays stay
+ *              waiting another millisecond: the radio can't be waited for
+ *              here.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return      void
+ */
+static void relayTimeout(void)
+{
+  uint8_t      i;
+  uint16_t     now = BSP_TimerNow();
+  frameInfo_t *pFI;
+
+  for (i=0; i<RELAY_CACHE_SIZE; ++i)
   {
-    if (FI_INUSE_UNTIL_FWD == fiPtr->fi_usage)
+    if ((pFI = sRelaySeen[i].pFI) && ((int16_t)(now - sRelaySeen[i].due) >= 0))
     {
-      if (!memcmp(MRFI_P_DST_ADDR(&fiPtr->mrfiPkt), MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE))
+      if (sRelaySeen[i].heard >= RELAY_SUPPRESS_COUNT)
+      {
+        sRelaySeen[i].pFI = 0;
+        sRelayWaiting--;
+        sRelaySuppressed++;
+        nwk_QfreeFrame(pFI);
+      }
+      else if (MRFI_TxBusy())
       {
-        if (GET_FROM_FRAME(MRFI_P_PAYLOAD(&fiPtr->mrfiPkt), F_PORT_OS) == port)
+        sRelaySeen[i].due = now + BSP_TIMER_TICKS_PER_MS;
+      }
+      else
+      {
+        sRelaySeen[i].pFI = 0;
+        sRelayWaiting--;
+        if (nwk_replayFrameNow(pFI))
         {
-          return fiPtr;
+          sRelaySent++;
         }
       }
     }
   }
-  return 0;
+  relayTimerArm();
+
+  return;
+}
+
+#if defined(ACCESS_POINT)
+/******************************************************************************
+ * @fn          nwk_getSandFFrame
+ *
+ * @brief       Get the oldest frame waiting for the client on the port supplied
+ *              in the frame payload. Frames the AP itself sends to the client
+ *              are held in the same store-and-forward pool as relayed ones.
+ *              TODO: support returning NWK application frames always. the
+ *              port requested in the call should be an user application port.
+ *              NWK app ports will never be in the called frame.
+ *              TODO: deal with broadcast NWK frames from AP.
+ *
+ * input parameters
+ * @param   client  - address of the polling client
+ * @param   port    - port named in the poll
+ * @param   addr    - source address named in the poll
+ *
+ * output parameters
+ * @param   more    - set non-zero if there is another frame waiting on the
+ *                    same port after the one returned
+ *
+ * @return      pointer to frame if there is one, otherwise 0.
+ */
+frameInfo_t *nwk_getSandFFrame(const uint8_t *client, uint8_t port, const uint8_t *addr, uint8_t *more)
+{
+  return nwk_QtakeSandF(client, port, addr, more);
 }
 
 /******************************************************************************
@@ -906,43 +1947,6 @@ void nwk_SendEmptyPollRspFrame(mrfiPacket_t *frame)
   return;
 }
 
-/******************************************************************************
- * @fn          isDupSandFFrame
- *
- * @brief       Have we already stored this frame on behalf of a client?
- *
- * input parameters
- * @param   frame   - pointer to frame in question
- *
- * output parameters
- *
- * @return      Returns 1 if the frame is a duplicate, otherwise 0.
- */
-uint8_t  isDupSandFFrame(mrfiPacket_t *frame)
-{
-  uint8_t      i, plLen = MRFI_GET_PAYLOAD_LEN(frame);
-  frameInfo_t *fiPtr;
-
-  /* check the input queue for duplicate S&F frame. */
-  fiPtr = nwk_getQ(INQ);
-  for (i=0; i<SIZE_INFRAME_Q; ++i, fiPtr++)
-  {
-    if (FI_INUSE_UNTIL_FWD == fiPtr->fi_usage)
-    {
-      /* compare everything except the DEVICE INFO byte. */
-      if (MRFI_GET_PAYLOAD_LEN(&fiPtr->mrfiPkt) == plLen                                   &&
-          !memcmp(MRFI_P_DST_ADDR(&fiPtr->mrfiPkt), MRFI_P_DST_ADDR(frame), NET_ADDR_SIZE) &&
-          !memcmp(MRFI_P_SRC_ADDR(&fiPtr->mrfiPkt), MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE) &&
-          !memcmp(MRFI_P_PAYLOAD(&fiPtr->mrfiPkt), MRFI_P_PAYLOAD(frame), 1)               &&
-          !memcmp(MRFI_P_PAYLOAD(&fiPtr->mrfiPkt)+F_TRACTID_OS, MRFI_P_PAYLOAD(frame)+F_TRACTID_OS, plLen-F_TRACTID_OS)
-          )
-      {
-        return 1;
-      }
-    }
-  }
-  return 0;
-}
 #endif  /* ACCESS_POINT */
 
 #endif  /* !END_DEVICE */
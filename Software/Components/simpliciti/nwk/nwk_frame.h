@@ -37,6 +37,8 @@
 #ifndef NWK_FRAME_H
 #define NWK_FRAME_H
 
+#include "nwk.h"    /* connInfo_t */
+
 /* Frame field defines and masks. Mask name must be field name with '_MSK' appended
  * so the GET and PUT macros work correctly -- they use token pasting. Offset values
  * are with respect to the MRFI payload and not the entire frame.
@@ -57,10 +59,20 @@
 #define F_TX_DEVICE_MSK   (0x30)
 #define F_HOP_COUNT       1
 #define F_HOP_COUNT_MSK   (0x07)
+#define F_MORE_PEND       1       /* poll replies from the AP only. see below */
+#define F_MORE_PEND_MSK   (0x40)
 #define F_TRACTID_OS      2
 #define F_TRACTID_OS_MSK  (0xFF)
 #define SMPL_NWK_HDR_SIZE 3
 
+/* The header has no free bit so the more pending flag shares the Rx type bit.
+ * That is wire compatible: the Rx type in a frame header is only read by the
+ * AP, and only in Join requests (links carry it in the payload). A poll reply
+ * is a held frame the AP sends on to an End Device. The bit there used to
+ * carry the original sender's Rx type, which no receiver looks at, so older
+ * End Devices ignore the flag. Nothing the AP sends is a Join request.
+ */
+
 #ifdef SMPL_SECURE
 
 #define F_SECURE_OS       3
@@ -88,6 +100,7 @@
 #define F_ACK_RPLY_TYPE          0x08
 #define F_FRAME_FWD_TYPE         0x80
 #define F_FRAME_ENCRYPT_TYPE     0x40
+#define F_MORE_PEND_TYPE         0x40    /* more frames held for the poller */
 
 /* device type fields */
 #define F_TX_DEVICE_ED           0x00    /* End Device */
@@ -103,12 +116,25 @@
 #define PUT_INTO_FRAME(b,f,v)  do {(b)[f] = ((b)[f] & ~(f##_MSK)) | (v); } while(0)
 
 
+/* multicast groups. A group address is the broadcast address with the group
+ * number in the last byte. Groups 0 to NWK_GROUPS-1 can be joined. Group
+ * frames go to the UUD port.
+ */
+#ifndef NWK_GROUPS
+#define NWK_GROUPS          16
+#endif
+#define NWK_GROUP_ADDR_OS   (NET_ADDR_SIZE-1)
+
+#if NWK_GROUPS > 255
+#error ERROR: NWK_GROUPS must be 255 or less. group 255 is the broadcast address.
+#endif
+
 /*       ****   frame information objects
  * info kept on each frame object
  */
 #define   FI_AVAILABLE         0   /* entry available for use */
 #define   FI_INUSE_UNTIL_DEL   1   /* in use. will be explicitly reclaimed */
-#define   FI_INUSE_UNTIL_TX    2   /* in use. will be reclaimed after Tx */
+#define   FI_INUSE_UNTIL_TX    2   /* in use. queued for Tx. will be reclaimed after Tx */
 #define   FI_INUSE_UNTIL_FWD   3   /* in use until forwarded by AP */
 #define   FI_INUSE_TRANSITION  4   /* being retrieved. do not delete in Rx ISR thread. */
 
@@ -118,10 +144,17 @@ typedef struct
   uint8_t   lqi;
 } sigInfo_t;
 
+/* Rx queue entries are also linked onto their port or link queue (qid, qNext)
+ * and onto an age list used for the LRU cast-out (ageOlder, ageNewer). The
+ * links are indices into the input frame queue. Unused for the output queue.
+ */
 typedef struct
 {
   volatile uint8_t      fi_usage;
-           uint8_t      orderStamp;
+           uint8_t      qid;
+           uint8_t      qNext;
+           uint8_t      ageOlder;
+           uint8_t      ageNewer;
            mrfiPacket_t mrfiPkt;
 } frameInfo_t;
 
@@ -131,20 +164,37 @@ frameInfo_t  *nwk_buildFrame(uint8_t, uint8_t *msg, uint8_t len, uint8_t hops);
 #ifdef APP_AUTO_ACK
 frameInfo_t  *nwk_buildAckReqFrame(uint8_t, uint8_t *, uint8_t, uint8_t, volatile uint8_t *);
 #endif
+frameInfo_t  *nwk_buildConnFrame(connInfo_t *, uint8_t *, uint8_t, volatile uint8_t *);
+void          nwk_dropHdrTemplate(connInfo_t *);
 void          nwk_receiveFrame(void);
 void          nwk_frameInit(uint8_t (*)(linkID_t));
 smplStatus_t  nwk_retrieveFrame(rcvContext_t *, uint8_t *, uint8_t *, addr_t *, uint8_t *);
+smplStatus_t  nwk_retrieveFrameView(rcvContext_t *, rxFrameView_t *);
+void          nwk_releaseFrameView(rxFrameView_t *);
 smplStatus_t  nwk_sendFrame(frameInfo_t *, uint8_t txOption);
-frameInfo_t  *nwk_getSandFFrame(mrfiPacket_t *, uint8_t);
+uint8_t       nwk_queueFrame(frameInfo_t *, uint8_t txOption, void (*)(uint8_t, smplStatus_t));
+void          nwk_drainTxQueue(void);
+uint8_t       nwk_txPending(void);
+smplStatus_t  nwk_txStatus(uint8_t);
+frameInfo_t  *nwk_getSandFFrame(const uint8_t *, uint8_t, const uint8_t *, uint8_t *);
 uint8_t       nwk_getMyRxType(void);
+#ifdef MRFI_TIMESTAMP
+uint32_t      nwk_getRxTimestamp(void);
+#endif
 void          nwk_SendEmptyPollRspFrame(mrfiPacket_t *);
+#if !defined(SMPL_SECURE)
+smplStatus_t  nwk_setFastPath(linkID_t, rxFastPath_t);
+#endif
+void          nwk_setGroup(uint8_t, uint8_t);
 #ifdef APP_AUTO_ACK
 void          nwk_sendAckReply(mrfiPacket_t *, uint8_t);
 #endif
 
 #ifndef END_DEVICE
 /* only APs and REs repeat frames */
-void  nwk_replayFrame(frameInfo_t *);
+void     nwk_replayFrame(frameInfo_t *);
+uint8_t  nwk_replayFrameNow(frameInfo_t *);
+void     nwk_getRelayCounts(uint16_t *, uint16_t *);
 #endif
 
 
@@ -88,6 +88,8 @@ enum ioctlAction  {
   IOCTL_ACT_RADIO_RXON,
   IOCTL_ACT_RADIO_RXIDLE,
   IOCTL_ACT_RADIO_SETPWR,
+  IOCTL_ACT_RADIO_RX_TIMESTAMP,
+  IOCTL_ACT_RADIO_TX_TIMESTAMP,
   IOCTL_ACT_ON,
   IOCTL_ACT_OFF,
   IOCTL_ACT_SCAN,
@@ -140,6 +142,26 @@ typedef struct
   rxMetrics_t  sigInfo;
 } ioctlRadioSiginfo_t;
 
+/* Zero-copy receive. The pointers refer to the received frame in the input
+ * frame queue which is held until the view is released.
+ */
+typedef struct
+{
+  const uint8_t *msg;        /* application payload */
+        uint8_t  len;        /* application payload length */
+  const addr_t  *srcAddr;    /* source address */
+        uint8_t  hopCount;
+  rxMetrics_t    sigInfo;
+  void          *frame;      /* frame buffer held by this view. NWK use only */
+} rxFrameView_t;
+
+/* Rx fast path hook. Called in the Rx ISR thread for a frame on the link it is
+ * registered for, with the application payload in place and the radio Rx
+ * timestamp (0 without MRFI_TIMESTAMP). Return non-zero to consume the frame:
+ * it is then not queued and the payload pointer is dead on return.
+ */
+typedef uint8_t (*rxFastPath_t)(linkID_t, const uint8_t *, uint8_t, uint32_t);
+
 
 /*                      *** Begin SET/GET token support ***                */
 enum tokenType
@@ -195,10 +217,12 @@ typedef uint8_t  secFCS_t;
  * the caller can either copy to or from the address. Note that this is a dangerous
  * interface, as the caller is provided with direct access to the connection context.
  *
- * When restoring the connection context some sanity checks are possible. If the
- * version or length elements of the saved context do not match those of the current
- * static object the static object should not be populated. If this sanity fails the
- * caller is not provided with the pointer to the conneciton ocntext.
+ * When restoring the connection context some sanity checks are possible. On a SET
+ * the caller supplies the saved version, length and a pointer to the saved image. If
+ * the version or length elements of the saved context do not match those of the current
+ * static object the static object is not populated. Otherwise the image is copied in
+ * and the join and link tokens, AP address and channel saved with it are restored.
+ * SMPL_Resume() does this in place of joining.
  *
  * This interface is fairly simple and it is possible to get the address of the
  * connection context to do a restore by simply doing a GET call. This avoids the
@@ -232,7 +256,8 @@ enum smplStatus  {
   SMPL_TX_CCA_FAIL,
   SMPL_NO_PAYLOAD,
   SMPL_NO_AP_ADDRESS,
-  SMPL_NO_ACK
+  SMPL_NO_ACK,
+  SMPL_TX_PENDING
 };
 
 typedef enum smplStatus    smplStatus_t;
@@ -252,6 +277,7 @@ enum rcvType
 {
   RCV_NWK_PORT,
   RCV_APP_LID,
+  RCV_APP_ANY,          /* any peer link. the Link ID is returned in t.lid */
   RCV_RAW_POLL_FRAME
 };
 
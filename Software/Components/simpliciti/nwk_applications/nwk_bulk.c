@@ -0,0 +1,521 @@
+/**************************************************************************************************
+  Filename:       nwk_bulk.c
+
+  Description:    This file supports the SimpliciTI Bulk transfer network application.
+**************************************************************************************************/
+
+/******************************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+#include "bsp.h"
+#include "mrfi.h"
+#include "nwk_types.h"
+#include "nwk_frame.h"
+#include "nwk.h"
+#include "nwk_globals.h"
+#include "nwk_bulk.h"
+#include "nwk_security.h"
+
+/*                   *** BULK TRANSFER OUTLINE ***
+ *
+ * The sender splits the payload into BULK_SEG_SIZE segments numbered from 0.
+ * Every data frame carries the transfer ID, the segment number and the total
+ * length so the receiver can start reassembly from any segment. Segments are
+ * sent in bursts covering a window of BULK_WINDOW segments starting at the
+ * first segment the receiver is still missing. The last frame of a burst asks
+ * for a status frame, which carries the new window base and a bitmap of the
+ * segments received in the window. The next burst resends only the holes
+ * (selective NACK) and fills the rest of the window with new segments. If the
+ * asking frame or the status is lost the sender learns nothing and sends the
+ * same burst again. It gives up after BULK_RETRIES such bursts in a row.
+ *
+ * The receiver reassembles one transfer at a time in the Rx ISR thread. A
+ * finished transfer is held until the application takes it and releases it.
+ */
+
+/******************************************************************************
+ * MACROS
+ */
+
+/******************************************************************************
+ * CONSTANTS AND DEFINES
+ */
+
+/* status requests in a row with no reply before the sender gives up */
+#define BULK_RETRIES        5
+
+/* frames from other senders turned away before a transfer that seems to have
+ * been abandoned is dropped.
+ */
+#define BULK_STALE_LIMIT    32
+
+/* receiver states */
+#define BULK_RX_IDLE        0
+#define BULK_RX_ACTIVE      1
+#define BULK_RX_DONE        2
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+
+/******************************************************************************
+ * LOCAL VARIABLES
+ */
+
+static uint8_t sXid = 0;
+
+#ifdef MAX_BULK_PAYLOAD
+/* sender. the status fields are written in the Rx ISR thread. */
+static volatile uint8_t sTxActive = 0;
+static          uint8_t sTxPeer[NET_ADDR_SIZE];
+static volatile uint8_t sTxReply;
+static volatile uint8_t sTxBase;
+static volatile uint8_t sTxMap;
+
+/* receiver. the peer and transfer ID are kept after the application releases
+ * the transfer so a late status request for it can still be answered.
+ */
+static volatile uint8_t sRxState = BULK_RX_IDLE;
+static          uint8_t sRxPeer[NET_ADDR_SIZE];
+static          uint8_t sRxXid;
+static          uint16_t sRxLen;
+static          uint8_t sRxSegs;
+static          uint8_t sRxBase;
+static          uint8_t sRxStale;
+static          uint8_t sRxMap[(BULK_MAX_SEGS + 7) / 8];
+static          uint8_t sRxBuf[MAX_BULK_PAYLOAD];
+#endif  /* MAX_BULK_PAYLOAD */
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ */
+#ifdef MAX_BULK_PAYLOAD
+static smplStatus_t sendSegment(connInfo_t *, const uint8_t *, uint16_t, uint8_t, uint8_t);
+static void         handleData(mrfiPacket_t *);
+static void         handleStatus(mrfiPacket_t *);
+static void         sendStatus(mrfiPacket_t *, uint8_t);
+#endif  /* MAX_BULK_PAYLOAD */
+
+/******************************************************************************
+ * GLOBAL VARIABLES
+ */
+
+/******************************************************************************
+ * GLOBAL FUNCTIONS
+ */
+
+/******************************************************************************
+ * @fn          nwk_bulkInit
+ *
+ * @brief       Initialize Bulk transfer application.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+void nwk_bulkInit(void)
+{
+  sXid = MRFI_RandomByte();
+
+#ifdef MAX_BULK_PAYLOAD
+  sTxActive = 0;
+  sRxState  = BULK_RX_IDLE;
+  memset(sRxPeer, 0x0, sizeof(sRxPeer));
+#endif
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          nwk_processBulk
+ *
+ * @brief       Bulk transfer network application frame handler. Data frames
+ *              are reassembled and status frames update the sender. Both are
+ *              handled here in the Rx ISR thread.
+ *
+ * input parameters
+ * @param   frame   - pointer to frame in question
+ *
+ * output parameters
+ *
+ * @return    Release frame or replay frame.
+ */
+fhStatus_t nwk_processBulk(mrfiPacket_t *frame)
+{
+  /* not for us. pass it on if we can. */
+  if (memcmp(MRFI_P_DST_ADDR(frame), nwk_getMyAddress(), NET_ADDR_SIZE))
+  {
+    return FHS_REPLAY;
+  }
+
+#ifdef MAX_BULK_PAYLOAD
+  if (BULK_REQ_DATA == (*(MRFI_P_PAYLOAD(frame)+F_APP_PAYLOAD_OS+BB_REQ_OS) & BULK_REQ_MSK))
+  {
+    handleData(frame);
+  }
+  else
+  {
+    handleStatus(frame);
+  }
+#endif  /* MAX_BULK_PAYLOAD */
+
+  return FHS_RELEASE;
+}
+
+#ifdef MAX_BULK_PAYLOAD
+/******************************************************************************
+ * @fn          nwk_bulkSend
+ *
+ * @brief       Send a payload of up to MAX_BULK_PAYLOAD bytes to a peer. Does
+ *              not return until the peer has all of it or has stopped
+ *              answering.
+ *
+ * input parameters
+ * @param   lid     - Link ID representing the peer
+ * @param   data    - payload
+ * @param   len     - length of payload
+ *
+ * output parameters
+ *
+ * @return   SMPL_SUCCESS     peer has the whole payload
+ *           SMPL_BAD_PARAM   bad Link ID, or no payload or too long
+ *           SMPL_NOMEM       peer is holding another transfer
+ *           SMPL_TIMEOUT     peer stopped answering
+ */
+smplStatus_t nwk_bulkSend(linkID_t lid, const uint8_t *data, uint16_t len)
+{
+  connInfo_t *pCInfo     = nwk_getConnInfo(lid);
+  uint8_t     radioState = MRFI_GetRadioState();
+  uint8_t     segs, base = 0, map = 0, last, i;
+  uint8_t     tries = 0, busy = 0;
+
+  if (!pCInfo || (SMPL_LINKID_USER_UUD == lid) || !data || !len || (len > MAX_BULK_PAYLOAD))
+  {
+    return SMPL_BAD_PARAM;
+  }
+
+  segs = (len + BULK_SEG_SIZE - 1) / BULK_SEG_SIZE;
+  sXid++;
+  memcpy(sTxPeer, pCInfo->peerAddr, NET_ADDR_SIZE);
+  sTxActive = 1;
+
+  while (base < segs)
+  {
+    /* the last segment of the window still to be sent asks for the status */
+    last = base;
+    for (i=0; (i<BULK_WINDOW) && (base+i < segs); ++i)
+    {
+      if (!(map & (1 << i)))
+      {
+        last = base + i;
+      }
+    }
+
+    sTxReply = 0;
+    for (i=0; (i<BULK_WINDOW) && (base+i < segs); ++i)
+    {
+      if (!(map & (1 << i)))
+      {
+        /* a segment lost to CCA failure just shows up as a hole */
+        sendSegment(pCInfo, data, len, base+i, (base+i) == last);
+      }
+    }
+
+    NWK_CHECK_FOR_SETRX(radioState);
+    NWK_REPLY_DELAY();
+    NWK_CHECK_FOR_RESTORE_STATE(radioState);
+
+    if (BULK_REQ_STATUS == sTxReply)
+    {
+      base  = sTxBase;
+      map   = sTxMap;
+      tries = 0;
+      busy  = 0;
+    }
+    else if (++tries > BULK_RETRIES)
+    {
+      break;
+    }
+    else
+    {
+      busy = (BULK_REQ_BUSY == sTxReply);
+    }
+  }
+
+  sTxActive = 0;
+
+  if (base >= segs)
+  {
+    return SMPL_SUCCESS;
+  }
+
+  return busy ? SMPL_NOMEM : SMPL_TIMEOUT;
+}
+
+/******************************************************************************
+ * @fn          nwk_bulkReceive
+ *
+ * @brief       Get the transfer that has been reassembled, if there is one.
+ *              The payload is not copied. It stays valid until
+ *              nwk_bulkRelease() is called, and no other transfer is accepted
+ *              until then.
+ *
+ * input parameters
+ *
+ * output parameters
+ * @param   srcAddr - sender's address. may be NULL.
+ * @param   data    - pointer to payload
+ * @param   len     - length of payload
+ *
+ * @return   SMPL_SUCCESS
+ *           SMPL_NO_FRAME   no transfer complete
+ */
+smplStatus_t nwk_bulkReceive(addr_t *srcAddr, const uint8_t **data, uint16_t *len)
+{
+  if (BULK_RX_DONE != sRxState)
+  {
+    return SMPL_NO_FRAME;
+  }
+
+  if (srcAddr)
+  {
+    memcpy(srcAddr, sRxPeer, NET_ADDR_SIZE);
+  }
+  *data = sRxBuf;
+  *len  = sRxLen;
+
+  return SMPL_SUCCESS;
+}
+
+/******************************************************************************
+ * @fn          nwk_bulkRelease
+ *
+ * @brief       Done with the transfer from nwk_bulkReceive(). The receiver is
+ *              free for the next one.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+void nwk_bulkRelease(void)
+{
+  sRxState = BULK_RX_IDLE;
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          sendSegment
+ *
+ * @brief       Send one data frame. The segment is copied straight into the
+ *              frame after the header.
+ *
+ * input parameters
+ * @param   pCInfo  - connection to peer
+ * @param   data    - payload
+ * @param   len     - length of payload
+ * @param   seq     - segment number
+ * @param   poll    - non-zero to ask the peer for a status frame
+ *
+ * output parameters
+ *
+ * @return   SMPL_SUCCESS, SMPL_NOMEM or SMPL_TX_CCA_FAIL
+ */
+static smplStatus_t sendSegment(connInfo_t *pCInfo, const uint8_t *data, uint16_t len, uint8_t seq, uint8_t poll)
+{
+  frameInfo_t *pOutFrame;
+  uint8_t      hdr[BD_DATA_OS];
+  uint16_t     os   = (uint16_t)seq * BULK_SEG_SIZE;
+  uint8_t      size = ((len - os) < BULK_SEG_SIZE) ? (len - os) : BULK_SEG_SIZE;
+
+  hdr[BB_REQ_OS]   = BULK_REQ_DATA | (poll ? BULK_POLL_BIT : 0);
+  hdr[BB_XID_OS]   = sXid;
+  hdr[BD_SEQ_OS]   = seq;
+  hdr[BD_LEN_OS]   = len & 0xFF;
+  hdr[BD_LEN_OS+1] = len >> 8;
+
+  if (!(pOutFrame = nwk_buildFrame(SMPL_PORT_BULK, hdr, sizeof(hdr), pCInfo->hops2target)))
+  {
+    return SMPL_NOMEM;
+  }
+
+  memcpy(MRFI_P_PAYLOAD(&pOutFrame->mrfiPkt)+F_APP_PAYLOAD_OS+BD_DATA_OS, data+os, size);
+  MRFI_SET_PAYLOAD_LEN(&pOutFrame->mrfiPkt, F_APP_PAYLOAD_OS+BD_DATA_OS+size);
+  memcpy(MRFI_P_DST_ADDR(&pOutFrame->mrfiPkt), pCInfo->peerAddr, NET_ADDR_SIZE);
+#ifdef SMPL_SECURE
+  nwk_setSecureFrame(&pOutFrame->mrfiPkt, BD_DATA_OS+size, 0);
+#endif  /* SMPL_SECURE */
+
+  return nwk_sendFrame(pOutFrame, MRFI_TX_TYPE_CCA);
+}
+
+/******************************************************************************
+ * @fn          handleData
+ *
+ * @brief       Store a data segment and answer a status request.
+ *
+ * input parameters
+ * @param   frame   - pointer to data frame
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+static void handleData(mrfiPacket_t *frame)
+{
+  uint8_t  *msg   = MRFI_P_PAYLOAD(frame)+F_APP_PAYLOAD_OS;
+  uint8_t   len   = MRFI_GET_PAYLOAD_LEN(frame) - F_APP_PAYLOAD_OS;
+  uint8_t   seq   = msg[BD_SEQ_OS];
+  uint16_t  total = msg[BD_LEN_OS] | ((uint16_t)msg[BD_LEN_OS+1] << 8);
+  uint16_t  os;
+
+  if (len < BD_DATA_OS)
+  {
+    return;
+  }
+  len -= BD_DATA_OS;
+
+  if ((msg[BB_XID_OS] != sRxXid) || memcmp(sRxPeer, MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE))
+  {
+    /* A new transfer. Take it if we're free, if it's from the sender of the
+     * transfer in progress (which it must have given up on) or if the transfer
+     * in progress seems to have been abandoned. A finished transfer waits for
+     * the application.
+     */
+    if ((BULK_RX_DONE == sRxState) ||
+        ((BULK_RX_ACTIVE == sRxState) &&
+         memcmp(sRxPeer, MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE) &&
+         (++sRxStale < BULK_STALE_LIMIT)))
+    {
+      if (msg[BB_REQ_OS] & BULK_POLL_BIT)
+      {
+        sendStatus(frame, BULK_REQ_BUSY);
+      }
+      return;
+    }
+    if (!total || (total > MAX_BULK_PAYLOAD))
+    {
+      return;
+    }
+    memcpy(sRxPeer, MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE);
+    sRxXid   = msg[BB_XID_OS];
+    sRxLen   = total;
+    sRxSegs  = (total + BULK_SEG_SIZE - 1) / BULK_SEG_SIZE;
+    sRxBase  = 0;
+    memset(sRxMap, 0x0, sizeof(sRxMap));
+    sRxState = BULK_RX_ACTIVE;
+  }
+  sRxStale = 0;
+
+  /* keep the segment unless we have it already. a transfer that is done
+   * (or already released) just gets the status.
+   */
+  if ((BULK_RX_ACTIVE == sRxState) && (seq < sRxSegs) && !(sRxMap[seq >> 3] & (1 << (seq & 7))))
+  {
+    os = (uint16_t)seq * BULK_SEG_SIZE;
+    if (len == (((sRxLen - os) < BULK_SEG_SIZE) ? (sRxLen - os) : BULK_SEG_SIZE))
+    {
+      memcpy(&sRxBuf[os], msg+BD_DATA_OS, len);
+      sRxMap[seq >> 3] |= 1 << (seq & 7);
+      while ((sRxBase < sRxSegs) && (sRxMap[sRxBase >> 3] & (1 << (sRxBase & 7))))
+      {
+        sRxBase++;
+      }
+      if (sRxBase == sRxSegs)
+      {
+        sRxState = BULK_RX_DONE;
+      }
+    }
+  }
+
+  if (msg[BB_REQ_OS] & BULK_POLL_BIT)
+  {
+    sendStatus(frame, BULK_REQ_STATUS);
+  }
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          handleStatus
+ *
+ * @brief       Pass a status frame for the transfer we're sending to the
+ *              sender and end its wait.
+ *
+ * input parameters
+ * @param   frame   - pointer to status frame
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+static void handleStatus(mrfiPacket_t *frame)
+{
+  uint8_t *msg = MRFI_P_PAYLOAD(frame)+F_APP_PAYLOAD_OS;
+
+  if (sTxActive && (msg[BB_XID_OS] == sXid) &&
+      ((MRFI_GET_PAYLOAD_LEN(frame) - F_APP_PAYLOAD_OS) >= BULK_STATUS_FRAME_SIZE) &&
+      !memcmp(sTxPeer, MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE))
+  {
+    sTxBase  = msg[BS_BASE_OS];
+    sTxMap   = msg[BS_MAP_OS];
+    sTxReply = msg[BB_REQ_OS] & BULK_REQ_MSK;
+    MRFI_PostKillSem();
+  }
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          sendStatus
+ *
+ * @brief       Send the receiver's progress on a transfer to its sender.
+ *
+ * input parameters
+ * @param   frame   - pointer to the data frame asking for it
+ * @param   type    - BULK_REQ_STATUS or BULK_REQ_BUSY
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+static void sendStatus(mrfiPacket_t *frame, uint8_t type)
+{
+  frameInfo_t *pOutFrame;
+  uint8_t      msg[BULK_STATUS_FRAME_SIZE];
+  uint8_t      i;
+
+  msg[BB_REQ_OS]  = type;
+  msg[BB_XID_OS]  = *(MRFI_P_PAYLOAD(frame)+F_APP_PAYLOAD_OS+BB_XID_OS);
+  msg[BS_BASE_OS] = 0;
+  msg[BS_MAP_OS]  = 0;
+  if (BULK_REQ_STATUS == type)
+  {
+    msg[BS_BASE_OS] = sRxBase;
+    for (i=0; (i<BULK_WINDOW) && (sRxBase+i < sRxSegs); ++i)
+    {
+      if (sRxMap[(sRxBase+i) >> 3] & (1 << ((sRxBase+i) & 7)))
+      {
+        msg[BS_MAP_OS] |= 1 << i;
+      }
+    }
+  }
+
+  if (pOutFrame = nwk_buildFrame(SMPL_PORT_BULK, msg, sizeof(msg), MAX_HOPS))
+  {
+    /* destination address is the source adddress of the received frame. */
+    memcpy(MRFI_P_DST_ADDR(&pOutFrame->mrfiPkt), MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE);
+#ifdef SMPL_SECURE
+    nwk_setSecureFrame(&pOutFrame->mrfiPkt, sizeof(msg), 0);
+#endif  /* SMPL_SECURE */
+    nwk_sendFrame(pOutFrame, MRFI_TX_TYPE_FORCED);
+  }
+
+  return;
+}
+#endif  /* MAX_BULK_PAYLOAD */
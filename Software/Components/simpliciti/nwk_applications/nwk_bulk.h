@@ -0,0 +1,60 @@
+/**************************************************************************************************
+  Filename:       nwk_bulk.h
+
+  Description:    This file supports the SimpliciTI Bulk transfer network application.
+                  Payloads larger than MAX_APP_PAYLOAD are sent as numbered segments
+                  with a sliding window and reassembled by the receiver.
+**************************************************************************************************/
+
+#ifndef NWK_BULK_H
+#define NWK_BULK_H
+
+/* bulk requests. the poll bit may be set on a data frame to ask the
+ * receiver for a status frame right away.
+ */
+#define BULK_REQ_DATA       0x01
+#define BULK_REQ_STATUS     0x02   /* receiver progress */
+#define BULK_REQ_BUSY       0x03   /* receiver is holding another transfer */
+#define BULK_REQ_MSK        0x0F
+#define BULK_POLL_BIT       0x40
+
+/* application payload offsets */
+/*    both */
+#define BB_REQ_OS           0
+#define BB_XID_OS           1
+
+/*    data frame */
+#define BD_SEQ_OS           2
+#define BD_LEN_OS           3      /* total transfer length, 2 bytes LSB first */
+#define BD_DATA_OS          5
+
+/*    status frame */
+#define BS_BASE_OS          2      /* first segment not yet received */
+#define BS_MAP_OS           3      /* bit n set if segment base+n was received */
+
+#define BULK_STATUS_FRAME_SIZE   4
+
+/* segment payload size and number of segments in flight. the status bitmap
+ * is one byte so the window can't be larger than 8.
+ */
+#define BULK_SEG_SIZE       (MAX_APP_PAYLOAD - BD_DATA_OS)
+#define BULK_WINDOW         8
+
+#ifdef MAX_BULK_PAYLOAD
+#define BULK_MAX_SEGS       ((MAX_BULK_PAYLOAD + BULK_SEG_SIZE - 1) / BULK_SEG_SIZE)
+
+#if BULK_MAX_SEGS > 255
+#error ERROR: MAX_BULK_PAYLOAD needs more than 255 segments
+#endif
+#endif  /* MAX_BULK_PAYLOAD */
+
+/* prototypes */
+void         nwk_bulkInit(void);
+fhStatus_t   nwk_processBulk(mrfiPacket_t *);
+#ifdef MAX_BULK_PAYLOAD
+smplStatus_t nwk_bulkSend(linkID_t, const uint8_t *, uint16_t);
+smplStatus_t nwk_bulkReceive(addr_t *, const uint8_t **, uint16_t *);
+void         nwk_bulkRelease(void);
+#endif  /* MAX_BULK_PAYLOAD */
+
+#endif
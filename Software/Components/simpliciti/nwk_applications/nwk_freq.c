@@ -288,7 +288,8 @@ static void replayFirst(mrfiPacket_t *frame)
 
   fiptr = (frameInfo_t *)(((uint8_t *)frame) - ((uint8_t *)offset));
 
-  nwk_replayFrame(fiptr);
+  /* no jitter. it has to go out before we change channel. */
+  nwk_replayFrameNow(fiptr);
 
   return;
 }
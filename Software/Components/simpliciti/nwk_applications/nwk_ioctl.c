@@ -241,6 +241,18 @@ smplStatus_t nwk_radioControl(ioctlAction_t action, void *val)
     return SMPL_SUCCESS;
   }
 #endif  /* EXTENDED_API */
+#ifdef MRFI_TIMESTAMP
+  else if (IOCTL_ACT_RADIO_RX_TIMESTAMP == action)
+  {
+    /* frame most recently returned by SMPL_Receive() */
+    *((uint32_t *)val) = nwk_getRxTimestamp();
+  }
+  else if (IOCTL_ACT_RADIO_TX_TIMESTAMP == action)
+  {
+    /* frame most recently sent */
+    *((uint32_t *)val) = MRFI_TxTimestamp();
+  }
+#endif  /* MRFI_TIMESTAMP */
   else
   {
     rc = SMPL_BAD_PARAM;
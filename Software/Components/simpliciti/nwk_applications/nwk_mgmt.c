@@ -56,6 +56,17 @@
 /******************************************************************************
  * CONSTANTS AND DEFINES
  */
+/* Frames a polling device asks for in one poll. They all land on the polled
+ * link's queue before the application gets the first one.
+ */
+#ifndef SANDF_POLL_BATCH
+#define SANDF_POLL_BATCH  SIZE_INFRAME_Q
+#endif
+
+/* Gap between the frames of a poll reply batch. Time for the client to empty
+ * its Rx FIFO.
+ */
+#define POLL_BATCH_GAP_MS  1
 
 /******************************************************************************
  * TYPEDEFS
@@ -66,8 +77,24 @@
  */
 #ifndef ACCESS_POINT
 static addr_t const *sAPAddr = NULL;
+
+/* poll replies received since the last poll, and the AP's more pending flag
+ * on the latest one. set in the Rx ISR thread.
+ */
+static volatile uint8_t sPollRcvd = 0;
+static volatile uint8_t sPollMore = 0;
 #else
 static uint8_t sSFMarker[NUM_STORE_AND_FWD_CLIENTS] = {0};
+
+/* the rest of a poll reply batch: who polled, the port and source address
+ * asked for, and the frames still to send. One batch at a time. The frames go
+ * out from the timer ISR so the Rx ISR doesn't wait out the gaps.
+ */
+static uint8_t    sBatchClient[NET_ADDR_SIZE];
+static uint8_t    sBatchAddr[NET_ADDR_SIZE];
+static uint8_t    sBatchPort;
+static uint8_t    sBatchLeft = 0;
+static bspTimer_t sBatchTimer;
 #endif
 
 static volatile uint8_t sTid = 0;
@@ -78,6 +105,8 @@ static volatile uint8_t sTid = 0;
 static void  smpl_send_mgmt_reply(mrfiPacket_t *);
 #ifdef ACCESS_POINT
 static void  send_poll_reply(mrfiPacket_t *);
+static void  send_held_frame(frameInfo_t *, uint8_t);
+static void  batchTimeout(void);
 #endif
 
 /******************************************************************************
@@ -218,7 +247,10 @@ static void send_poll_reply(mrfiPacket_t *frame)
   uint8_t         msgtid = *(MRFI_P_PAYLOAD(frame)+F_APP_PAYLOAD_OS+MB_TID_OS);
   frameInfo_t    *pOutFrame;
   sfClientInfo_t *pClientInfo;
-  uint8_t         loc;
+  uint8_t         port   = *(MRFI_P_PAYLOAD(frame)+F_APP_PAYLOAD_OS+M_POLL_PORT_OS);
+  uint8_t        *pAddr  = MRFI_P_PAYLOAD(frame)+F_APP_PAYLOAD_OS+M_POLL_ADDR_OS;
+  uint8_t         loc, more;
+  uint8_t         batch  = 1;
 
   /* Make sure this guy is really a client. We can tell from the source address. */
   if (!(pClientInfo=nwk_isSandFClient(MRFI_P_SRC_ADDR(frame), &loc)))
@@ -253,26 +285,96 @@ static void send_poll_reply(mrfiPacket_t *frame)
     return;
   }
 
-  if (pOutFrame = nwk_getSandFFrame(frame, M_POLL_PORT_OS))
+  /* newer clients say how many frames they can take */
+  if ((MRFI_GET_PAYLOAD_LEN(frame) - F_APP_PAYLOAD_OS) >= MGMT_POLL_FRAME_SIZE)
   {
-    /* We need to adjust the order in the queue in this case. Currently
-     * we know it is in the input queue and that this adjustment is safe
-     * because we're in an ISR thread. This is a fragile fix, though, and
-     * should be revisited when time permits.
-     */
-    nwk_QadjustOrder(INQ, pOutFrame->orderStamp);
+    batch = *(MRFI_P_PAYLOAD(frame)+F_APP_PAYLOAD_OS+M_POLL_BATCH_OS);
+  }
+
+  if (!(pOutFrame = nwk_getSandFFrame(MRFI_P_SRC_ADDR(frame), port, pAddr, &more)))
+  {
+    nwk_SendEmptyPollRspFrame(frame);
+    return;
+  }
 
-    /* reset hop count... */
-    PUT_INTO_FRAME(MRFI_P_PAYLOAD(&pOutFrame->mrfiPkt), F_HOP_COUNT, MAX_HOPS_FROM_AP);
-    /* It's gonna be a forwarded frame. */
-    PUT_INTO_FRAME(MRFI_P_PAYLOAD(&pOutFrame->mrfiPkt), F_FWD_FRAME, 0x80);
+  /* each frame says whether more are held so the client stays awake for them
+   * or polls again. The rest of the batch follows from the timer.
+   */
+  send_held_frame(pOutFrame, more);
 
-    nwk_sendFrame(pOutFrame, MRFI_TX_TYPE_FORCED);
+  if (more && (batch > 1) && !sBatchLeft)
+  {
+    memcpy(sBatchClient, MRFI_P_SRC_ADDR(frame), NET_ADDR_SIZE);
+    memcpy(sBatchAddr, pAddr, NET_ADDR_SIZE);
+    sBatchPort = port;
+    sBatchLeft = batch - 1;
+    BSP_TimerArm(&sBatchTimer, BSP_TimerNow() + POLL_BATCH_GAP_MS * BSP_TIMER_TICKS_PER_MS, batchTimeout);
   }
-  else
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          send_held_frame
+ *
+ * @brief       Send a frame taken from the store-and-forward pool to the
+ *              client that polled for it.
+ *
+ * input parameters
+ * @param  pOutFrame  - the frame
+ * @param  more       - non-zero if more frames are held for the client
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+static void send_held_frame(frameInfo_t *pOutFrame, uint8_t more)
+{
+  /* reset hop count... */
+  PUT_INTO_FRAME(MRFI_P_PAYLOAD(&pOutFrame->mrfiPkt), F_HOP_COUNT, MAX_HOPS_FROM_AP);
+  /* It's gonna be a forwarded frame. */
+  PUT_INTO_FRAME(MRFI_P_PAYLOAD(&pOutFrame->mrfiPkt), F_FWD_FRAME, 0x80);
+  PUT_INTO_FRAME(MRFI_P_PAYLOAD(&pOutFrame->mrfiPkt), F_MORE_PEND, more ? F_MORE_PEND_TYPE : 0);
+
+  nwk_sendFrame(pOutFrame, MRFI_TX_TYPE_FORCED);
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          batchTimeout
+ *
+ * @brief       Send the next frame of a poll reply batch. Runs in the timer
+ *              ISR thread. If it interrupted a send the frame waits another
+ *              gap: the radio can't be waited for here.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+static void batchTimeout(void)
+{
+  frameInfo_t *pOutFrame;
+  uint8_t      more;
+
+  if (!MRFI_TxBusy())
   {
-    nwk_SendEmptyPollRspFrame(frame);
+    if (!(pOutFrame = nwk_getSandFFrame(sBatchClient, sBatchPort, sBatchAddr, &more)))
+    {
+      sBatchLeft = 0;
+      return;
+    }
+    send_held_frame(pOutFrame, more);
+
+    if (!more || !--sBatchLeft)
+    {
+      sBatchLeft = 0;
+      return;
+    }
   }
+  BSP_TimerArm(&sBatchTimer, BSP_TimerNow() + POLL_BATCH_GAP_MS * BSP_TIMER_TICKS_PER_MS, batchTimeout);
 
   return;
 }
@@ -323,6 +425,10 @@ smplStatus_t nwk_poll(uint8_t port, uint8_t *addr)
   msg[MB_TID_OS]      = sTid;
   msg[M_POLL_PORT_OS] = port;
   memcpy(msg+M_POLL_ADDR_OS, addr, NET_ADDR_SIZE);
+  msg[M_POLL_BATCH_OS] = SANDF_POLL_BATCH;
+
+  sPollRcvd = 0;
+  sPollMore = 0;
 
   /* it's OK to increment the TID here because the reply will not be
    * matched based on this number. The reply to the poll comes back
@@ -346,4 +452,52 @@ smplStatus_t nwk_poll(uint8_t port, uint8_t *addr)
   return SMPL_Ioctl(IOCTL_OBJ_RAW_IO, IOCTL_ACT_WRITE, &send);
 }
 
+/******************************************************************************
+ * @fn          nwk_pollReplyRcvd
+ *
+ * @brief       Count a poll reply frame from the AP and note whether the AP
+ *              is holding more. Runs in the Rx ISR thread.
+ *
+ * input parameters
+ * @param  frame  - the reply frame
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+void nwk_pollReplyRcvd(mrfiPacket_t *frame)
+{
+  sPollRcvd++;
+  sPollMore = GET_FROM_FRAME(MRFI_P_PAYLOAD(frame), F_MORE_PEND);
+
+  return;
+}
+
+/******************************************************************************
+ * @fn          nwk_pollWait
+ *
+ * @brief       Wait for the reply to a poll. Each reply delay ends early when
+ *              a frame arrives. Keep waiting while the AP says more frames are
+ *              coming in this batch so they are all taken in one wake-up.
+ *              Caller has the radio in Rx.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * @return   void
+ */
+void nwk_pollWait(void)
+{
+  uint8_t seen;
+
+  do
+  {
+    seen = sPollRcvd;
+    NWK_REPLY_DELAY();
+  } while (sPollMore && (sPollRcvd != seen) && (sPollRcvd < SANDF_POLL_BATCH));
+
+  return;
+}
+
 #endif /* ACCESS_POINT */
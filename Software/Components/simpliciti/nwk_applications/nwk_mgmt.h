@@ -41,7 +41,7 @@
 #define  MGMT_REQ_POLL        0x01
 
 /* change the following as protocol developed */
-#define MAX_MGMT_APP_FRAME    7
+#define MAX_MGMT_APP_FRAME    8
 
 /* application payload offsets */
 /*    both */
@@ -51,17 +51,20 @@
 /*    Poll frame */
 #define M_POLL_PORT_OS          2
 #define M_POLL_ADDR_OS          3
+#define M_POLL_BATCH_OS         7   /* most frames the poller can take in one reply */
 
 /* change the following as protocol developed */
-#define MAX_MGMT_APP_FRAME    7
+#define MAX_MGMT_APP_FRAME    8
 
-/* frame sizes */
-#define MGMT_POLL_FRAME_SIZE  7
+/* frame sizes. a 7 byte poll frame without the batch size asks for one frame. */
+#define MGMT_POLL_FRAME_SIZE  8
 
 /* prototypes */
 void         nwk_mgmtInit(void);
 fhStatus_t   nwk_processMgmt(mrfiPacket_t *);
 smplStatus_t nwk_poll(uint8_t, uint8_t *);
 void         nwk_resetSFMarker(uint8_t);
+void         nwk_pollReplyRcvd(mrfiPacket_t *);
+void         nwk_pollWait(void);
 
 #endif
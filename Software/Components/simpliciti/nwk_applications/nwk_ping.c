@@ -303,6 +303,10 @@ static void handlePingRequest(mrfiPacket_t *frame)
   switch (*(MRFI_P_PAYLOAD(frame)+F_APP_PAYLOAD_OS))
   {
     case PING_REQ_PING:
+      /* the peer may have restarted its transaction IDs, as a device
+       * resuming a saved link has. let its next frames start over.
+       */
+      nwk_resetPeerTIDs(MRFI_P_SRC_ADDR(frame));
       smpl_send_ping_reply(frame);
       break;
 
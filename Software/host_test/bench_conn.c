@@ -0,0 +1,76 @@
+/* Host timing of the connection table lookups in nwk.c: Link ID, peer
+ * address/port for sending (Tx) and for received frames (Rx), and an Rx
+ * miss, which is the worst case. The table is laid out as on the AP: EDs
+ * whose addresses differ only in the first byte, all linking from the same
+ * port and given descending Rx ports. Build with NUM_CONNECTIONS set to the
+ * table size. Host ns, not MSP430 cycles: they show how each lookup scales.
+ */
+#include <stdio.h>
+#include <time.h>
+#include "nwk.c"
+
+#define LOOKUPS   20000000L
+#define ED_PORT   0x3D
+
+static double nsNow(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int main(void)
+{
+  static linkID_t lids[NUM_CONNECTIONS];
+  static addr_t   peers[NUM_CONNECTIONS];
+  addr_t          stranger = {{0xA5, 0x5A, 0x34, 0x12}};
+  connInfo_t     *pCInfo;
+  volatile unsigned long found = 0;
+  double          t0, tLid, tTx, tRx, tMiss;
+  long            n;
+  int             i;
+
+  nwk_nwkInit(NULL);
+  for (i=0; i<NUM_CONNECTIONS; ++i)
+  {
+    pCInfo = nwk_getNextConnection();
+    peers[i].addr[0] = i + 1;
+    peers[i].addr[1] = 0x56;
+    peers[i].addr[2] = 0x34;
+    peers[i].addr[3] = 0x12;
+    memcpy(pCInfo->peerAddr, peers[i].addr, NET_ADDR_SIZE);
+    pCInfo->portTx = ED_PORT;
+    pCInfo->portRx = ED_PORT - i;
+    lids[i]        = pCInfo->thisLinkID;
+  }
+
+  t0 = nsNow();
+  for (n=0; n<LOOKUPS; ++n)
+  {
+    found += !!nwk_getConnInfo(lids[n % NUM_CONNECTIONS]);
+  }
+  tLid = nsNow();
+  for (n=0; n<LOOKUPS; ++n)
+  {
+    found += !!nwk_findPeer(&peers[n % NUM_CONNECTIONS], ED_PORT);
+  }
+  tTx = nsNow();
+  for (n=0; n<LOOKUPS; ++n)
+  {
+    found += !!findConn(sRxHint, peers[n % NUM_CONNECTIONS].addr, ED_PORT - n % NUM_CONNECTIONS, CHK_RX);
+  }
+  tRx = nsNow();
+  for (n=0; n<LOOKUPS; ++n)
+  {
+    found += !!findConn(sRxHint, stranger.addr, ED_PORT, CHK_RX);
+  }
+  tMiss = nsNow();
+
+  printf("%3d connections: LID %5.1f ns  Tx peer %5.1f ns  Rx peer %5.1f ns  Rx miss %5.1f ns\n",
+         NUM_CONNECTIONS, (tLid - t0) / LOOKUPS, (tTx - tLid) / LOOKUPS,
+         (tRx - tTx) / LOOKUPS, (tMiss - tRx) / LOOKUPS);
+
+  /* every hit found, no miss */
+  return (found != 3UL * LOOKUPS);
+}
@@ -0,0 +1,218 @@
+/* Host check of the bulk transfer window logic in nwk_bulk.c. One instance
+ * sends to itself over a loopback channel that can drop frames: data frames
+ * go through handleData() and the status replies through handleStatus().
+ * Frames queued by a burst are delivered during the reply delay. Build with
+ * MAX_BULK_PAYLOAD set. Counts frames and status rounds only: air time, CCA
+ * and the reply delay, which decide the real throughput, aren't modelled.
+ */
+#include <stdio.h>
+#include "nwk_bulk.c"
+
+#define QUEUE_SIZE    64
+#define LOSS_RUNS     2000
+
+static const addr_t sMyAddr = {{0x78, 0x56, 0x34, 0x12}};
+static connInfo_t   sConn;
+
+/* loopback channel */
+static mrfiPacket_t  sQ[QUEUE_SIZE];
+static unsigned      sQHead, sQTail;
+static frameInfo_t   sOutFrame;
+static unsigned long sSeed = 1;
+static int           sLossData, sLossStatus;   /* percent */
+static int           sDropSeq = -1;            /* drop this segment once */
+static int           sData, sStatus, sRounds;
+
+static int fails, checks;
+#define CHECK(c)  do { checks++; if (!(c)) { fails++; printf("FAIL line %d: %s\n", __LINE__, #c); } } while (0)
+
+connInfo_t *nwk_getConnInfo(linkID_t lid) { return (1 == lid) ? &sConn : 0; }
+addr_t const *nwk_getMyAddress(void) { return &sMyAddr; }
+uint8_t MRFI_RandomByte(void) { return 0x40; }
+uint8_t MRFI_GetRadioState(void) { return MRFI_RADIO_STATE_RX; }
+void MRFI_RxOn(void) {}
+void MRFI_RxIdle(void) {}
+void MRFI_WakeUp(void) {}
+void MRFI_Sleep(void) {}
+void MRFI_PostKillSem(void) {}
+
+static int lossRoll(void)
+{
+  sSeed = sSeed * 1103515245UL + 12345;
+  return (int)((sSeed >> 16) % 100);
+}
+
+frameInfo_t *nwk_buildFrame(uint8_t port, uint8_t *msg, uint8_t len, uint8_t hops)
+{
+  (void)hops;
+  memset(&sOutFrame, 0x0, sizeof(sOutFrame));
+  MRFI_SET_PAYLOAD_LEN(&sOutFrame.mrfiPkt, F_APP_PAYLOAD_OS + len);
+  memcpy(MRFI_P_SRC_ADDR(&sOutFrame.mrfiPkt), sMyAddr.addr, NET_ADDR_SIZE);
+  MRFI_P_PAYLOAD(&sOutFrame.mrfiPkt)[F_PORT_OS] = port;
+  memcpy(MRFI_P_PAYLOAD(&sOutFrame.mrfiPkt) + F_APP_PAYLOAD_OS, msg, len);
+
+  return &sOutFrame;
+}
+
+smplStatus_t nwk_sendFrame(frameInfo_t *pFrame, uint8_t txOption)
+{
+  uint8_t *msg = MRFI_P_PAYLOAD(&pFrame->mrfiPkt) + F_APP_PAYLOAD_OS;
+
+  (void)txOption;
+  if (BULK_REQ_DATA == (msg[BB_REQ_OS] & BULK_REQ_MSK))
+  {
+    sData++;
+    if (msg[BD_SEQ_OS] == sDropSeq)
+    {
+      sDropSeq = -1;
+      return SMPL_SUCCESS;
+    }
+    if (lossRoll() < sLossData)
+    {
+      return SMPL_SUCCESS;
+    }
+  }
+  else
+  {
+    sStatus++;
+    if (lossRoll() < sLossStatus)
+    {
+      return SMPL_SUCCESS;
+    }
+  }
+  sQ[sQTail++ % QUEUE_SIZE] = pFrame->mrfiPkt;
+
+  return SMPL_SUCCESS;
+}
+
+/* the sender waits here for the status: deliver everything queued */
+void MRFI_ReplyDelay(void)
+{
+  sRounds++;
+  while (sQHead != sQTail)
+  {
+    nwk_processBulk(&sQ[sQHead++ % QUEUE_SIZE]);
+  }
+}
+
+static uint8_t sSrc[MAX_BULK_PAYLOAD];
+
+static void resetCounts(void)
+{
+  sData = sStatus = sRounds = 0;
+  sQHead = sQTail = 0;
+}
+
+/* send len bytes. a finished transfer is checked and released. */
+static smplStatus_t transfer(uint16_t len)
+{
+  const uint8_t *data;
+  uint16_t       rxLen;
+  smplStatus_t   rc;
+
+  resetCounts();
+  rc = nwk_bulkSend(1, sSrc, len);
+  if (SMPL_SUCCESS == rc)
+  {
+    CHECK(SMPL_SUCCESS == nwk_bulkReceive(NULL, &data, &rxLen) && (len == rxLen) && !memcmp(data, sSrc, len));
+  }
+  nwk_bulkRelease();
+
+  return rc;
+}
+
+int main(void)
+{
+  static const uint16_t lens[] = {1, BULK_SEG_SIZE, BULK_SEG_SIZE+1, BULK_WINDOW*BULK_SEG_SIZE,
+                                  BULK_WINDOW*BULK_SEG_SIZE+1, 20*BULK_SEG_SIZE-1, MAX_BULK_PAYLOAD};
+  const uint8_t *data;
+  uint16_t       i, segs, rxLen;
+  smplStatus_t   rc;
+  int            pct, run, done, timeouts;
+  long           sent, needed;
+
+  for (i=0; i<sizeof(sSrc); ++i)
+  {
+    sSrc[i] = (uint8_t)(i * 7 + 3);
+  }
+  memcpy(sConn.peerAddr, sMyAddr.addr, NET_ADDR_SIZE);
+  sConn.hops2target = 1;
+  nwk_bulkInit();
+  printf("bulk: %d byte segments, window %d, MAX_BULK_PAYLOAD %d (%d segments)\n",
+         (int)BULK_SEG_SIZE, BULK_WINDOW, MAX_BULK_PAYLOAD, (int)BULK_MAX_SEGS);
+
+  CHECK(SMPL_BAD_PARAM == nwk_bulkSend(1, sSrc, 0));
+  CHECK(SMPL_BAD_PARAM == nwk_bulkSend(1, sSrc, MAX_BULK_PAYLOAD+1));
+  CHECK(SMPL_BAD_PARAM == nwk_bulkSend(2, sSrc, 10));
+
+  /* clean channel: every segment once, one status round per window */
+  for (i=0; i<sizeof(lens)/sizeof(lens[0]); ++i)
+  {
+    if (lens[i] > MAX_BULK_PAYLOAD)
+    {
+      continue;
+    }
+    segs = (lens[i] + BULK_SEG_SIZE - 1) / BULK_SEG_SIZE;
+    CHECK(SMPL_SUCCESS == transfer(lens[i]));
+    CHECK((segs == sData) && (sRounds == (segs + BULK_WINDOW - 1) / BULK_WINDOW));
+  }
+
+  /* one lost segment: only it is sent again, with the next window's new ones */
+  sDropSeq = 2;
+  CHECK(SMPL_SUCCESS == transfer(MAX_BULK_PAYLOAD));
+  CHECK(sData == BULK_MAX_SEGS + 1);
+  printf("  segment 2 lost once: %d data frames, %d rounds\n", sData, sRounds);
+
+  /* lost status request: the sender learns nothing and sends the window again */
+  if (BULK_WINDOW*BULK_SEG_SIZE <= MAX_BULK_PAYLOAD)
+  {
+    sDropSeq = BULK_WINDOW - 1;
+    CHECK(SMPL_SUCCESS == transfer(BULK_WINDOW*BULK_SEG_SIZE));
+    CHECK((sData == 2*BULK_WINDOW) && (2 == sRounds));
+  }
+  sDropSeq = -1;
+
+  /* dead channel: gives up after BULK_RETRIES+1 bursts, nothing received */
+  sLossData = 100;
+  CHECK(SMPL_TIMEOUT == transfer(MAX_BULK_PAYLOAD));
+  CHECK(sRounds == BULK_RETRIES + 1);
+  CHECK(SMPL_NO_FRAME == nwk_bulkReceive(NULL, &data, &rxLen));
+  sLossData = 0;
+
+  /* receiver still holding a finished transfer answers busy */
+  resetCounts();
+  CHECK(SMPL_SUCCESS == nwk_bulkSend(1, sSrc, 100));
+  CHECK(SMPL_NOMEM == nwk_bulkSend(1, sSrc, 100));
+  nwk_bulkRelease();
+  CHECK(SMPL_SUCCESS == transfer(100));
+
+  /* random loss on data and status frames: a finished transfer is always intact */
+  for (pct=0; pct<=40; pct+=10)
+  {
+    done = timeouts = 0;
+    sent = needed = 0;
+    sLossData = sLossStatus = pct;
+    for (run=0; run<LOSS_RUNS; ++run)
+    {
+      rc = transfer(MAX_BULK_PAYLOAD);
+      if (SMPL_SUCCESS == rc)
+      {
+        done++;
+        sent   += sData;
+        needed += BULK_MAX_SEGS;
+      }
+      else
+      {
+        CHECK(SMPL_TIMEOUT == rc);
+        timeouts++;
+      }
+    }
+    CHECK(pct || (LOSS_RUNS == done));
+    printf("  %2d%% loss: %4d/%d done, %3d timeouts, %.2f data frames per segment\n",
+           pct, done, LOSS_RUNS, timeouts, done ? (double)sent / needed : 0.0);
+  }
+
+  printf("bulk: %d checks, %d failed\n", checks, fails);
+
+  return fails != 0;
+}
@@ -0,0 +1,146 @@
+/* Host check of the transaction ID duplicate filter in nwk.c: isDupTID()
+ * driven with TID sequences, nwk_isConnectionValid() with the AP's empty
+ * poll replies, and nwk_resetPeerTIDs().
+ */
+#include <stdio.h>
+#include "nwk.c"
+
+#define PEER_PORT   0x3D
+
+static const uint8_t sPeer[NET_ADDR_SIZE] = {0x01, 0x56, 0x34, 0x12};
+static mrfiPacket_t  sPkt;
+
+static int fails, checks;
+#define CHECK(c)  do { checks++; if (!(c)) { fails++; printf("FAIL line %d: %s\n", __LINE__, #c); } } while (0)
+
+/* non-zero if the window takes tid as a duplicate */
+static int dup(connInfo_t *pCInfo, uint8_t tid)
+{
+  PUT_INTO_FRAME(MRFI_P_PAYLOAD(&sPkt), F_TRACTID_OS, tid);
+  return isDupTID(pCInfo, &sPkt);
+}
+
+/* non-zero if a frame from the peer gets through nwk_isConnectionValid() */
+static int accepted(uint8_t tid, uint8_t emptyPollRsp)
+{
+  linkID_t lid;
+
+  memset(&sPkt, 0x0, sizeof(sPkt));
+  memcpy(MRFI_P_SRC_ADDR(&sPkt), sPeer, NET_ADDR_SIZE);
+  PUT_INTO_FRAME(MRFI_P_PAYLOAD(&sPkt), F_PORT_OS, PEER_PORT);
+  PUT_INTO_FRAME(MRFI_P_PAYLOAD(&sPkt), F_TRACTID_OS, tid);
+  if (emptyPollRsp)
+  {
+    MRFI_SET_PAYLOAD_LEN(&sPkt, F_APP_PAYLOAD_OS);
+    PUT_INTO_FRAME(MRFI_P_PAYLOAD(&sPkt), F_TX_DEVICE, F_TX_DEVICE_AP);
+    PUT_INTO_FRAME(MRFI_P_PAYLOAD(&sPkt), F_FWD_FRAME, F_FRAME_FWD_TYPE);
+  }
+  else
+  {
+    MRFI_SET_PAYLOAD_LEN(&sPkt, F_APP_PAYLOAD_OS + 4);
+    PUT_INTO_FRAME(MRFI_P_PAYLOAD(&sPkt), F_TX_DEVICE, F_TX_DEVICE_ED);
+  }
+
+  return nwk_isConnectionValid(&sPkt, &lid);
+}
+
+int main(void)
+{
+  connInfo_t *pCInfo;
+  uint8_t     tid;
+  int         i;
+
+  nwk_nwkInit(NULL);
+  pCInfo = nwk_getNextConnection();
+  memcpy(pCInfo->peerAddr, sPeer, NET_ADDR_SIZE);
+  memcpy(MRFI_P_SRC_ADDR(&sPkt), sPeer, NET_ADDR_SIZE);
+  pCInfo->portRx = PEER_PORT;
+  pCInfo->portTx = PEER_PORT;
+
+  /* AP with 8 peers: this link sees every 8th TID. each frame once. */
+  for (tid=5, i=0; i<100; ++i, tid+=8)
+  {
+    if (!tid)
+    {
+      tid = 1;
+    }
+    CHECK(!dup(pCInfo, tid));
+    CHECK(dup(pCInfo, tid));
+  }
+
+  /* late retransmits of older frames are behind the window */
+  CHECK(dup(pCInfo, (uint8_t)(tid-8)));
+  CHECK(dup(pCInfo, (uint8_t)(tid-16)));
+  CHECK(dup(pCInfo, (uint8_t)(tid-40)));
+
+  /* a new frame resets the count of frames from behind */
+  CHECK(!dup(pCInfo, tid));
+  CHECK(dup(pCInfo, (uint8_t)(tid-20)));
+  CHECK(dup(pCInfo, (uint8_t)(tid-30)));
+  CHECK(dup(pCInfo, (uint8_t)(tid-50)));
+  CHECK(!dup(pCInfo, (uint8_t)(tid+8)));
+
+  /* out of order inside the window */
+  tid += 16;
+  CHECK(!dup(pCInfo, (uint8_t)(tid+3)));
+  CHECK(!dup(pCInfo, (uint8_t)(tid+1)));
+  CHECK(dup(pCInfo, (uint8_t)(tid+1)));
+  CHECK(!dup(pCInfo, (uint8_t)(tid+2)));
+
+  /* sender restarts from 1 with no Ping: the first TID_RESYNC-1 are dropped */
+  sTidWin[0].lastTID = 0;
+  CHECK(!dup(pCInfo, 100));
+  for (i=1; i<TID_RESYNC; ++i)
+  {
+    CHECK(dup(pCInfo, i));
+  }
+  CHECK(!dup(pCInfo, TID_RESYNC));
+  CHECK(dup(pCInfo, TID_RESYNC));
+  CHECK(!dup(pCInfo, TID_RESYNC+1));
+
+  /* a big forward jump slides the window */
+  CHECK(!dup(pCInfo, TID_RESYNC+100));
+  CHECK(dup(pCInfo, TID_RESYNC+100));
+  CHECK(!dup(pCInfo, TID_RESYNC+99));
+
+  /* sender restarts after Pinging us: nothing is dropped */
+  sTidWin[0].lastTID = 0;
+  CHECK(!dup(pCInfo, 100));
+  nwk_resetPeerTIDs(sPeer);
+  for (i=1; i<=TID_RESYNC; ++i)
+  {
+    CHECK(!dup(pCInfo, i));
+  }
+  CHECK(dup(pCInfo, 1));
+
+  /* a Ping from someone else leaves the window alone */
+  {
+    uint8_t other[NET_ADDR_SIZE] = {0x02, 0x56, 0x34, 0x12};
+
+    nwk_resetPeerTIDs(other);
+    CHECK(dup(pCInfo, 1));
+  }
+
+  /* the AP's empty poll replies carry the peer's address and the AP's own
+   * TIDs. they get through every time and don't move the peer's window.
+   */
+  sTidWin[0].lastTID = 0;
+  CHECK(accepted(10, 0));
+  CHECK(accepted(40, 1));
+  CHECK(accepted(40, 1));
+  CHECK(accepted(11, 0));
+  CHECK(accepted(12, 0));
+  CHECK(!accepted(12, 0));
+  CHECK(accepted(41, 1));
+  CHECK(accepted(13, 0));
+  CHECK(12 + 1 == sTidWin[0].lastTID);
+
+  /* the peer's own frames still go through the window if they're empty */
+  CHECK(accepted(14, 0));
+  MRFI_SET_PAYLOAD_LEN(&sPkt, F_APP_PAYLOAD_OS);
+  CHECK(nwk_isConnectionValid(&sPkt, &tid) == 0);
+
+  printf("tid: %d checks, %d failed\n", checks, fails);
+
+  return fails != 0;
+}
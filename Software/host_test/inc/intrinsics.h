@@ -0,0 +1,4 @@
+/* Host stand-in for the TI <intrinsics.h>. The intrinsics are declared in
+ * the <msp430.h> stand-in.
+ */
+#include <msp430.h>
@@ -0,0 +1,111 @@
+/* Host stand-in for the TI <msp430.h>. Peripheral registers are plain
+ * variables that a host check defines (or ignores) and the intrinsics are
+ * functions it provides.
+ */
+#ifndef STUB_MSP430_H
+#define STUB_MSP430_H
+#define __interrupt
+#define R8(n) extern volatile unsigned char n;
+#define R16(n) extern volatile unsigned int n;
+R8(P1DIR) R8(P1OUT) R8(P1IN) R8(P1SEL) R8(P1IE) R8(P1IES) R8(P1IFG) R8(P1REN)
+R8(P2DIR) R8(P2OUT) R8(P2IN) R8(P2SEL) R8(P2IE) R8(P2IES) R8(P2IFG) R8(P2REN)
+R8(P3DIR) R8(P3OUT) R8(P3IN) R8(P3SEL) R8(P3REN) R8(P4DIR) R8(P4OUT) R8(P4IN) R8(P4SEL)
+R8(IFG1) R8(IFG2) R8(IE1) R8(IE2) R8(DCOCTL) R8(BCSCTL1) R8(BCSCTL2) R8(BCSCTL3)
+R8(UCB0CTL0) R8(UCB0CTL1) R8(UCB0BR0) R8(UCB0BR1) R8(UCB0RXBUF) R8(UCB0TXBUF) R8(UCB0STAT)
+R8(UCA0CTL0) R8(UCA0CTL1) R8(UCA0BR0) R8(UCA0BR1) R8(UCA0RXBUF) R8(UCA0TXBUF) R8(UCA0MCTL) R8(UCA0STAT)
+R8(CALBC1_8MHZ) R8(CALDCO_8MHZ) R8(CALBC1_1MHZ) R8(CALDCO_1MHZ) R8(CALBC1_12MHZ) R8(CALDCO_12MHZ) R8(CALBC1_16MHZ) R8(CALDCO_16MHZ)
+R16(WDTCTL) R16(FCTL1) R16(FCTL2) R16(FCTL3)
+R16(TACTL) R16(TAR) R16(TACCR0) R16(TACCR1) R16(TACCR2) R16(TACCTL0) R16(TACCTL1) R16(TACCTL2) R16(TAIV)
+R16(TBCTL) R16(TBR) R16(TBCCR0) R16(TBCCR1) R16(TBCCR2) R16(TBCCTL0) R16(TBCCTL1) R16(TBCCTL2) R16(TBIV)
+#define TA0CTL TACTL
+#define TA0R TAR
+#define TA0CCR0 TACCR0
+#define TA0CCR1 TACCR1
+#define TA0CCR2 TACCR2
+#define TA0CCTL0 TACCTL0
+#define TA0CCTL1 TACCTL1
+#define TA0CCTL2 TACCTL2
+#define BIT0 0x01
+#define BIT1 0x02
+#define BIT2 0x04
+#define BIT3 0x08
+#define BIT4 0x10
+#define BIT5 0x20
+#define BIT6 0x40
+#define BIT7 0x80
+#define GIE 0x08
+#define CCIE 0x10
+#define CCIFG 0x01
+#define CAP 0x100
+#define CM_1 0x4000
+#define CM_2 0x8000
+#define CCIS_0 0
+#define CCIS_1 0x1000
+#define SCS 0x800
+#define OUTMOD_3 0x60
+#define OUTMOD_7 0xE0
+#define TASSEL_2 0x200
+#define TBSSEL_2 0x200
+#define ID_3 0xC0
+#define MC_0 0
+#define MC_1 0x10
+#define MC_2 0x20
+#define TACLR 4
+#define TBCLR 4
+#define TAIE 2
+#define TAIFG 1
+#define FWKEY 0xA500
+#define ERASE 2
+#define WRT 0x40
+#define LOCK 0x10
+#define BUSY 1
+#define FSSEL_1 0x40
+#define FN0 1
+#define FN1 2
+#define FN2 4
+#define FN3 8
+#define FN4 16
+#define FN5 32
+#define WDTPW 0x5A00
+#define WDTHOLD 0x80
+#define UCSWRST 1
+#define UCSSEL1 0x80
+#define UCSSEL_2 0x80
+#define UCCKPH 0x80
+#define UCMSB 0x20
+#define UCMST 0x08
+#define UCSYNC 0x01
+#define UCB0RXIFG 4
+#define UCB0TXIFG 8
+#define UCA0RXIFG 1
+#define UCA0TXIFG 2
+#define UCA0RXIE 1
+#define UCA0TXIE 2
+#define UCB0RXIE 4
+#define UCB0TXIE 8
+#define UCBRS0 2
+#define LPM3_bits 0xD0
+#define LPM0_bits 0x10
+#define TIMERA0_VECTOR 1
+#define TIMERA1_VECTOR 2
+#define TIMERB0_VECTOR 3
+#define TIMERB1_VECTOR 4
+#define PORT1_VECTOR 5
+#define PORT2_VECTOR 6
+#define USCIAB0RX_VECTOR 7
+#define USCIAB0TX_VECTOR 8
+#define DMA_VECTOR 9
+#define UCSSEL_3 0xC0
+#define UCBRS_2 4
+#define UC0IE IE2
+#define UC0IFG IFG2
+#ifdef __cplusplus
+extern "C" {
+#endif
+unsigned short _get_interrupt_state(void); void _disable_interrupts(void); void _enable_interrupts(void);
+void _bis_SR_register(unsigned short); void _bic_SR_register(unsigned short); void _set_interrupt_state(unsigned short);
+void _bic_SR_register_on_exit(unsigned short); void _bis_SR_register_on_exit(unsigned short);
+#ifdef __cplusplus
+}
+#endif
+#endif
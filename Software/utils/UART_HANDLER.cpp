@@ -5,6 +5,10 @@
 #include "UART_HANDLER.hpp"
 #include <stdio.h>
 
+#ifdef MRFI_SPI_ASYNC
+extern "C" void mrfiSpiIsr(void);	//the radio SPI (USCI B0) shares the USCIAB0RX vector with the UART. See mrfi_spi.c
+#endif
+
 
 
 //RS232 UART comms objects
@@ -79,7 +83,7 @@ void tx_byte_to_slave(unsigned char Byte)
 /**************************************************
 tx_bytes_to_slave - fn sends Count number of bytes from ByteArr
 **************************************************/
-void tx_bytes_to_slave(unsigned char *ByteArr, int Count)
+void tx_bytes_to_slave(const unsigned char *ByteArr, int Count)
 {
 	//first move the new data into the output buffer
 	int i;
@@ -223,6 +227,12 @@ __interrupt void USCIAB0RX_ISR(void)
 		 UART_RX_BUFFER.ISRPtr.inc();	//increment the pointer to the next free element in the buffer
 		 UART_RX_BUFFER.ISRbytecnt++;	//increment the new data counter
 	 }
+#ifdef MRFI_SPI_ASYNC
+	 if ((IE2 & UCB0RXIE) && (IFG2 & UCB0RXIFG))	//queued radio SPI transfer: a byte is done
+	 {
+		 mrfiSpiIsr();
+	 }
+#endif
  }
 #pragma vector=USCIAB0TX_VECTOR
 __interrupt void USCIAB0TX_ISR(void)
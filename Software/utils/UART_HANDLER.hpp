@@ -105,7 +105,7 @@ class Circ_UART_Buf
 // UART function prototypes
 void Init_UART(void);
 void tx_byte_to_slave(unsigned char Byte);
-void tx_bytes_to_slave(unsigned char *ByteArr, int Count);
+void tx_bytes_to_slave(const unsigned char *ByteArr, int Count);
 //void ParseRXCmd(void);
 void tx_string_to_slave(char *Tx_string);
 signed char EnoughBytes(void);